@@ -0,0 +1,174 @@
+/*
+*	crc32_bench.c
+*	checks the CRC-32 of iGame against known values and a bit by bit
+*	one, and measures how fast it checksums slaves
+*
+*	gcc -O2 -o crc32_bench crc32_bench.c ../src/crc32.c
+*
+*	crc32_bench [-s size in KB]
+*
+*	Every start and length within a few words is checked, in one part
+*	and split in two at every point, so the four bytes a step and the
+*	bytes left over are both covered. Then the given size, 16KB by
+*	default like a slave, is checksummed over and over, and compared
+*	with the byte by byte loop. The results are printed one phase per
+*	line, as key=value pairs, and a check that fails ends it with an
+*	error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/crc32.h"
+
+#define CHECK_SIZE 67
+#define BENCH_TOTAL (256 * 1024 * 1024)
+
+static void check(const int ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("error=\"%s\"\n", what);
+		exit(1);
+	}
+}
+
+static double seconds_since(const clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* The plain loop, a bit at a time, as in the definition */
+static unsigned long bitwise_crc32(const unsigned char* data, size_t length)
+{
+	unsigned long crc = 0xFFFFFFFFUL;
+	int i;
+
+	while (length--)
+	{
+		crc ^= *data++;
+		for (i = 0; i < 8; i++)
+			crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320UL : crc >> 1;
+	}
+
+	return ~crc & 0xFFFFFFFFUL;
+}
+
+/* The usual loop with one table, a byte at a time */
+static unsigned long bytewise_crc32(const unsigned char* data, size_t length)
+{
+	static unsigned long table[256];
+	static int ready;
+	unsigned long crc = 0xFFFFFFFFUL;
+
+	if (!ready)
+	{
+		int i, j;
+
+		for (i = 0; i < 256; i++)
+		{
+			crc = i;
+			for (j = 0; j < 8; j++)
+				crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320UL : crc >> 1;
+			table[i] = crc;
+		}
+		ready = 1;
+		crc = 0xFFFFFFFFUL;
+	}
+
+	while (length--)
+		crc = (crc >> 8) ^ table[(crc ^ *data++) & 0xFF];
+
+	return ~crc & 0xFFFFFFFFUL;
+}
+
+static void check_values(void)
+{
+	unsigned char data[CHECK_SIZE + 4];
+	size_t start, length, split;
+	unsigned long checks = 0;
+
+	check(crc32_update(0, "", 0) == 0, "crc of nothing");
+	check(crc32_update(0, "a", 1) == 0xE8B7BE43UL, "crc of a");
+	check(crc32_update(0, "123456789", 9) == 0xCBF43926UL, "crc of 123456789");
+	check(crc32_update(0, "The quick brown fox jumps over the lazy dog", 43) == 0x414FA339UL, "crc of the fox");
+
+	for (start = 0; start < sizeof(data); start++)
+		data[start] = (unsigned char)(start * 167 + 13);
+
+	// Every start and length, so the words are taken at every alignment
+	for (start = 0; start < 4; start++)
+	{
+		for (length = 0; length <= CHECK_SIZE; length++)
+		{
+			const unsigned long expected = bitwise_crc32(data + start, length);
+
+			check(crc32_update(0, data + start, length) == expected, "crc in one part");
+			for (split = 0; split <= length; split++, checks++)
+				check(crc32_update(crc32_update(0, data + start, split), data + start + split, length - split)
+					== expected, "crc in two parts");
+		}
+	}
+
+	printf("phase=check checks=%lu\n", checks);
+}
+
+static void bench(const size_t size)
+{
+	unsigned char* data = malloc(size);
+	const int rounds = (int)(BENCH_TOTAL / size) + 1;
+	unsigned long crc = 0, bytewise = 0;
+	double seconds, bytewise_seconds;
+	clock_t start;
+	size_t i;
+	int round;
+
+	check(data != NULL, "not enough memory");
+	for (i = 0; i < size; i++)
+		data[i] = (unsigned char)(i * 31 % 251);
+
+	start = clock();
+	for (round = 0; round < rounds; round++)
+		crc ^= crc32_update(0, data, size) + round;
+	seconds = seconds_since(start);
+
+	start = clock();
+	for (round = 0; round < rounds; round++)
+		bytewise ^= bytewise_crc32(data, size) + round;
+	bytewise_seconds = seconds_since(start);
+
+	check(crc == bytewise, "not the same crc as byte by byte");
+
+	if (seconds <= 0)
+		seconds = 0.001;
+	if (bytewise_seconds <= 0)
+		bytewise_seconds = 0.001;
+
+	printf("phase=bench size=%lu rounds=%d seconds=%.3f mb_per_second=%.1f bytewise_seconds=%.3f "
+		"bytewise_mb_per_second=%.1f\n", (unsigned long)size, rounds, seconds,
+		(double)size * rounds / seconds / (1024 * 1024), bytewise_seconds,
+		(double)size * rounds / bytewise_seconds / (1024 * 1024));
+
+	free(data);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t size = 16;
+
+	if (argc == 3 && !strcmp(argv[1], "-s") && atoi(argv[2]) > 0)
+		size = (size_t)atoi(argv[2]);
+	else if (argc != 1)
+	{
+		printf("Usage: %s [-s size in KB]\n", argv[0]);
+		exit(0);
+	}
+
+	check_values();
+	bench(size * 1024);
+
+	printf("phase=done\n");
+	return 0;
+}
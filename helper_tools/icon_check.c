@@ -0,0 +1,330 @@
+/*
+*	icon_check.c
+*	checks the icon parser of iGame against the icons that come with it,
+*	cut at every length and with broken images, and the tooltypes writer
+*	on every one of them
+*
+*	gcc -g -fsanitize=address,undefined -o icon_check icon_check.c ../src/iconfile.c
+*
+*	icon_check [directory]
+*
+*	The directory is the top of the iGame sources, .. by default. Every
+*	cut is parsed from a copy of exactly that size, so with the address
+*	sanitizer a read past the data stops it. Every classic icon is
+*	written again with the same tooltypes, which must give the same
+*	bytes, and with one added, one removed and none, which must parse
+*	back to them. The results are printed one phase per line, as
+*	key=value pairs, and a check that fails ends it with an error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/iconfile.h"
+
+#define MAX_TOOL_TYPES 8
+#define MAX_WRITTEN_TOOL_TYPES 32   /* more than any icon here has, with one added */
+
+typedef struct expected_icon
+{
+	const char* name;
+	int result;
+	int type;
+	const char* default_tool;
+	int tool_types_count;        /* -1 to not check the tooltypes */
+	const char* tool_types[MAX_TOOL_TYPES];
+} expected_icon;
+
+#define IGAME_TOOL_TYPES "(SCREENSHOT=WIDTHxHEIGHT)", "(NOSCREENSHOT)", "(NOGUIGFX)", "(FILTERUSEENTER)", \
+	"(SAVESTATSONEXIT)", "(TITLESFROMDIRS)", "(NOSMARTSPACES)"
+
+static const expected_icon icons[] = {
+	{ "alt_icons/iGame-png-48.info", ICON_UNKNOWN, 0, NULL, 0, { NULL } },
+	{ "alt_icons/iGame-png-64.info", ICON_UNKNOWN, 0, NULL, 0, { NULL } },
+	{ "alt_icons/iGame-png-120.info", ICON_UNKNOWN, 0, NULL, 0, { NULL } },
+	{ "alt_icons/iGame1.info", ICON_OK, 3, NULL, 8, { IGAME_TOOL_TYPES, "" } },
+	{ "alt_icons/iGame2.info", ICON_OK, 3, NULL, 7, { IGAME_TOOL_TYPES } },
+	{ "alt_icons/iGame3.info", ICON_OK, 3, NULL, 8, { IGAME_TOOL_TYPES, "" } },
+	{ "alt_icons/iGame4.info", ICON_OK, 3, NULL, 8, { IGAME_TOOL_TYPES, "" } },
+	{ "required_files/iGame.info", ICON_OK, 3, NULL, 7, { IGAME_TOOL_TYPES } },
+	{ "required_files/Install-iGame.info", ICON_OK, 4, "Installer", 2, { "APPNAME=TextEditor.mcc", "MINUSER=AVERAGE" } },
+	{ "required_files/iGame.guide.info", ICON_OK, 4, "MultiView", 0, { NULL } },
+	{ "required_files/igame_drawer.info", ICON_OK, 2, "", -1, { NULL } },
+	{ "required_files/igame_drawer_3.0.info", ICON_OK, 2, NULL, 0, { NULL } },
+};
+
+static void check(const int ok, const char* name, const char* what)
+{
+	if (!ok)
+	{
+		printf("error=\"%s: %s\"\n", name, what);
+		exit(1);
+	}
+}
+
+static unsigned char* read_file(const char* path, long* length)
+{
+	FILE* fp = fopen(path, "rb");
+	unsigned char* data;
+
+	if (fp == NULL)
+		return NULL;
+
+	fseek(fp, 0, SEEK_END);
+	*length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	data = malloc(*length > 0 ? *length : 1);
+	if (data != NULL && fread(data, 1, *length, fp) != (size_t)*length)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(fp);
+
+	return data;
+}
+
+/* Parses the first length bytes from a copy of just that size */
+static int parse_cut(const unsigned char* data, const long length, icon_header* header)
+{
+	unsigned char* cut = malloc(length > 0 ? length : 1);
+	int result;
+
+	check(cut != NULL, "cut", "not enough memory");
+	memcpy(cut, data, length);
+	result = icon_parse(cut, length, header);
+	free(cut);
+
+	return result;
+}
+
+static void check_strings(const expected_icon* icon, const unsigned char* data, const long length,
+	const icon_header* header)
+{
+	const char* string;
+	size_t string_length;
+	long position;
+	int i;
+
+	check(header->type == icon->type, icon->name, "wrong type");
+
+	if (icon->default_tool)
+	{
+		check(header->default_tool && icon_string(data, length, header->default_tool, &string, &string_length),
+			icon->name, "no default tool");
+		check(string_length == strlen(icon->default_tool) && !memcmp(string, icon->default_tool, string_length),
+			icon->name, "wrong default tool");
+	}
+	else
+		check(header->default_tool == 0, icon->name, "unexpected default tool");
+
+	if (icon->tool_types_count < 0)
+		return;
+
+	check(header->tool_types_count == icon->tool_types_count, icon->name, "wrong number of tooltypes");
+	for (i = 0, position = header->tool_types + 4; i < header->tool_types_count; i++)
+	{
+		position = icon_string(data, length, position, &string, &string_length);
+		check(position != 0, icon->name, "tooltype past the table");
+		check(string_length == strlen(icon->tool_types[i]) && !memcmp(string, icon->tool_types[i], string_length),
+			icon->name, "wrong tooltype");
+	}
+	check(header->tool_types == 0 || position <= header->tool_types_end, icon->name, "tooltypes past their end");
+}
+
+/* Every cut before the end of the strings is truncated, every one after it is the same icon */
+static void check_cuts(const expected_icon* icon, const unsigned char* data, const long length,
+	const icon_header* full)
+{
+	icon_header header;
+	long cut;
+	int result;
+
+	for (cut = 0; cut <= length; cut++)
+	{
+		result = parse_cut(data, cut, &header);
+
+		if (icon->result == ICON_UNKNOWN)
+			check(result == (cut < 2 ? ICON_TRUNCATED : ICON_UNKNOWN), icon->name, "wrong result for a cut");
+		else if (cut < full->end)
+			check(result == ICON_TRUNCATED, icon->name, "cut before the end is not truncated");
+		else
+			check(result == ICON_OK && !memcmp(&header, full, sizeof(icon_header)), icon->name,
+				"cut after the end is not the same");
+	}
+}
+
+/* The tooltypes of a parsed icon, as strings of their own */
+static int read_tool_types(const char* name, const unsigned char* data, const long length,
+	const icon_header* header, char* tool_types[])
+{
+	const char* string;
+	size_t string_length;
+	long position = header->tool_types + 4;
+	int i;
+
+	check(header->tool_types_count < MAX_WRITTEN_TOOL_TYPES, name, "too many tooltypes to check");
+	for (i = 0; i < header->tool_types_count; i++)
+	{
+		position = icon_string(data, length, position, &string, &string_length);
+		check(position != 0 && (tool_types[i] = malloc(string_length + 1)) != NULL, name, "can't read a tooltype");
+		memcpy(tool_types[i], string, string_length);
+		tool_types[i][string_length] = '\0';
+	}
+
+	return header->tool_types_count;
+}
+
+/*
+ * Writes the icon with the tooltypes into a buffer of exactly the size
+ * it should have, checks that it parses back to them and that the rest
+ * of the icon is as it was. Returns the new icon, to be freed.
+ */
+static unsigned char* write_icon(const char* name, const unsigned char* data, const long length,
+	const icon_header* header, const char* const* tool_types, const int count, long* new_length)
+{
+	const long old_size = header->tool_types ? header->end - header->tool_types : 0;
+	const long start = header->tool_types ? header->tool_types : header->end;
+	const long expected = length - old_size + (count > 0 || header->tool_types ? icon_tool_types_size(tool_types, count) : 0);
+	unsigned char* out = malloc(expected);
+	char* read[MAX_WRITTEN_TOOL_TYPES];
+	icon_header written;
+	int i;
+
+	check(out != NULL, name, "not enough memory");
+	*new_length = icon_set_tool_types(data, length, header, tool_types, count, out);
+	check(*new_length == expected, name, "written icon of the wrong length");
+	check(icon_parse(out, *new_length, &written) == ICON_OK, name, "written icon does not parse");
+	check(written.type == header->type && written.default_tool == header->default_tool, name,
+		"written icon of another type or tool");
+
+	check(read_tool_types(name, out, *new_length, &written, read) == count, name, "written icon of the wrong tooltypes");
+	for (i = 0; i < count; i++)
+	{
+		check(!strcmp(read[i], tool_types[i]), name, "written tooltype not the one given");
+		free(read[i]);
+	}
+
+	// Only the pointer to the table may differ before it, and nothing after it
+	check(!memcmp(out, data, 54) && !memcmp(out + 58, data + 58, start - 58), name, "written images changed");
+	check(written.end - *new_length == header->end - length
+		&& !memcmp(out + written.end, data + header->end, length - header->end), name, "written tail changed");
+
+	return out;
+}
+
+/* Writes the icon with the same, more, fewer and no tooltypes, and back again */
+static void check_writer(const char* name, const unsigned char* data, const long length, const icon_header* header)
+{
+	char* tool_types[MAX_WRITTEN_TOOL_TYPES];
+	const int count = read_tool_types(name, data, length, header, tool_types);
+	icon_header changed;
+	unsigned char *out, *cleared;
+	const char* value;
+	size_t value_length;
+	long new_length, cleared_length;
+	int i;
+
+	out = write_icon(name, data, length, header, (const char* const*)tool_types, count, &new_length);
+	check(new_length == length && !memcmp(out, data, length), name, "same tooltypes not the same icon");
+	free(out);
+
+	tool_types[count] = "IGAMECHECK=yes|no";
+	out = write_icon(name, data, length, header, (const char* const*)tool_types, count + 1, &new_length);
+	icon_parse(out, new_length, &changed);
+	check(icon_find_tool_type(out, &changed, "igamecheck", &value, &value_length)
+		&& icon_match_value(value, value_length, "NO"), name, "added tooltype not found");
+	free(out);
+
+	if (count > 0)
+	{
+		out = write_icon(name, data, length, header, (const char* const*)tool_types + 1, count - 1, &new_length);
+		icon_parse(out, new_length, &changed);
+		check(!icon_find_tool_type(out, &changed, "igamecheck", &value, &value_length), name, "unexpected tooltype");
+		free(out);
+	}
+
+	// An icon with no tooltypes gets them back as they were
+	cleared = write_icon(name, data, length, header, NULL, 0, &cleared_length);
+	icon_parse(cleared, cleared_length, &changed);
+	check(changed.tool_types_count == 0, name, "cleared tooltypes still there");
+	out = write_icon(name, cleared, cleared_length, &changed, (const char* const*)tool_types, count, &new_length);
+	check(new_length == length && !memcmp(out, data, length), name, "restored tooltypes not the same icon");
+	free(out);
+	free(cleared);
+
+	for (i = 0; i < count; i++)
+		free(tool_types[i]);
+}
+
+/* Puts the given size in the gadget render image of a copy of the icon */
+static int parse_broken_image(const unsigned char* data, const long length, const unsigned short width,
+	const unsigned short height, const unsigned short depth)
+{
+	const long image = ICON_DISKOBJECT_SIZE + (data[66] | data[67] | data[68] | data[69] ? 56 : 0);
+	unsigned char* broken = malloc(length);
+	icon_header header;
+	int result;
+
+	check(broken != NULL, "broken", "not enough memory");
+	memcpy(broken, data, length);
+	broken[image + 4] = (unsigned char)(width >> 8);
+	broken[image + 5] = (unsigned char)width;
+	broken[image + 6] = (unsigned char)(height >> 8);
+	broken[image + 7] = (unsigned char)height;
+	broken[image + 8] = (unsigned char)(depth >> 8);
+	broken[image + 9] = (unsigned char)depth;
+
+	result = icon_parse(broken, length, &header);
+	free(broken);
+
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* dir = argc > 1 ? argv[1] : "..";
+	char path[1024];
+	icon_header header;
+	unsigned char* data;
+	long length;
+	size_t i;
+
+	for (i = 0; i < sizeof(icons) / sizeof(icons[0]); i++)
+	{
+		const expected_icon* icon = &icons[i];
+
+		snprintf(path, sizeof(path), "%s/%s", dir, icon->name);
+		check((data = read_file(path, &length)) != NULL, icon->name, "can't be read");
+
+		check(parse_cut(data, length, &header) == icon->result, icon->name, "wrong result");
+		if (icon->result == ICON_OK)
+		{
+			check(header.end > ICON_DISKOBJECT_SIZE && header.end <= length, icon->name, "wrong end");
+			check_strings(icon, data, length, &header);
+			check_writer(icon->name, data, length, &header);
+		}
+		check_cuts(icon, data, length, &header);
+
+		printf("phase=icon name=\"%s\" length=%ld end=%ld tool_types=%d cuts=%ld\n", icon->name, length,
+			header.end, header.tool_types_count, length + 1);
+		free(data);
+	}
+
+	// Images that can't be real, or that are bigger than the icon
+	snprintf(path, sizeof(path), "%s/required_files/iGame.info", dir);
+	check((data = read_file(path, &length)) != NULL, "iGame.info", "can't be read");
+	check(data[22] | data[23] | data[24] | data[25], "iGame.info", "has no image");
+
+	check(parse_broken_image(data, length, 1, 0xFFFF, 0xFFFF) == ICON_UNKNOWN, "broken", "65535 planes");
+	check(parse_broken_image(data, length, 0xFFFF, 0xFFFF, 9) == ICON_UNKNOWN, "broken", "9 planes");
+	check(parse_broken_image(data, length, 0xFFFF, 0xFFFF, 8) == ICON_TRUNCATED, "broken", "4 GB of planes");
+	check(parse_broken_image(data, length, 1, 0xFFFF, 1) == ICON_TRUNCATED, "broken", "128 KB of planes");
+	free(data);
+
+	printf("phase=broken images=4\n");
+	printf("phase=done\n");
+	return 0;
+}
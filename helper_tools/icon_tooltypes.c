@@ -0,0 +1,73 @@
+/*
+*	icon_tooltypes.c
+*	prints the default tool and the tooltypes of a classic icon,
+*	the way iGame reads them without icon.library
+*
+*	gcc -o icon_tooltypes icon_tooltypes.c ../src/iconfile.c
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/iconfile.h"
+
+int main(int argc, char* argv[])
+{
+	icon_header header;
+	const char* string;
+	size_t string_length;
+
+	if (argc == 1)
+	{
+		printf("Usage: %s filename.info\n", argv[0]);
+		exit(0);
+	}
+
+	FILE* fp = fopen(argv[1], "rbe");
+	if (fp == NULL)
+	{
+		printf("Could not open %s\n", argv[1]);
+		exit(0);
+	}
+
+	fseek(fp, 0, SEEK_END);
+	const long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	unsigned char* data = malloc(length > 0 ? length : 1);
+	if (data == NULL || fread(data, 1, length, fp) != (size_t)length)
+	{
+		printf("Could not read %s\n", argv[1]);
+		exit(0);
+	}
+	fclose(fp);
+
+	switch (icon_parse(data, length, &header))
+	{
+	case ICON_UNKNOWN:
+		printf("%s is not a classic icon, icon.library has to read it\n", argv[1]);
+		exit(0);
+	case ICON_TRUNCATED:
+		printf("%s is broken, it ends before its tooltypes\n", argv[1]);
+		exit(0);
+	}
+
+	printf("Type: %d\n", header.type);
+	if (header.default_tool && icon_string(data, length, header.default_tool, &string, &string_length))
+		printf("DefaultTool: [%.*s]\n", (int)string_length, string);
+
+	long position = header.tool_types + 4;
+	for (int i = 0; i < header.tool_types_count; i++)
+	{
+		position = icon_string(data, length, position, &string, &string_length);
+		printf("ToolType: [%.*s]\n", (int)string_length, string);
+	}
+
+	if (icon_find_tool_type(data, &header, "SLAVE", &string, &string_length))
+		printf("Slave: [%.*s]\n", (int)string_length, string);
+
+	printf("Classic part: %ld of %ld bytes\n", header.end, length);
+
+	free(data);
+	return 0;
+}
@@ -0,0 +1,310 @@
+/*
+*	scan_bench.c
+*	generates a WHDLoad-like repository and measures how fast iGame scans it
+*
+*	gcc -O2 -o scan_bench scan_bench.c ../src/scanner.c ../src/slavefuncs.c
+*		../src/slaveheader.c ../src/crc32.c ../src/osfuncs_posix.c -lpthread
+*
+*	scan_bench [-g games] [-f files] [-d depth] [-c copies] directory
+*
+*	The tree is only generated if the directory does not exist. Every
+*	game gets a folder with a slave, an icon and a data folder with the
+*	given number of files. The game folders are spread over the given
+*	number of folder levels, 16 folders wide. Every c-th slave is a copy
+*	of the one before it. The results are printed one phase per line,
+*	as key=value pairs.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/osfuncs.h"
+#include "../src/scanner.h"
+#include "../src/slavefuncs.h"
+
+#define SLAVE_SIZE 4096
+#define DATA_FILE_SIZE 256
+#define FOLDERS_WIDE 16
+
+static int make_dirs(char* path)
+{
+	char* c;
+
+	for (c = path + 1; *c; c++)
+	{
+		if (*c == '/')
+		{
+			*c = '\0';
+			if (mkdir(path, 0755) && errno != EEXIST)
+				return 0;
+			*c = '/';
+		}
+	}
+
+	return !mkdir(path, 0755) || errno == EEXIST;
+}
+
+static int write_file(const char* path, const unsigned char* data, size_t size)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return 0;
+
+	const int result = fwrite(data, 1, size, fp) == size;
+	return !fclose(fp) && result;
+}
+
+/* A version 17 slave with the name of the game, the rest is noise */
+static void make_slave(unsigned char* slave, int game)
+{
+	unsigned long seed = 12345 + game;
+	char name[32];
+	int i;
+
+	for (i = 0; i < SLAVE_SIZE; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		slave[i] = (unsigned char)(seed >> 16);
+	}
+
+	memset(slave, 0, 32 + 52);
+	memcpy(slave + 32 + 4, "WHDLOADS", 8);
+	slave[32 + 13] = 17;
+	slave[32 + 18] = 0x08;
+	slave[32 + 36] = 0x01;
+	snprintf(name, sizeof(name), "Game %d", game);
+	memcpy(slave + 32 + 0x100, name, strlen(name) + 1);
+}
+
+static int generate(const char* root, int games, int files, int depth, int copies)
+{
+	unsigned char slave[SLAVE_SIZE], data[DATA_FILE_SIZE];
+	char path[512], file[600];
+	int game, level, i;
+
+	memset(data, 0x55, sizeof(data));
+
+	for (game = 0; game < games; game++)
+	{
+		int length = snprintf(path, sizeof(path), "%s", root);
+		int rest = game;
+
+		for (level = 0; level < depth; level++)
+		{
+			length += snprintf(path + length, sizeof(path) - length, "/%c%02d", 'A' + level, rest % FOLDERS_WIDE);
+			rest /= FOLDERS_WIDE;
+		}
+		snprintf(path + length, sizeof(path) - length, "/Game%05d/data", game);
+		if (!make_dirs(path))
+			return 0;
+
+		path[strlen(path) - 5] = '\0';
+		make_slave(slave, copies > 0 && game % copies == copies - 1 ? game - 1 : game);
+		// The scanner gives the slave names in lower case, which the host filesystem would mind
+		snprintf(file, sizeof(file), "%s/game%05d.slave", path, game);
+		if (!write_file(file, slave, sizeof(slave)))
+			return 0;
+
+		snprintf(file, sizeof(file), "%s/Game%05d.info", path, game);
+		if (!write_file(file, data, sizeof(data)))
+			return 0;
+
+		for (i = 0; i < files; i++)
+		{
+			snprintf(file, sizeof(file), "%s/data/disk.%d", path, i + 1);
+			if (!write_file(file, data, sizeof(data)))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void print_scan(const char* phase, const scan_job* job)
+{
+	const unsigned long milliseconds = job->milliseconds ? job->milliseconds : 1;
+
+	printf("phase=%s dirs_read=%d dirs_reused=%d slaves=%d entries=%lu ms=%lu dirs_per_s=%lu slaves_per_s=%lu "
+		"peak_kb=%lu depth=%d\n", phase, job->dirs_read, job->dirs_reused, job->slaves_count, job->entries_count,
+		job->milliseconds, (job->dirs_read + job->dirs_reused) * 1000UL / milliseconds,
+		job->slaves_count * 1000UL / milliseconds, (unsigned long)((job->peak_memory + 1023) / 1024),
+		job->max_depth_reached);
+}
+
+static int run_scan(scan_job* job, const char** repos, const char** excludes, const scan_cache* cache)
+{
+	memset(job, 0, sizeof(scan_job));
+	job->repos = repos;
+	job->excludes = excludes;
+	job->repos_count = 1;
+	job->cache = cache;
+	job->prune_game_dirs = 1;
+
+	return scan_run(job);
+}
+
+static void read_titles(const char* phase, slave_cache* cache, const scan_job* job, unsigned long* crcs)
+{
+	const unsigned long start = os_milliseconds();
+	int i;
+
+	for (i = 0; i < job->slaves_count; i++)
+	{
+		const slave_info* info = slave_cache_get(cache, job->slaves[i].path);
+		crcs[i] = info ? info->crc : 0;
+	}
+
+	const unsigned long milliseconds = os_milliseconds() - start;
+	printf("phase=%s slaves=%d hits=%d misses=%d ms=%lu slaves_per_s=%lu\n", phase, job->slaves_count,
+		cache->hits, cache->misses, milliseconds, job->slaves_count * 1000UL / (milliseconds ? milliseconds : 1));
+}
+
+static int compare_paths(const void* a, const void* b)
+{
+	return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+/*
+ * Merges the scan with a list where every 10th game is missing and
+ * every 20th is in another folder, as after moving some games around
+ */
+static int merge(const scan_job* job, const unsigned long* crcs)
+{
+	const char** known = malloc(sizeof(char*) * (job->slaves_count + 1));
+	char* moved = malloc((size_t)SCAN_PATH_SIZE * (job->slaves_count / 20 + 1));
+	int i, count = 0, moved_count = 0;
+	scan_diff_input input;
+	scan_diff diff;
+
+	if (known == NULL || moved == NULL)
+		return 0;
+
+	for (i = 0; i < job->slaves_count; i++)
+	{
+		if (i % 20 == 19)
+		{
+			const char* slash = strrchr(job->slaves[i].path, '/');
+			char* path = moved + (size_t)SCAN_PATH_SIZE * moved_count++;
+
+			while (slash > job->slaves[i].path && slash[-1] != '/')
+				slash--;
+			snprintf(path, SCAN_PATH_SIZE, "Old:%s", slash);
+			known[count++] = path;
+		}
+		else if (i % 10 != 9)
+		{
+			known[count++] = job->slaves[i].path;
+		}
+	}
+	qsort(known, count, sizeof(char*), compare_paths);
+
+	input.slaves = job->slaves;
+	input.slave_crcs = crcs;
+	input.slaves_count = job->slaves_count;
+	input.known = known;
+	input.known_crcs = NULL;
+	input.known_count = count;
+
+	const unsigned long start = os_milliseconds();
+	const int result = scan_diff_run(&diff, &input);
+	const unsigned long milliseconds = os_milliseconds() - start;
+
+	if (result)
+	{
+		printf("phase=merge known=%d slaves=%d added=%d removed=%d moved=%d copies=%d ms=%lu\n", count,
+			job->slaves_count, diff.added_count, diff.removed_count, diff.moved_count, diff.copies_count,
+			milliseconds);
+		scan_diff_free(&diff);
+	}
+
+	free(known);
+	free(moved);
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	int games = 2000, files = 20, depth = 2, copies = 0, option;
+	slave_cache slaves;
+	scan_job cold, warm;
+	struct stat st;
+
+	while ((option = getopt(argc, argv, "g:f:d:c:")) != -1)
+	{
+		if (option == 'g')
+			games = atoi(optarg);
+		else if (option == 'f')
+			files = atoi(optarg);
+		else if (option == 'd')
+			depth = atoi(optarg);
+		else if (option == 'c')
+			copies = atoi(optarg);
+		else
+			optind = argc;
+	}
+
+	if (optind != argc - 1)
+	{
+		printf("Usage: %s [-g games] [-f files] [-d depth] [-c copies] directory\n", argv[0]);
+		exit(0);
+	}
+
+	const char* repos[1] = { argv[optind] };
+	const char* excludes[1] = { "" };
+
+	if (stat(repos[0], &st))
+	{
+		const unsigned long start = os_milliseconds();
+		char root[512];
+
+		snprintf(root, sizeof(root), "%s", repos[0]);
+		if (!generate(root, games, files, depth, copies))
+		{
+			printf("Could not generate %s\n", repos[0]);
+			exit(1);
+		}
+		printf("phase=generate games=%d files=%d depth=%d copies=%d ms=%lu\n", games, files, depth, copies,
+			os_milliseconds() - start);
+	}
+
+	// The second scan only reads the directories that changed since the first one
+	if (!run_scan(&cold, repos, excludes, NULL))
+	{
+		printf("Scan failed\n");
+		exit(1);
+	}
+	print_scan("scan", &cold);
+
+	if (!run_scan(&warm, repos, excludes, &cold.new_cache))
+	{
+		printf("Scan failed\n");
+		exit(1);
+	}
+	print_scan("rescan", &warm);
+
+	unsigned long* crcs = malloc(sizeof(unsigned long) * (cold.slaves_count + 1));
+	if (crcs == NULL)
+		exit(1);
+
+	memset(&slaves, 0, sizeof(slaves));
+	read_titles("titles", &slaves, &cold, crcs);
+	slaves.hits = slaves.misses = 0;
+	read_titles("titles_cached", &slaves, &cold, crcs);
+
+	if (!merge(&cold, crcs))
+	{
+		printf("Merge failed\n");
+		exit(1);
+	}
+
+	slave_cache_free(&slaves);
+	free(crcs);
+	scan_free(&warm);
+	scan_free(&cold);
+
+	return 0;
+}
@@ -0,0 +1,199 @@
+/*
+*	screenshot_bench.c
+*	generates pictures and measures how fast iGame scales them for the
+*	side panel, and how fast it reads them back from the thumbnail pack
+*
+*	gcc -O2 -o screenshot_bench screenshot_bench.c ../src/screenshot.c ../src/thumbpack.c ../src/osfuncs_posix.c -lpthread
+*
+*	screenshot_bench [-p pictures] [-w width] [-h height] directory
+*
+*	The pictures are generated in directory/pictures as PPM files of
+*	640x512, only if that does not exist. The pack is directory/thumbnails,
+*	and is deleted first. The results are printed one phase per line, as
+*	key=value pairs, and a check that fails ends it with an error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/osfuncs.h"
+#include "../src/screenshot.h"
+#include "../src/thumbpack.h"
+
+#define PICTURE_WIDTH 640
+#define PICTURE_HEIGHT 512
+
+static int write_picture(const char* path, const int seed)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return 0;
+
+	fprintf(fp, "P6\n%d %d\n255\n", PICTURE_WIDTH, PICTURE_HEIGHT);
+	for (int y = 0; y < PICTURE_HEIGHT; y++)
+	{
+		for (int x = 0; x < PICTURE_WIDTH; x++)
+		{
+			fputc((x + seed * 7) & 0xff, fp);
+			fputc((y + seed * 13) & 0xff, fp);
+			fputc(((x ^ y) + seed) & 0xff, fp);
+		}
+	}
+
+	return !fclose(fp);
+}
+
+static void check(const int ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("error=\"%s\"\n", what);
+		exit(1);
+	}
+}
+
+static int same_image(const screenshot_image* a, const screenshot_image* b)
+{
+	return a->width == b->width && a->height == b->height && a->colors == b->colors
+		&& !memcmp(a->palette, b->palette, sizeof(unsigned long) * a->colors)
+		&& !memcmp(a->pixels, b->pixels, (size_t)a->width * a->height);
+}
+
+static double seconds_since(const struct timespec* start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+	int pictures = 20, width = 320, height = 256, option;
+	char pictures_dir[256], pack_file[256], path[512];
+	thumb_pack pack;
+	struct timespec start;
+	struct stat st;
+	unsigned long size;
+	os_date date;
+
+	while ((option = getopt(argc, argv, "p:w:h:")) != -1)
+	{
+		if (option == 'p')
+			pictures = atoi(optarg);
+		else if (option == 'w')
+			width = atoi(optarg);
+		else if (option == 'h')
+			height = atoi(optarg);
+		else
+			optind = argc;
+	}
+
+	if (optind != argc - 1 || pictures < 2 || width < 2 || height < 2)
+	{
+		printf("Usage: %s [-p pictures (2 or more)] [-w width] [-h height] directory\n", argv[0]);
+		exit(0);
+	}
+
+	snprintf(pictures_dir, sizeof(pictures_dir), "%s/pictures", argv[optind]);
+	snprintf(pack_file, sizeof(pack_file), "%s/thumbnails", argv[optind]);
+	mkdir(argv[optind], 0755);
+	if (stat(pictures_dir, &st))
+	{
+		check(!mkdir(pictures_dir, 0755), "could not create the pictures folder");
+		for (int i = 0; i < pictures; i++)
+		{
+			snprintf(path, sizeof(path), "%s/%d.ppm", pictures_dir, i);
+			check(write_picture(path, i), "could not write a picture");
+		}
+	}
+	remove(pack_file);
+
+	screenshot_image** images = calloc(pictures, sizeof(screenshot_image*));
+	check(images != NULL, "no memory");
+
+	// Every picture is scaled and added to the pack
+	check(thumb_pack_open(&pack, pack_file, width, height), "could not open the pack");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < pictures; i++)
+	{
+		snprintf(path, sizeof(path), "%s/%d.ppm", pictures_dir, i);
+		check(os_file_info(path, &size, &date), "a picture is missing");
+		check((images[i] = screenshot_load(path, width, height, NULL)) != NULL, "could not scale a picture");
+		check(images[i]->width <= width && images[i]->height <= height, "a picture does not fit");
+		check(thumb_pack_add(&pack, path, &date, images[i]), "could not add a thumbnail");
+	}
+	const double scale_time = seconds_since(&start);
+	thumb_pack_close(&pack);
+	printf("phase=scale pictures=%d seconds=%.3f ms_per_picture=%.2f\n", pictures, scale_time,
+		scale_time * 1000 / pictures);
+
+	// The pack opened again has the same thumbnails
+	check(thumb_pack_open(&pack, pack_file, width, height), "could not open the pack again");
+	check(pack.count == pictures, "the index lost thumbnails");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < pictures; i++)
+	{
+		snprintf(path, sizeof(path), "%s/%d.ppm", pictures_dir, i);
+		check(os_file_info(path, &size, &date), "a picture is missing");
+		screenshot_image* image = thumb_pack_get(&pack, path, &date);
+		check(image != NULL, "a thumbnail is missing");
+		check(same_image(image, images[i]), "a thumbnail differs from the picture scaled");
+		screenshot_free(image);
+	}
+	const double read_time = seconds_since(&start);
+	check(stat(pack_file, &st) == 0, "the pack is missing");
+	printf("phase=read pictures=%d seconds=%.3f ms_per_picture=%.3f pack_kb=%ld speedup=%.0f\n", pictures,
+		read_time, read_time * 1000 / pictures, (long)(st.st_size / 1024),
+		read_time > 0 ? scale_time / read_time : 0);
+
+	// A thumbnail older than its picture is not used
+	snprintf(path, sizeof(path), "%s/0.ppm", pictures_dir);
+	check(os_file_info(path, &size, &date), "a picture is missing");
+	date.seconds++;
+	check(thumb_pack_get(&pack, path, &date) == NULL, "a thumbnail older than the picture was used");
+	printf("phase=date\n");
+
+	// Adding them all again leaves the file to be written again without the old ones
+	for (int round = 0; round < 3; round++)
+	{
+		for (int i = 0; i < pictures; i++)
+		{
+			snprintf(path, sizeof(path), "%s/%d.ppm", pictures_dir, i);
+			check(os_file_info(path, &size, &date), "a picture is missing");
+			check(thumb_pack_add(&pack, path, &date, images[i]), "could not replace a thumbnail");
+		}
+	}
+	thumb_pack_close(&pack);
+	check(thumb_pack_open(&pack, pack_file, width, height), "could not open the pack again");
+	check(pack.count == pictures, "the index lost thumbnails after replacing them");
+	check(pack.end - 32 - pack.live_size <= pack.live_size || pack.end - 32 - pack.live_size <= 65536,
+		"the unused parts were not dropped");
+	for (int i = 0; i < pictures; i++)
+	{
+		snprintf(path, sizeof(path), "%s/%d.ppm", pictures_dir, i);
+		check(os_file_info(path, &size, &date), "a picture is missing");
+		screenshot_image* image = thumb_pack_get(&pack, path, &date);
+		check(image != NULL && same_image(image, images[i]), "a thumbnail was lost making the pack smaller");
+		screenshot_free(image);
+	}
+	thumb_pack_close(&pack);
+	check(stat(pack_file, &st) == 0, "the pack is missing");
+	printf("phase=compact pack_kb=%ld\n", (long)(st.st_size / 1024));
+
+	// A pack of another size is started over
+	check(thumb_pack_open(&pack, pack_file, width / 2, height / 2), "could not open the pack at another size");
+	check(pack.count == 0, "thumbnails of another size were kept");
+	thumb_pack_close(&pack);
+	printf("phase=resize\n");
+
+	for (int i = 0; i < pictures; i++)
+		screenshot_free(images[i]);
+	free(images);
+	printf("phase=done\n");
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+*	slave_check.c
+*	checks the slave header parser of iGame against crafted slaves:
+*	every version, cut at every length and with strings at odd places
+*
+*	gcc -g -fsanitize=address,undefined -o slave_check slave_check.c ../src/slaveheader.c
+*
+*	Every slave is parsed from a copy of exactly its size, so with the
+*	address sanitizer a read past the data stops it. The results are
+*	printed one phase per line, as key=value pairs, and a check that
+*	fails ends it with an error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/slaveheader.h"
+
+/* The slave structure of version 17 and the strings after it */
+#define SLAVE_SIZE 52
+#define NAME "Test Game"
+#define COPY "1990 Someone"
+#define INFO "Installed by\377someone else"
+#define INFO_READ "Installed by\nsomeone else"
+#define CURRENT_DIR "data"
+#define KICK_NAME "kick34005.A500"
+#define CONFIG "C1:B:Trainer"
+
+static unsigned char slave[SLAVE_HEADER_OFFSET + SLAVE_SIZE + 128];
+static long slave_length;
+
+static void check(const int ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("error=\"%s\"\n", what);
+		exit(1);
+	}
+}
+
+static void put_word(unsigned char* p, const unsigned long value)
+{
+	p[0] = (unsigned char)(value >> 8);
+	p[1] = (unsigned char)value;
+}
+
+static void put_long(unsigned char* p, const unsigned long value)
+{
+	put_word(p, value >> 16);
+	put_word(p + 2, value);
+}
+
+/* Puts the string after the ones before it and its offset in the field */
+static void put_string(const int field, const char* string, const int odd)
+{
+	if (odd && (slave_length - SLAVE_HEADER_OFFSET) % 2 == 0)
+		slave[slave_length++] = 0xAA;
+
+	put_word(slave + SLAVE_HEADER_OFFSET + field, slave_length - SLAVE_HEADER_OFFSET);
+	memcpy(slave + slave_length, string, strlen(string) + 1);
+	slave_length += strlen(string) + 1;
+}
+
+/* A slave of the version, with every field set, and the strings at odd offsets if asked */
+static void build_slave(const unsigned short version, const int odd)
+{
+	unsigned char* s = slave + SLAVE_HEADER_OFFSET;
+
+	memset(slave, 0, sizeof(slave));
+	put_long(slave, 0x3F3);
+	put_long(slave + 8, 1);
+	put_long(slave + 20, 0x3E9);
+
+	memcpy(s + 4, "WHDLOADS", 8);
+	put_word(s + 12, version);
+	put_word(s + 14, 0x1234);
+	put_long(s + 16, 0x80000);
+	put_long(s + 20, 0xDEADBEEF);
+	put_word(s + 24, 0x200);
+	s[30] = 0x5F;
+	s[31] = 0x59;
+	put_long(s + 32, 0x40000);
+	put_long(s + 44, 0x40000);
+	put_word(s + 48, 0xF8E3);
+
+	slave_length = SLAVE_HEADER_OFFSET + SLAVE_SIZE;
+	put_string(26, CURRENT_DIR, odd);
+	put_word(s + 28, 0x300);
+	put_string(36, NAME, odd);
+	put_string(38, COPY, odd);
+	put_string(40, INFO, odd);
+	put_string(42, KICK_NAME, odd);
+	put_string(50, CONFIG, odd);
+}
+
+/* Parses the first length bytes from a copy of just that size */
+static int parse_cut(const long length, slave_header* header)
+{
+	unsigned char* cut = malloc(length > 0 ? length : 1);
+	int result;
+
+	check(cut != NULL, "not enough memory");
+	memcpy(cut, slave, length);
+	result = slave_parse(cut, length, header);
+	free(cut);
+
+	return result;
+}
+
+static void check_string(const unsigned char* data, const long length, const long position, const char* expected,
+	const char* what)
+{
+	char string[64];
+
+	check(position != 0, what);
+	check(slave_string(data, length, position, string, sizeof(string)) && !strcmp(string, expected), what);
+}
+
+/* A field is set only if the version of the slave has it and the cut reaches its end */
+static void check_fields(const slave_header* header, const unsigned short version, const long length)
+{
+	const long size = length - SLAVE_HEADER_OFFSET;
+
+	check(header->version == version && header->flags == 0x1234, "wrong version or flags");
+	check(header->base_mem_size == 0x80000 && header->exec_install == 0xDEADBEEF, "wrong memory or install");
+	check(header->game_loader == SLAVE_HEADER_OFFSET + 0x200 && header->dont_cache == SLAVE_HEADER_OFFSET + 0x300,
+		"wrong loader or dont cache");
+	check(header->current_dir != 0, "no current dir");
+
+	check((header->key_debug == 0x5F && header->key_exit == 0x59) == (version >= 4 && size >= 32), "keys of version 4");
+	check((header->exp_mem == 0x40000) == (version >= 8 && size >= 36), "expansion memory of version 8");
+	check((header->name && header->copy && header->info) == (version >= 10 && size >= 42), "strings of version 10");
+	check((header->kick_name && header->kick_size == 0x40000 && header->kick_crc == 0xF8E3)
+		== (version >= 16 && size >= 50), "kickstart of version 16");
+	check((header->config != 0) == (version >= 17 && size >= 52), "config of version 17");
+
+	check(version >= 4 || (!header->key_debug && !header->key_exit), "keys before version 4");
+	check(version >= 10 || (!header->name && !header->copy && !header->info), "strings before version 10");
+	check(version >= 16 || (!header->kick_name && !header->kick_size && !header->kick_crc), "kickstart before 16");
+}
+
+static void check_strings(const slave_header* header)
+{
+	check_string(slave, slave_length, header->current_dir, CURRENT_DIR, "wrong current dir");
+	check_string(slave, slave_length, header->name, NAME, "wrong name");
+	check_string(slave, slave_length, header->copy, COPY, "wrong copyright");
+	check_string(slave, slave_length, header->info, INFO_READ, "wrong info");
+	check_string(slave, slave_length, header->kick_name, KICK_NAME, "wrong kickstart name");
+	check_string(slave, slave_length, header->config, CONFIG, "wrong config");
+}
+
+/* Every string cut before its NUL gives the part that is there and 0 */
+static void check_string_cuts(const slave_header* header)
+{
+	char string[64];
+	long length;
+
+	for (length = header->name; length <= header->name + (long)strlen(NAME); length++)
+	{
+		unsigned char* cut = malloc(length);
+		const int ended = length > header->name + (long)strlen(NAME);
+
+		check(cut != NULL, "not enough memory");
+		memcpy(cut, slave, length);
+		check(slave_string(cut, length, header->name, string, sizeof(string)) == ended, "cut string ended");
+		check(!strncmp(string, NAME, length - header->name) && (long)strlen(string) == length - header->name,
+			"cut string not the part that is there");
+		free(cut);
+	}
+}
+
+int main(void)
+{
+	static const unsigned short versions[] = { 1, 3, 4, 7, 8, 9, 10, 15, 16, 17, 18 };
+	slave_header header;
+	char string[64];
+	size_t i;
+	long length, cuts;
+	int odd;
+
+	for (odd = 0; odd <= 1; odd++)
+	{
+		for (i = 0, cuts = 0; i < sizeof(versions) / sizeof(versions[0]); i++)
+		{
+			build_slave(versions[i], odd);
+
+			check(parse_cut(slave_length, &header), "not a slave");
+			check_fields(&header, versions[i], slave_length);
+			if (versions[i] >= 17)
+			{
+				check_strings(&header);
+				check(!odd || (header.name - SLAVE_HEADER_OFFSET) % 2 == 1, "name not at an odd offset");
+			}
+
+			// Shorter than the first version of the structure is not a slave
+			for (length = 0; length <= slave_length; length++, cuts++)
+			{
+				const int result = parse_cut(length, &header);
+
+				check(result == (length >= SLAVE_HEADER_OFFSET + 30), "wrong result for a cut");
+				if (result)
+					check_fields(&header, versions[i], length);
+			}
+		}
+
+		printf("phase=versions odd=%d versions=%d cuts=%ld\n", odd, (int)(sizeof(versions) / sizeof(versions[0])),
+			cuts);
+	}
+
+	build_slave(17, 1);
+	check(slave_parse(slave, slave_length, &header), "not a slave");
+	check_string_cuts(&header);
+
+	// Strings that are not there, or don't fit
+	check(!slave_string(slave, slave_length, slave_length, string, sizeof(string)) && string[0] == '\0',
+		"string at the end");
+	check(!slave_string(slave, slave_length, SLAVE_HEADER_OFFSET + 0xFFFF, string, sizeof(string))
+		&& string[0] == '\0', "string past the end");
+	check(!slave_string(slave, slave_length, -1, string, sizeof(string)) && string[0] == '\0', "string before the start");
+	check(slave_string(slave, slave_length, header.name, string, 5) && !strcmp(string, "Test"), "string cut to size");
+	check(!slave_string(slave, slave_length, header.name, string, 0), "string of no size");
+	printf("phase=strings\n");
+
+	// Not a slave
+	memcpy(slave + SLAVE_HEADER_OFFSET + 4, "WHDLOADX", 8);
+	check(!slave_parse(slave, slave_length, &header) && header.version == 0, "wrong magic is a slave");
+	printf("phase=magic\n");
+
+	printf("phase=done\n");
+	return 0;
+}
@@ -1,30 +1,29 @@
+/*
+*	slave_title2.c
+*	prints the header of a WHDLoad slave
+*
+*	gcc -o slave_title2 slave_title2.c ../src/slaveheader.c
+*/
+
 #include <stdio.h>
 #include <stdlib.h>
 
-int main(int argc, char* argv[])
+#include "../src/slaveheader.h"
+
+static void print_string(const char* label, const unsigned char* data, const long length, const long position)
 {
-	char Title[100];
+	char text[256];
 
-	struct SlaveInfo
+	if (position)
 	{
-		unsigned long Security;
-		char ID[8];
-		unsigned short Version;
-		unsigned short Flags;
-		unsigned long BaseMemSize;
-		unsigned long ExecInstall;
-		unsigned short GameLoader;
-		unsigned short CurrentDir;
-		unsigned short DontCache;
-		char keydebug;
-		char keyexit;
-		unsigned long ExpMem;
-		unsigned short name;
-		unsigned short copy;
-		unsigned short info;
-	};
+		slave_string(data, length, position, text, sizeof(text));
+		printf("%s: [%s]\n", label, text);
+	}
+}
 
-	struct SlaveInfo sl;
+int main(int argc, char* argv[])
+{
+	slave_header header;
 
 	if (argc == 1)
 	{
@@ -39,33 +38,46 @@ int main(int argc, char* argv[])
 		exit(0);
 	}
 
-	//seek to +0x20
-	fseek(fp, 32, SEEK_SET);
-
-	fread(&sl, 1, sizeof(sl), fp);
+	// The whole slave is read at once, slaves are small
+	fseek(fp, 0, SEEK_END);
+	const long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
 
+	unsigned char* data = malloc(length > 0 ? length : 1);
+	if (data == NULL || fread(data, 1, length, fp) != (size_t)length)
+	{
+		printf("Could not read %s\n", argv[1]);
+		exit(0);
+	}
+	fclose(fp);
 
-	sl.Version = (sl.Version >> 8) | (sl.Version << 8);
-	sl.name = (sl.name >> 8) | (sl.name << 8);
-
-	printf("[%s] [%d]\n", sl.ID, sl.Version);
+	if (!slave_parse(data, length, &header))
+	{
+		printf("%s is not a WHDLoad slave\n", argv[1]);
+		exit(0);
+	}
 
-	//sl.name holds the offset for the slave name
-	fseek(fp, sl.name + 32, SEEK_SET);
-	//title = calloc (1, 100);
-	//fread (title, 1, 100, fp);
+	printf("Version: %d\n", header.version);
+	printf("Flags: $%04x\n", header.flags);
+	printf("BaseMemSize: %lu\n", header.base_mem_size);
+	printf("ExpMem: %lu\n", header.exp_mem);
+	print_string("CurrentDir", data, length, header.current_dir);
+	print_string("Name", data, length, header.name);
+	print_string("Copy", data, length, header.copy);
+	print_string("Info", data, length, header.info);
 
-	for (int i = 0; i <= 99; i++)
+	if (header.kick_name)
 	{
-		Title[i] = fgetc(fp);
-		if (Title[i] == '\n')
-		{
-			Title[i] = '\0';
-			break;
-		}
+		if (header.kick_crc == SLAVE_KICK_LIST)
+			printf("Kickstart: more than one\n");
+		else
+			print_string("Kickstart", data, length, header.kick_name);
+		printf("KickSize: %lu\n", header.kick_size);
+		printf("KickCRC: $%04x\n", header.kick_crc);
 	}
 
-	printf("[%s]\n", Title);
+	print_string("Config", data, length, header.config);
 
-	//fclose(fp);	
+	free(data);
+	return 0;
 }
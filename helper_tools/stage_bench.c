@@ -0,0 +1,224 @@
+/*
+*	stage_bench.c
+*	generates game folders and measures how fast iGame stages them,
+*	checking the budget, the dates and the files copied back
+*
+*	gcc -O2 -o stage_bench stage_bench.c ../src/stagecache.c ../src/osfuncs_posix.c -lpthread
+*
+*	stage_bench [-g games] [-s size in KB] [-b budget in KB] directory
+*
+*	The games are generated in directory/games, only if that does not
+*	exist, each with a slave, an icon and a data folder with 20 files
+*	of the given total size. The cache is directory/stage, and is
+*	emptied first. The results are printed one phase per line, as
+*	key=value pairs, and a check that fails ends it with an error.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/osfuncs.h"
+#include "../src/stagecache.h"
+
+#define DATA_FILES 20
+
+static int write_file(const char* path, size_t size)
+{
+	FILE* fp = fopen(path, "wb");
+	if (fp == NULL)
+		return 0;
+
+	for (size_t i = 0; i < size; i++)
+		fputc((int)(i * 31 % 251), fp);
+
+	return !fclose(fp);
+}
+
+static int same_file(const char* a, const char* b)
+{
+	FILE* fa = fopen(a, "rb");
+	FILE* fb = fopen(b, "rb");
+	int ca = 0, cb = 0, result = fa && fb;
+
+	while (result && ca != EOF)
+	{
+		ca = fgetc(fa);
+		cb = fgetc(fb);
+		result = ca == cb;
+	}
+
+	if (fa)
+		fclose(fa);
+	if (fb)
+		fclose(fb);
+
+	return result;
+}
+
+static void check(const int ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("error=\"%s\"\n", what);
+		exit(1);
+	}
+}
+
+static void generate(const char* games_dir, const int games, const size_t size)
+{
+	char path[512];
+
+	check(!mkdir(games_dir, 0755), "could not create the games folder");
+	for (int i = 0; i < games; i++)
+	{
+		snprintf(path, sizeof(path), "%s/Game%d", games_dir, i);
+		check(!mkdir(path, 0755), "could not create a game folder");
+		snprintf(path, sizeof(path), "%s/Game%d/Game%d.slave", games_dir, i, i);
+		check(write_file(path, 4096), "could not write a slave");
+		snprintf(path, sizeof(path), "%s/Game%d/Game%d.info", games_dir, i, i);
+		check(write_file(path, 1024), "could not write an icon");
+		snprintf(path, sizeof(path), "%s/Game%d/data", games_dir, i);
+		check(!mkdir(path, 0755), "could not create a data folder");
+
+		for (int j = 0; j < DATA_FILES; j++)
+		{
+			snprintf(path, sizeof(path), "%s/Game%d/data/disk.%d", games_dir, i, j);
+			check(write_file(path, size / DATA_FILES), "could not write a data file");
+		}
+	}
+}
+
+static double seconds_since(const struct timespec* start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+	int games = 10, size_kb = 1024, budget_kb = 4096, option;
+	char games_dir[256], stage_dir[256], source[sizeof(games_dir) + 16], copy[256], path[512], other[512];
+	stage_cache cache;
+	struct timespec start;
+	struct stat st;
+
+	while ((option = getopt(argc, argv, "g:s:b:")) != -1)
+	{
+		if (option == 'g')
+			games = atoi(optarg);
+		else if (option == 's')
+			size_kb = atoi(optarg);
+		else if (option == 'b')
+			budget_kb = atoi(optarg);
+		else
+			optind = argc;
+	}
+
+	if (optind != argc - 1 || games < 3)
+	{
+		printf("Usage: %s [-g games (3 or more)] [-s size in KB] [-b budget in KB] directory\n", argv[0]);
+		exit(0);
+	}
+
+	// The paths in the directory are sized to fit, as long as the directory fits
+	check(snprintf(games_dir, sizeof(games_dir), "%s/games", argv[optind]) < (int)sizeof(games_dir)
+		&& snprintf(stage_dir, sizeof(stage_dir), "%s/stage", argv[optind]) < (int)sizeof(stage_dir),
+		"the directory name is too long");
+	mkdir(argv[optind], 0755);
+	if (stat(games_dir, &st))
+		generate(games_dir, games, (size_t)size_kb * 1024);
+
+	snprintf(path, sizeof(path), "rm -rf \"%s\"", stage_dir);
+	check(!system(path), "could not empty the cache");
+
+	// Stage every game in turn, the oldest copies go when the budget is full
+	check(stage_cache_open(&cache, stage_dir, (unsigned long)budget_kb * 1024), "could not open the cache");
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	int staged = 0, too_big = 0;
+	for (int i = 0; i < games; i++)
+	{
+		snprintf(source, sizeof(source), "%s/Game%d", games_dir, i);
+		const int result = stage_cache_add(&cache, source, 0);
+		check(result == STAGE_OK || result == STAGE_TOO_BIG, "could not stage a game");
+		staged += result == STAGE_OK;
+		too_big += result == STAGE_TOO_BIG;
+		check(cache.used_size <= cache.budget, "the budget was exceeded");
+	}
+	const double copy_time = seconds_since(&start);
+	printf("phase=stage games=%d staged=%d too_big=%d kept=%d used_kb=%lu seconds=%.3f kb_per_second=%.0f\n",
+		games, staged, too_big, cache.count, cache.used_size / 1024, copy_time,
+		copy_time > 0 ? cache.copied / 1024 / copy_time : 0);
+
+	if (cache.count == 0)
+	{
+		stage_cache_close(&cache);
+		printf("phase=done note=\"no game fits in the budget\"\n");
+		return 0;
+	}
+
+	// The last one staged is kept and is a faithful copy
+	snprintf(source, sizeof(source), "%s/Game%d", games_dir, games - 1);
+	check(stage_cache_find(&cache, source, copy, sizeof(copy)), "the last game staged is not in the cache");
+	snprintf(path, sizeof(path), "%s/data/disk.%d", source, DATA_FILES - 1);
+	snprintf(other, sizeof(other), "%s/data/disk.%d", copy, DATA_FILES - 1);
+	check(same_file(path, other), "the copy differs from the game");
+	snprintf(path, sizeof(path), "%s/Game0", games_dir);
+	check(games * size_kb <= budget_kb || !stage_cache_find(&cache, path, other, sizeof(other)),
+		"the first game staged was not evicted");
+	printf("phase=find copy=\"%s\"\n", copy);
+
+	// A copy that is up to date is not copied again, and an index survives
+	stage_cache_close(&cache);
+	check(stage_cache_open(&cache, stage_dir, (unsigned long)budget_kb * 1024), "could not open the cache again");
+	const unsigned long copied = cache.copied;
+	check(stage_cache_add(&cache, source, 0) == STAGE_OK && cache.copied == copied, "an up to date copy was copied");
+
+	// The saves the game writes to its copy go back to the game folder
+	sleep(1);
+	snprintf(path, sizeof(path), "%s/Game%d.save", copy, games - 1);
+	check(write_file(path, 100), "could not write a save to the copy");
+	snprintf(path, sizeof(path), "%s/data/disk.0", copy);
+	check(write_file(path, 10), "could not change a file of the copy");
+	check(stage_cache_sync(&cache, source) == 2, "the saves were not copied back");
+	snprintf(path, sizeof(path), "%s/Game%d.save", source, games - 1);
+	snprintf(other, sizeof(other), "%s/Game%d.save", copy, games - 1);
+	check(same_file(path, other), "the save differs in the game folder");
+	check(stage_cache_sync(&cache, source) == 0, "the saves were copied back twice");
+	check(stage_cache_find(&cache, source, copy, sizeof(copy)), "the copy was dropped after copying back");
+	printf("phase=sync synced=2\n");
+
+	// A change in the game folder makes the copy go
+	sleep(1);
+	// Only adding, deleting or renaming a file changes the date of a folder
+	snprintf(path, sizeof(path), "%s/readme", source);
+	remove(path);
+	check(write_file(path, 10), "could not change the game folder");
+	check(!stage_cache_find(&cache, source, copy, sizeof(copy)), "a copy older than the game was used");
+	check(stage_cache_add(&cache, source, 0) == STAGE_OK, "could not stage the game again");
+	check(stage_cache_find(&cache, source, copy, sizeof(copy)), "the new copy is not in the cache");
+	snprintf(path, sizeof(path), "%s/readme", copy);
+	check(!stat(path, &st), "the new copy is not up to date");
+	printf("phase=recopy\n");
+
+	// Copies used since keep_since are not evicted for a new one
+	const unsigned long keep_since = cache.clock + 1;
+	int kept = 0;
+	for (int i = 0; i < games; i++)
+	{
+		snprintf(source, sizeof(source), "%s/Game%d", games_dir, i);
+		kept += stage_cache_add(&cache, source, keep_since) == STAGE_OK;
+	}
+	check(kept == cache.count, "a copy kept for this pass was evicted");
+	printf("phase=keep kept=%d\n", kept);
+
+	stage_cache_close(&cache);
+	printf("phase=done\n");
+	return 0;
+}
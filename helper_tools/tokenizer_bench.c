@@ -0,0 +1,260 @@
+/*
+*	tokenizer_bench.c
+*	checks the tokenizer of iGame against a plain split of random strings,
+*	and measures how fast it splits the tooltypes of an icon
+*
+*	gcc -O2 -o tokenizer_bench tokenizer_bench.c ../src/tokenizer.c
+*
+*	tokenizer_bench [-n strings] [-s size in KB]
+*
+*	The random strings are made of few letters, so the delimiters,
+*	some of them longer than a letter, are found often, next to each
+*	other and at both ends. The tooltypes are split into lines, as in
+*	the game properties, and every tooltype into its name and value,
+*	as iGame does, and compared with copying every token, as my_split()
+*	did. The results are printed one phase per line, as key=value
+*	pairs, and a check that fails ends it with an error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/tokenizer.h"
+
+#define MAX_STRING 64
+#define MAX_TOKENS (MAX_STRING + 1)
+
+static const char* delimiters[] = { "=", "x", "\n", "ab", "aa", "a=a", "", NULL };
+
+static void check(const int ok, const char* what)
+{
+	if (!ok)
+	{
+		printf("error=\"%s\"\n", what);
+		exit(1);
+	}
+}
+
+static double seconds_since(const clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* Splits on every delimiter, from the left, one byte at a time */
+static int plain_split(const char* str, const char* delimiter, const char** tokens, size_t* lengths)
+{
+	const size_t length = strlen(str);
+	const size_t delimiter_length = delimiter ? strlen(delimiter) : 0;
+	size_t start = 0, i = 0;
+	int count = 0;
+
+	while (delimiter_length && i + delimiter_length <= length)
+	{
+		if (!memcmp(str + i, delimiter, delimiter_length))
+		{
+			tokens[count] = str + start;
+			lengths[count++] = i - start;
+			i += delimiter_length;
+			start = i;
+		}
+		else
+			i++;
+	}
+	tokens[count] = str + start;
+	lengths[count++] = length - start;
+
+	return count;
+}
+
+static void fuzz(const int strings)
+{
+	static const char letters[] = "ab=x\n";
+	const char* expected[MAX_TOKENS];
+	size_t expected_lengths[MAX_TOKENS];
+	char str[MAX_STRING + 1];
+	unsigned long tokens = 0;
+	tokenizer tok;
+	const char* token;
+	size_t length;
+	int i, j, count;
+
+	// No string at all has no tokens
+	tokenizer_init(&tok, NULL, "=");
+	check(!tokenizer_next(&tok, &token, &length), "token in no string");
+
+	for (i = 0; i < strings; i++)
+	{
+		const char* delimiter = delimiters[i % (sizeof(delimiters) / sizeof(delimiters[0]))];
+		const int str_length = rand() % (MAX_STRING + 1);
+
+		for (j = 0; j < str_length; j++)
+			str[j] = letters[rand() % (sizeof(letters) - 1)];
+		str[str_length] = '\0';
+
+		count = plain_split(str, delimiter, expected, expected_lengths);
+
+		tokenizer_init(&tok, str, delimiter);
+		for (j = 0; tokenizer_next(&tok, &token, &length); j++)
+		{
+			check(j < count, "more tokens than the plain split");
+			check(token == expected[j] && length == expected_lengths[j], "token not the one of the plain split");
+			check(token + length <= str + str_length, "token past the string");
+		}
+		check(j == count, "fewer tokens than the plain split");
+		check(!tokenizer_next(&tok, &token, &length), "token after the end");
+		check(strlen(str) == (size_t)str_length, "string changed");
+		tokens += count;
+	}
+
+	printf("phase=fuzz strings=%d tokens=%lu\n", strings, tokens);
+}
+
+/* Tooltypes of a WHDLoad game, over and over up to the size */
+static char* make_tool_types(const size_t size)
+{
+	static const char* tool_types[] = { "SLAVE=Game.slave", "PRELOAD", "PRELOADSIZE=$80000", "CUSTOM1=1",
+		"(QUITKEY=$5d)", "SCREENSHOT=320x256", "BUTTONWAIT", "" };
+	char* text = malloc(size + 1);
+	size_t used = 0;
+	int i;
+
+	check(text != NULL, "not enough memory");
+	for (i = 0;; i = (i + 1) % (sizeof(tool_types) / sizeof(tool_types[0])))
+	{
+		const size_t length = strlen(tool_types[i]);
+
+		if (used + length + 1 > size)
+			break;
+		memcpy(text + used, tool_types[i], length);
+		used += length;
+		text[used++] = '\n';
+	}
+	text[used] = '\0';
+
+	return text;
+}
+
+static void bench(const size_t size)
+{
+	char* text = make_tool_types(size);
+	const size_t text_length = strlen(text);
+	const int rounds = (int)(64 * 1024 * 1024 / (text_length + 1)) + 1;
+	unsigned long lines = 0, copied = 0, values = 0, copied_values = 0;
+	char* terminated = strdup(text);
+	char** tool_types = malloc(sizeof(char*) * (text_length + 1));
+	int count = 0, i, j;
+	double seconds, copy_seconds;
+	clock_t start;
+
+	// The tooltypes come from icon.library one string each
+	check(terminated != NULL && tool_types != NULL, "not enough memory");
+	for (tool_types[count] = strtok(terminated, "\n"); tool_types[count] != NULL;
+		tool_types[++count] = strtok(NULL, "\n"))
+		;
+
+	// The way iGame reads tooltypes now, the lines of the text and the name and value of every tooltype
+	start = clock();
+	for (i = 0; i < rounds; i++)
+	{
+		tokenizer tok;
+		const char* token;
+		size_t length;
+
+		tokenizer_init(&tok, text, "\n");
+		while (tokenizer_next(&tok, &token, &length))
+			lines++;
+
+		for (j = 0; j < count; j++)
+		{
+			tokenizer_init(&tok, tool_types[j], "=");
+			tokenizer_next(&tok, &token, &length);
+			if (tokenizer_next(&tok, &token, &length))
+				values += token[0] == '$';
+		}
+	}
+	seconds = seconds_since(start);
+
+	// The way my_split() did it, every token copied
+	start = clock();
+	for (i = 0; i < rounds; i++)
+	{
+		char* copy = strdup(text);
+		char* line;
+
+		check(copy != NULL, "not enough memory");
+		for (line = strtok(copy, "\n"); line != NULL; line = strtok(NULL, "\n"))
+		{
+			char* name = strdup(line);
+
+			check(name != NULL, "not enough memory");
+			free(name);
+			copied++;
+		}
+		free(copy);
+
+		for (j = 0; j < count; j++)
+		{
+			const char* value = strchr(tool_types[j], '=');
+			char* name = strndup(tool_types[j], value ? (size_t)(value - tool_types[j]) : strlen(tool_types[j]));
+
+			check(name != NULL, "not enough memory");
+			if (value)
+			{
+				char* value_copy = strdup(value + 1);
+
+				check(value_copy != NULL, "not enough memory");
+				copied_values += value_copy[0] == '$';
+				free(value_copy);
+			}
+			free(name);
+		}
+	}
+	copy_seconds = seconds_since(start);
+
+	// strtok() skips the empty lines, the tokenizer keeps them
+	check(values == copied_values, "not the same values as the copies");
+	check(lines >= copied, "fewer lines than the copies");
+
+	if (seconds <= 0)
+		seconds = 0.001;
+	if (copy_seconds <= 0)
+		copy_seconds = 0.001;
+
+	printf("phase=bench size=%lu rounds=%d tool_types=%d seconds=%.3f mb_per_second=%.1f copy_seconds=%.3f "
+		"copy_mb_per_second=%.1f\n", (unsigned long)text_length, rounds, count, seconds,
+		(double)text_length * rounds / seconds / (1024 * 1024), copy_seconds,
+		(double)text_length * rounds / copy_seconds / (1024 * 1024));
+
+	free(tool_types);
+	free(terminated);
+	free(text);
+}
+
+int main(int argc, char* argv[])
+{
+	int strings = 200000;
+	size_t size = 4;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			strings = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			size = (size_t)atoi(argv[++i]);
+		else
+		{
+			printf("Usage: %s [-n strings] [-s size in KB]\n", argv[0]);
+			exit(0);
+		}
+	}
+
+	srand(1);
+	fuzz(strings);
+	bench(size > 0 ? size * 1024 : 1024);
+
+	printf("phase=done\n");
+	return 0;
+}
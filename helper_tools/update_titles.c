@@ -1,12 +1,16 @@
 /*
 *	update_titles.c
 *	scans a gamelist file and updates the titles from the slave info
+*
+*	gcc -o update_titles update_titles.c ../src/slaveheader.c
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "../src/slaveheader.h"
+
 extern char* strdup(const char* s);
 extern char* strcasestr(const char *haystack, const char *needle);
 
@@ -32,28 +36,8 @@ games_list *item_games = NULL, *games = NULL;
 */
 int get_title_from_slave(char* slave, char* title)
 {
-	char Title[100];
-
-	struct SlaveInfo
-	{
-		unsigned long Security;
-		char ID[8];
-		unsigned short Version;
-		unsigned short Flags;
-		unsigned long BaseMemSize;
-		unsigned long ExecInstall;
-		unsigned short GameLoader;
-		unsigned short CurrentDir;
-		unsigned short DontCache;
-		char keydebug;
-		char keyexit;
-		unsigned long ExpMem;
-		unsigned short name;
-		unsigned short copy;
-		unsigned short info;
-	};
-
-	struct SlaveInfo sl;
+	slave_header header;
+	int result = 1;
 
 	FILE* fp = fopen(slave, "rbe");
 	if (fp == NULL)
@@ -61,44 +45,24 @@ int get_title_from_slave(char* slave, char* title)
 		return 1;
 	}
 
-	//seek to +0x20
-	fseek(fp, 32, SEEK_SET);
-
-	fread(&sl, 1, sizeof(sl), fp);
-
+	// The whole slave is read at once, slaves are small
+	fseek(fp, 0, SEEK_END);
+	const long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
 
-	//sl.Version = (sl.Version>>8) | (sl.Version<<8);
-	//sl.name = (sl.name>>8) | (sl.name<<8);
-
-	//printf ("[%s] [%d]\n", sl.ID, sl.Version);
-
-	//sl.name holds the offset for the slave name
-	fseek(fp, sl.name + 32, SEEK_SET);
-	//title = calloc (1, 100);
-	//fread (title, 1, 100, fp);
-
-	if (sl.Version < 10)
+	unsigned char* data = malloc(length > 0 ? length : 1);
+	if (data != NULL && fread(data, 1, length, fp) == (size_t)length
+		&& slave_parse(data, length, &header) && header.name)
 	{
-		return 1;
+		slave_string(data, length, header.name, title, 100);
+		title[strcspn(title, "\n")] = '\0';
+		result = 0;
 	}
 
-	for (int i = 0; i <= 99; i++)
-	{
-		Title[i] = fgetc(fp);
-		if (Title[i] == '\n')
-		{
-			Title[i] = '\0';
-			break;
-		}
-	}
-
-	strcpy(title, Title);
-
-	//printf("[%s]\n", Title);
-
+	free(data);
 	fclose(fp);
 
-	return 0;
+	return result;
 }
 
 /*
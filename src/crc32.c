@@ -0,0 +1,90 @@
+/*
+  crc32.c
+  CRC-32 checksum source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Slicing-by-4: four tables let the loop take four bytes per step
+ * instead of one. The bytes are put together by hand, so the same
+ * code works on big and little endian CPUs, and the tables take 4KB,
+ * which is still fine on a 68000.
+ */
+
+#include "crc32.h"
+
+#define CRC32_POLYNOMIAL 0xEDB88320UL
+#define CRC32_MASK 0xFFFFFFFFUL
+
+static unsigned long crc_tables[4][256];
+static int crc_tables_ready = 0;
+
+/*
+ * Built on the first call. Callers on different processes have to
+ * make sure the first call is not made by two of them at once.
+ */
+static void make_tables(void)
+{
+	unsigned long crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++)
+	{
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = crc & 1 ? (crc >> 1) ^ CRC32_POLYNOMIAL : crc >> 1;
+		crc_tables[0][i] = crc;
+	}
+
+	for (i = 0; i < 256; i++)
+	{
+		crc = crc_tables[0][i];
+		for (j = 1; j < 4; j++)
+		{
+			crc = (crc >> 8) ^ crc_tables[0][crc & 0xFF];
+			crc_tables[j][i] = crc;
+		}
+	}
+
+	crc_tables_ready = 1;
+}
+
+unsigned long crc32_update(unsigned long crc, const void *data, size_t length)
+{
+	const unsigned char *p = data;
+
+	if (!crc_tables_ready)
+		make_tables();
+
+	crc = ~crc & CRC32_MASK;
+
+	while (length >= 4)
+	{
+		crc ^= (unsigned long)p[0] | ((unsigned long)p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+		crc = crc_tables[3][crc & 0xFF] ^ crc_tables[2][(crc >> 8) & 0xFF]
+			^ crc_tables[1][(crc >> 16) & 0xFF] ^ crc_tables[0][crc >> 24];
+		p += 4;
+		length -= 4;
+	}
+
+	while (length--)
+		crc = (crc >> 8) ^ crc_tables[0][(crc ^ *p++) & 0xFF];
+
+	return ~crc & CRC32_MASK;
+}
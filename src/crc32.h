@@ -0,0 +1,34 @@
+/*
+  crc32.h
+  CRC-32 checksum header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CRC32_H
+#define _CRC32_H
+
+#include <stddef.h>
+
+/*
+ * The CRC-32 of zip and PNG. Start with 0 and pass the result of
+ * the previous call to checksum data that comes in parts.
+ */
+unsigned long crc32_update(unsigned long, const void *, size_t);
+
+#endif
@@ -58,6 +58,7 @@
 #include "iGameGUI.h"
 #include "iGameExtern.h"
 #include "strfuncs.h"
+#include "tokenizer.h"
 #include "funcs.h"
 #include "fsfuncs.h"
 
@@ -217,6 +218,11 @@ void load_games_csv_list(const char *filename)
 
 				tmp = strtok(NULL, ";");
 				item_games->hidden = atoi(tmp);
+
+				// Lists saved before the play time was kept end here
+				tmp = strtok(NULL, ";");
+				if (tmp)
+					item_games->play_time = atoi(tmp);
 			}
 
 			if (games)
@@ -238,6 +244,26 @@ void load_games_csv_list(const char *filename)
 		free(buf);
 }
 
+/*
+ * Adds a line for a game that was played to the sessions file: when
+ * it started, in seconds since 1978 like the AmigaDOS dates, how many
+ * seconds it ran and its path. The play time in the list is the total.
+ */
+void save_session(const char *filename, const char *path, const unsigned long started, const unsigned long seconds)
+{
+	FILE *fp = fopen(filename, "a");
+
+	if (fp == NULL)
+	{
+		msg_box((const char*)GetMBString(MSG_FailedSavingSession));
+		return;
+	}
+
+	fprintf(fp, "%lu;%lu;%s\n", started, seconds, path);
+	if (fclose(fp))
+		msg_box((const char*)GetMBString(MSG_FailedSavingSession));
+}
+
 void save_to_csv(const char *filename, const int check_exists)
 {
 	char csvFilename[32];
@@ -266,9 +292,10 @@ void save_to_csv(const char *filename, const int check_exists)
 					strcpy(item_games->genre, "Unknown");
 				fprintf(
 					fpgames,
-					"%d;%s;%s;%s;%d;%d;%d;%d\n",
+					"%d;%s;%s;%s;%d;%d;%d;%d;%d\n",
 					item_games->index, item_games->title, item_games->genre, item_games->path,
-					item_games->favorite, item_games->times_played, item_games->last_played, item_games->hidden
+					item_games->favorite, item_games->times_played, item_games->last_played, item_games->hidden,
+					item_games->play_time
 				);
 			}
 			else
@@ -282,9 +309,10 @@ void save_to_csv(const char *filename, const int check_exists)
 				strcpy(item_games->genre, "Unknown");
 			fprintf(
 				fpgames,
-				"%d;%s;%s;%s;%d;%d;%d;%d\n",
+				"%d;%s;%s;%s;%d;%d;%d;%d;%d\n",
 				item_games->index, item_games->title, item_games->genre, item_games->path,
-				item_games->favorite, item_games->times_played, item_games->last_played, item_games->hidden
+				item_games->favorite, item_games->times_played, item_games->last_played, item_games->hidden,
+				item_games->play_time
 			);
 		}
 	}
@@ -307,34 +335,25 @@ void read_tool_types(void)
 
 		if ((disk_obj = GetDiskObject((STRPTR)filename)))
 		{
-			if (FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_SCREENSHOT))
+			const char *screenshot_size = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_SCREENSHOT);
+			if (screenshot_size && screenshot_size[0] != '\0')
 			{
-				char** tool_types = (char **)disk_obj->do_ToolTypes;
-				char* tool_type = *tool_types;
-
-				char** temp_tbl = my_split((char *)tool_type, "=");
-				if (temp_tbl == NULL
-					|| temp_tbl[0] == NULL
-					|| !strcmp(temp_tbl[0], " ")
-					|| !strcmp(temp_tbl[0], ""))
+				// SCREENSHOT=<width>x<height>
+				tokenizer tok;
+				const char *size;
+				size_t size_length;
+
+				tokenizer_init(&tok, screenshot_size, "x");
+				tokenizer_next(&tok, &size, &size_length);
+				if (size_length == 0 || size[0] == ' ')
 				{
 					msg_box((const char*)GetMBString(MSG_BadTooltype));
 					exit(0);
 				}
+				current_settings->screenshot_width = atoi(size);
 
-				if (temp_tbl[1] != NULL)
-				{
-					char** temp_tbl2 = my_split((char *)temp_tbl[1], "x");
-					if (temp_tbl2[0]) current_settings->screenshot_width = atoi((char *)temp_tbl2[0]);
-					if (temp_tbl2[1]) current_settings->screenshot_height = atoi((char *)temp_tbl2[1]);
-
-					free(temp_tbl2[0]);
-					free(temp_tbl2[1]);
-					free(temp_tbl2);
-					free(temp_tbl[0]);
-					free(temp_tbl[1]);
-					free(temp_tbl);
-				}
+				if (tokenizer_next(&tok, &size, &size_length) && size_length)
+					current_settings->screenshot_height = atoi(size);
 			}
 
 			if (FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_NOGUIGFX))
@@ -357,6 +376,46 @@ void read_tool_types(void)
 
 			if (FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_NOSIDEPANEL))
 				current_settings->hide_side_panel = 1;
+
+			if (FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_NOGAMESUBFOLDERS))
+				current_settings->scan_game_subfolders = 0;
+
+			const char *scan_max_depth = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_SCANMAXDEPTH);
+			if (scan_max_depth)
+				current_settings->scan_max_depth = atoi(scan_max_depth);
+
+			const char *scan_memory_limit = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_SCANMEMORYLIMIT);
+			if (scan_memory_limit)
+				current_settings->scan_memory_limit = atoi(scan_memory_limit);
+
+			if (FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_HIDEDUPLICATES))
+				current_settings->hide_duplicates = 1;
+
+			const char *prefetch_budget = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_PREFETCHBUDGET);
+			if (prefetch_budget)
+				current_settings->prefetch_budget = atoi(prefetch_budget);
+
+			if (FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_FREEMEMORYONLAUNCH))
+				current_settings->free_memory_on_launch = 1;
+
+			if (FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_ICONIFYONLAUNCH))
+				current_settings->iconify_on_launch = 1;
+
+			const char *stage_dir = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_STAGEDIR);
+			if (stage_dir)
+				strncpy(current_settings->stage_dir, stage_dir, sizeof(current_settings->stage_dir) - 1);
+
+			const char *stage_budget = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_STAGEBUDGET);
+			if (stage_budget)
+				current_settings->stage_budget = atoi(stage_budget);
+
+			const char *screenshot_cache = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_SCREENSHOTCACHE);
+			if (screenshot_cache)
+				current_settings->screenshot_cache = atoi(screenshot_cache);
+
+			const char *screenshot_prefetch = (const char *)FindToolType(disk_obj->do_ToolTypes, (STRPTR)TOOLTYPE_SCREENSHOTPREFETCH);
+			if (screenshot_prefetch)
+				current_settings->screenshot_prefetch = atoi(screenshot_prefetch);
 		}
 	}
 
@@ -392,76 +451,6 @@ void read_tool_types(void)
 	}
 }
 
-/*
-* Gets title from a slave file
-* returns 0 on success, 1 on fail
-*/
-int get_title_from_slave(char* slave, char* title)
-{
-	char slave_title[100];
-
-	struct slave_info
-	{
-		unsigned long security;
-		char id[8];
-		unsigned short version;
-		unsigned short flags;
-		unsigned long base_mem_size;
-		unsigned long exec_install;
-		unsigned short game_loader;
-		unsigned short current_dir;
-		unsigned short dont_cache;
-		char keydebug;
-		char keyexit;
-		unsigned long exp_mem;
-		unsigned short name;
-		unsigned short copy;
-		unsigned short info;
-	};
-
-	struct slave_info sl;
-
-	FILE* fp = fopen(slave, "rbe");
-	if (fp == NULL)
-	{
-		return 1;
-	}
-
-	//seek to +0x20
-	fseek(fp, 32, SEEK_SET);
-	fread(&sl, 1, sizeof sl, fp);
-
-	//sl.Version = (sl.Version>>8) | (sl.Version<<8);
-	//sl.name = (sl.name>>8) | (sl.name<<8);
-
-	//printf ("[%s] [%d]\n", sl.ID, sl.Version);
-
-	//sl.name holds the offset for the slave name
-	fseek(fp, sl.name + 32, SEEK_SET);
-	//title = calloc (1, 100);
-	//fread (title, 1, 100, fp);
-
-	if (sl.version < 10)
-	{
-		return 1;
-	}
-
-	for (int i = 0; i <= 99; i++)
-	{
-		slave_title[i] = fgetc(fp);
-		if (slave_title[i] == '\n')
-		{
-			slave_title[i] = '\0';
-			break;
-		}
-	}
-
-	strcpy(title, slave_title);
-	fclose(fp);
-
-	return 0;
-}
-
 // TODO: This seems OBSOLETE and can be replaced by getParentPath(). Needs investigation
 // Get the Directory part from a full path containing a file
 const char* get_directory_name(const char* str)
@@ -42,6 +42,8 @@
 #include <clib/icon_protos.h>
 #include <clib/muimaster_protos.h>
 #include <clib/graphics_protos.h>
+#include <proto/guigfx.h>
+#include <guigfx/guigfx.h>
 #endif
 
 /* System */
@@ -62,8 +64,21 @@
 #include "iGameGUI.h"
 #include "iGameExtern.h"
 #include "strfuncs.h"
+#include "tokenizer.h"
 #include "fsfuncs.h"
 #include "funcs.h"
+#include "osfuncs.h"
+#include "iconfile.h"
+#include "manifest.h"
+#include "scanner.h"
+#include "scantask.h"
+#include "launchtask.h"
+#include "stagecache.h"
+#include "stagetask.h"
+#include "screenshot.h"
+#include "thumbpack.h"
+#include "screenshottask.h"
+#include "prefetchtask.h"
 
 extern struct ObjApp* app;
 extern struct Library *GfxBase;
@@ -84,12 +99,20 @@ const int MAX_PATH_SIZE = 255;
 
 /* function definitions */
 // int get_genre(char* title, char* genre);
-static void follow_thread(BPTR lock, int tab_level);
+static games_list *add_scanned_slave(const char *, const char *);
 static void refresh_list(int check_exists);
-static int hex2dec(char* hexin);
 static int check_dup_title(char* title);
 static void check_for_wbrun();
 static void list_show_favorites(char* str);
+static void prefetch_startup_games(void);
+static void release_memory(void);
+static void restore_memory(void);
+static int stage_open(void);
+static void stage_start(void);
+static int screenshot_prefetch_pending(void);
+static int screenshot_prefetch_step(void);
+static void screenshot_stop(void);
+static void prefetch_stop(void);
 
 /* structures */
 struct EasyStruct msgbox;
@@ -99,11 +122,66 @@ repos_list *item_repos = NULL, *repos = NULL;
 genres_list *item_genres = NULL, *genres = NULL;
 igame_settings *current_settings = NULL;
 
+/* the scan running in the background */
+static scan_task background_scan;
+static const char **scan_repo_paths, **scan_repo_excludes;
+static char *scan_repo_buffer;
+static char **scan_known_paths, **scan_new_paths;  /* sorted when the scan ends, the list may change meanwhile */
+static char *scan_known_buffer;
+static int scan_known_count, scan_new_count, scan_new_size, scan_new_unshown;
+static unsigned long scan_start_time;
+static int scan_dirs_count, scan_found_count;
+static char scan_statistics[256];  /* the help of the status line, which keeps the pointer */
+
+/* the game running in the background */
+static launch_task background_launch;
+static int launch_timed, memory_released;
+
+/* the copies of the game folders on a fast drive, made in the background */
+static stage_cache game_stage;
+static stage_task background_stage;
+static char stage_source[STAGE_PATH_SIZE];  /* the folder of the game running from its copy */
+
+/* the games whose folder and icon are read ahead, the first one next */
+#define PREFETCH_QUEUE_SIZE 8
+#define PREFETCH_SETTLE_TIME 300
+#define PREFETCH_STARTUP_GAMES 5
+static char prefetch_queue[PREFETCH_QUEUE_SIZE][MANIFEST_PATH_SIZE];
+static int prefetch_count;
+static unsigned long prefetch_after;
+static prefetch_task background_prefetch;
+
+/* the screenshots shown last, scaled for the side panel */
+static screenshot_cache screenshots;
+static APTR shown_picture, next_picture;   /* the guigfx pictures on the side panel and of the one replacing it */
+static thumb_pack thumbnails;              /* of the screenshots scaled before, on disk */
+
+/* with less memory free, the screenshot cache is emptied before reading another screenshot */
+#define SCREENSHOT_LOW_MEMORY (512 * 1024)
+
+/* the row of the game shown, the screenshots of the rows around it are read ahead at idle */
+static int screenshot_prefetch_row = -1;
+static int screenshot_prefetch_tried, screenshot_prefetch_read;
+
+/* with less fast memory free, no screenshots are read ahead */
+#define SCREENSHOT_PREFETCH_LOW_MEMORY (1024 * 1024)
+
 void status_show_total(void)
 {
 	char helper[200];
 	set(app->LV_GamesList, MUIA_List_Quiet, FALSE);
 	sprintf(helper, (const char*)GetMBString(MSG_TotalNumberOfGames), total_games);
+
+	// How well the screenshot cache does, once it was used
+	const unsigned long lookups = screenshots.hits + screenshots.misses;
+	if (lookups)
+	{
+		char total[100];
+		snprintf(total, sizeof(total), "%s", helper);
+		snprintf(helper, sizeof(helper), (const char*)GetMBString(MSG_ScreenshotCacheStats), total,
+			screenshots.hits * 100 / lookups, screenshots.used_size / 1024);
+	}
+
 	set(app->TX_Status, MUIA_Text_Contents, helper);
 }
 
@@ -166,6 +244,17 @@ static void apply_settings()
 	set(app->CH_FilterUseEnter, MUIA_Selected, current_settings->filter_use_enter);
 	set(app->CH_HideSidepanel, MUIA_Selected, current_settings->hide_side_panel);
 	set(app->CH_StartWithFavorites, MUIA_Selected, current_settings->start_with_favorites);
+	set(app->CH_ScanGameSubfolders, MUIA_Selected, current_settings->scan_game_subfolders);
+	set(app->STR_ScanMaxDepth, MUIA_String_Integer, current_settings->scan_max_depth);
+	set(app->STR_ScanMemoryLimit, MUIA_String_Integer, current_settings->scan_memory_limit);
+	set(app->CH_HideDuplicates, MUIA_Selected, current_settings->hide_duplicates);
+	set(app->STR_PrefetchBudget, MUIA_String_Integer, current_settings->prefetch_budget);
+	set(app->CH_FreeMemoryOnLaunch, MUIA_Selected, current_settings->free_memory_on_launch);
+	set(app->CH_IconifyOnLaunch, MUIA_Selected, current_settings->iconify_on_launch);
+	set(app->STR_StageDir, MUIA_String_Contents, current_settings->stage_dir);
+	set(app->STR_StageBudget, MUIA_String_Integer, current_settings->stage_budget);
+	set(app->STR_ScreenshotCache, MUIA_String_Integer, current_settings->screenshot_cache);
+	set(app->STR_ScreenshotPrefetch, MUIA_String_Integer, current_settings->screenshot_prefetch);
 }
 
 igame_settings *load_settings(const char* filename)
@@ -184,6 +273,11 @@ igame_settings *load_settings(const char* filename)
 		current_settings = NULL;
 	}
 	current_settings = (igame_settings *)calloc(1, sizeof(igame_settings));
+	current_settings->scan_game_subfolders = DEFAULT_SCAN_GAME_SUBFOLDERS;
+	current_settings->prefetch_budget = DEFAULT_PREFETCH_BUDGET;
+	strcpy(current_settings->stage_dir, DEFAULT_STAGE_DIR);
+	current_settings->screenshot_cache = DEFAULT_SCREENSHOT_CACHE;
+	current_settings->screenshot_prefetch = DEFAULT_SCREENSHOT_PREFETCH;
 
 	// TODO: Maybe it would be a good idea to lock the file before open it
 	const BPTR fpsettings = Open((CONST_STRPTR)filename, MODE_OLDFILE);
@@ -218,6 +312,28 @@ igame_settings *load_settings(const char* filename)
 				current_settings->screenshot_height = atoi((const char*)file_line + 18);
 			if (!strncmp(file_line, "start_with_favorites=", 21))
 				current_settings->start_with_favorites = atoi((const char*)file_line + 21);
+			if (!strncmp(file_line, "scan_game_subfolders=", 21))
+				current_settings->scan_game_subfolders = atoi((const char*)file_line + 21);
+			if (!strncmp(file_line, "scan_max_depth=", 15))
+				current_settings->scan_max_depth = atoi((const char*)file_line + 15);
+			if (!strncmp(file_line, "scan_memory_limit=", 18))
+				current_settings->scan_memory_limit = atoi((const char*)file_line + 18);
+			if (!strncmp(file_line, "hide_duplicates=", 16))
+				current_settings->hide_duplicates = atoi((const char*)file_line + 16);
+			if (!strncmp(file_line, "prefetch_budget=", 16))
+				current_settings->prefetch_budget = atoi((const char*)file_line + 16);
+			if (!strncmp(file_line, "free_memory_on_launch=", 22))
+				current_settings->free_memory_on_launch = atoi((const char*)file_line + 22);
+			if (!strncmp(file_line, "iconify_on_launch=", 18))
+				current_settings->iconify_on_launch = atoi((const char*)file_line + 18);
+			if (!strncmp(file_line, "stage_dir=", 10))
+				strncpy(current_settings->stage_dir, (const char*)file_line + 10, sizeof(current_settings->stage_dir) - 1);
+			if (!strncmp(file_line, "stage_budget=", 13))
+				current_settings->stage_budget = atoi((const char*)file_line + 13);
+			if (!strncmp(file_line, "screenshot_cache=", 17))
+				current_settings->screenshot_cache = atoi((const char*)file_line + 17);
+			if (!strncmp(file_line, "screenshot_prefetch=", 20))
+				current_settings->screenshot_prefetch = atoi((const char*)file_line + 20);
 		}
 		while (1);
 
@@ -322,6 +438,34 @@ static void load_games_list(const char* filename)
 		free(file_line);
 }
 
+/*
+ * Adds a repository to the list and to the repositories window, where
+ * it is shown with the patterns of the folders it skips, if any
+ */
+static repos_list *add_repo(const char *path, const char *excludes)
+{
+	item_repos = (repos_list *)calloc(1, sizeof(repos_list));
+	if (item_repos == NULL)
+	{
+		msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
+		return NULL;
+	}
+
+	snprintf(item_repos->repo, sizeof(item_repos->repo), "%s", path);
+	snprintf(item_repos->excludes, sizeof(item_repos->excludes), "%s", excludes);
+	if (item_repos->excludes[0])
+		snprintf(item_repos->label, sizeof(item_repos->label), (const char*)GetMBString(MSG_RepoSkipping),
+			item_repos->repo, item_repos->excludes);
+	else
+		strcpy(item_repos->label, item_repos->repo);
+
+	item_repos->next = repos;
+	repos = item_repos;
+
+	DoMethod(app->LV_GameRepositories, MUIM_List_InsertSingle, item_repos->label, 1, MUIV_List_Insert_Bottom);
+	return item_repos;
+}
+
 static void load_repos(const char* filename)
 {
 	const int buffer_size = 512;
@@ -338,25 +482,18 @@ static void load_repos(const char* filename)
 	{
 		while (FGets(fprepos, file_line, buffer_size))
 		{
+			char *excludes;
+
 			if (file_line[strlen(file_line) - 1] == '\n') file_line[strlen(file_line) - 1] = '\0';
 			if (strlen(file_line) == 0)
 				break;
 
-			item_repos = (repos_list *)calloc(1, sizeof(repos_list));
-			item_repos->next = NULL;
-			strcpy(item_repos->repo, file_line);
-
-			if (repos == NULL)
-			{
-				repos = item_repos;
-			}
-			else
-			{
-				item_repos->next = repos;
-				repos = item_repos;
-			}
+			// The patterns of the folders to skip follow the path after a tab
+			if ((excludes = strchr(file_line, '\t')))
+				*excludes++ = '\0';
 
-			DoMethod(app->LV_GameRepositories, MUIM_List_InsertSingle, item_repos->repo, 1, MUIV_List_Insert_Bottom);
+			if (!add_repo(file_line, excludes ? excludes : ""))
+				break;
 		}
 
 		Close(fprepos);
@@ -700,11 +837,15 @@ void app_start(void)
 	}
 	UnLock(gamesListLock);
 
+	manifest_load(DEFAULT_MANIFEST_FILE);
 	load_repos(DEFAULT_REPOS_FILE);
 	add_default_filters();
 	load_genres(DEFAULT_GENRES_FILE);
 	apply_settings();
+	screenshot_cache_init(&screenshots, (unsigned long)current_settings->screenshot_cache * 1024);
 	check_for_wbrun();
+	prefetch_startup_games();
+	stage_start();
 
 	IntroPic = 1;
 
@@ -774,20 +915,349 @@ static void check_for_wbrun(void)
 	CurrentDir(oldlock);
 }
 
+/*
+ * Returns the icon of a WHDLoad game, the one with the slave in its
+ * SLAVE tooltype, and its path without ".info". The folder is only
+ * searched again if the icon the manifest knows no longer matches.
+ */
+static struct DiskObject *get_game_icon(const char *path, const char *slave, char *icon_path)
+{
+	int reread;
+
+	if (!IconBase)
+		return NULL;
+
+	for (reread = 0; reread < 2; reread++)
+	{
+		const game_manifest *manifest = manifest_get(path, reread);
+		struct DiskObject *disk_obj;
+
+		if (manifest == NULL || manifest->icon[0] == '\0')
+			return NULL;
+
+		if ((disk_obj = GetDiskObject((STRPTR)manifest->icon)))
+		{
+			if (MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (STRPTR)"SLAVE"), (STRPTR)slave)
+				|| MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (STRPTR)"slave"), (STRPTR)slave))
+			{
+				strcpy(icon_path, manifest->icon);
+				return disk_obj;
+			}
+			FreeDiskObject(disk_obj);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Writes the tooltypes straight into the icon file of a game, leaving
+ * the images and everything else in it as they were. Returns 1 if it
+ * was saved, 0 if the icon is not a classic one, for icon.library to
+ * save it, and -1 if it could not be written.
+ */
+static int save_game_tool_types(const char *path, const char *slave, const char *const *tool_types, const int count)
+{
+	const game_manifest *manifest = manifest_get(path, 0);
+	char info_path[MANIFEST_PATH_SIZE + 5];
+	unsigned char *data, *icon;
+	unsigned long size;
+	os_date date;
+	icon_header header;
+	const char *value;
+	size_t value_length;
+	long length;
+	int result = 0;
+
+	if (manifest == NULL || manifest->icon[0] == '\0')
+		return 0;
+
+	snprintf(info_path, sizeof(info_path), "%s.info", manifest->icon);
+	if (!os_file_info(info_path, &size, &date) || (data = malloc(size + 1)) == NULL)
+		return 0;
+
+	if ((length = os_read_file(info_path, 0, data, size)) == (long)size
+		&& icon_parse(data, length, &header) == ICON_OK
+		&& icon_find_tool_type(data, &header, "SLAVE", &value, &value_length)
+		&& icon_match_value(value, value_length, slave))
+	{
+		const long old_size = header.tool_types ? header.tool_types_end - header.tool_types : 0;
+
+		if ((icon = malloc(length - old_size + icon_tool_types_size(tool_types, count))))
+		{
+			length = icon_set_tool_types(data, length, &header, tool_types, count, icon);
+			result = os_replace_file(info_path, icon, length) ? 1 : -1;
+			free(icon);
+		}
+	}
+
+	free(data);
+	return result;
+}
+
+/*
+ * Compiles the tooltypes of the game icon to WHDLoad arguments. A game
+ * without an icon has no arguments. Returns 0 if the arguments are too
+ * long.
+ */
+static int compile_launch_arguments(const char *path, const char *slave, char *arguments, os_date *icon_date)
+{
+	struct DiskObject* disk_obj;
+	char icon_path[MANIFEST_PATH_SIZE + 5];
+	unsigned long icon_size;
+	int result;
+
+	arguments[0] = '\0';
+	icon_date->seconds = 0;
+	icon_date->fraction = 0;
+
+	if ((disk_obj = get_game_icon(path, slave, icon_path)) == NULL)
+		return 1;
+
+	result = manifest_compile_arguments((char **)disk_obj->do_ToolTypes, arguments);
+	FreeDiskObject(disk_obj);
+
+	strcat(icon_path, ".info");
+	os_file_info(icon_path, &icon_size, icon_date);
+
+	return result;
+}
+
+/*
+ * Returns the WHDLoad arguments of a game. They are compiled once and
+ * kept in its manifest, so starting the game again only checks the
+ * dates of its folder and its icon.
+ */
+static int get_launch_arguments(const char *path, const char *slave, char *arguments)
+{
+	const game_manifest *manifest = manifest_get(path, 0);
+	char info_path[MANIFEST_PATH_SIZE + 5];
+	unsigned long icon_size;
+	os_date icon_date;
+
+	if (manifest != NULL && (manifest->flags & MANIFEST_ARGUMENTS))
+	{
+		// No icon means no arguments, until the folder changes
+		if (manifest->icon[0] == '\0')
+		{
+			strcpy(arguments, manifest->arguments);
+			return 1;
+		}
+
+		snprintf(info_path, sizeof(info_path), "%s.info", manifest->icon);
+		if (os_file_info(info_path, &icon_size, &icon_date)
+			&& icon_date.seconds == manifest->icon_date.seconds
+			&& icon_date.fraction == manifest->icon_date.fraction)
+		{
+			strcpy(arguments, manifest->arguments);
+			return 1;
+		}
+	}
+
+	if (!compile_launch_arguments(path, slave, arguments, &icon_date))
+		return 0;
+
+	manifest_set_arguments(path, &icon_date, arguments);
+	return 1;
+}
+
+/*
+ * Queues a game for prefetching. The selected game goes first, after
+ * the selection settles, the rest after the ones already queued.
+ */
+static void prefetch_add(const char *path, const int first)
+{
+	int i;
+
+	if (current_settings->prefetch_budget == 0 || strlen(path) >= MANIFEST_PATH_SIZE)
+		return;
+
+	for (i = 0; i < prefetch_count; i++)
+	{
+		if (!strcmp(prefetch_queue[i], path))
+			break;
+	}
+
+	if (i < prefetch_count)
+	{
+		if (!first)
+			return;
+		memmove(prefetch_queue + 1, prefetch_queue, sizeof(prefetch_queue[0]) * i);
+	}
+	else if (first)
+	{
+		if (prefetch_count == PREFETCH_QUEUE_SIZE)
+			prefetch_count--;
+		memmove(prefetch_queue + 1, prefetch_queue, sizeof(prefetch_queue[0]) * prefetch_count);
+		prefetch_count++;
+	}
+	else if (prefetch_count < PREFETCH_QUEUE_SIZE)
+	{
+		strcpy(prefetch_queue[prefetch_count++], path);
+		return;
+	}
+	else
+		return;
+
+	strcpy(prefetch_queue[0], path);
+	prefetch_after = os_milliseconds() + PREFETCH_SETTLE_TIME;
+
+	// The games handed to the task wait for the selected one
+	if (prefetch_signal())
+		background_prefetch.stop = 1;
+}
+
+/*
+ * Finds the games played the most, most played first. Returns how
+ * many were found, up to size.
+ */
+static int most_played_games(games_list **most_played, const int size)
+{
+	int count = 0, i;
+
+	for (item_games = games; item_games != NULL; item_games = item_games->next)
+	{
+		if (item_games->deleted || item_games->hidden || item_games->times_played == 0)
+			continue;
+
+		// Keep the most played ones sorted, most played first
+		for (i = count; i > 0 && most_played[i - 1]->times_played < item_games->times_played; i--)
+		{
+			if (i < size)
+				most_played[i] = most_played[i - 1];
+		}
+		if (i < size)
+		{
+			most_played[i] = item_games;
+			if (count < size)
+				count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * The last played game and the most played ones are likely to be
+ * started next, so they are queued when iGame starts
+ */
+static void prefetch_startup_games(void)
+{
+	games_list *most_played[PREFETCH_STARTUP_GAMES];
+	int count, i;
+
+	for (item_games = games; item_games != NULL; item_games = item_games->next)
+	{
+		if (!item_games->deleted && !item_games->hidden && item_games->last_played)
+			prefetch_add(item_games->path, 0);
+	}
+
+	count = most_played_games(most_played, PREFETCH_STARTUP_GAMES);
+	for (i = 0; i < count; i++)
+		prefetch_add(most_played[i]->path, 0);
+}
+
+int prefetch_pending(void)
+{
+	// The screenshots wait for the folders being read
+	return !prefetch_signal() && (prefetch_count > 0 || screenshot_prefetch_pending());
+}
+
+/*
+ * Hands the queued games to a task that reads them ahead below the
+ * priority of the GUI, once the selection settled, for up to the
+ * budget of the settings but at least one. Else it reads ahead the
+ * screenshots. Called when iGame has nothing else to do.
+ */
+void prefetch_step(void)
+{
+	const unsigned long now = os_milliseconds();
+	int i;
+
+	// The folders of the games first, one of them may be started next
+	if (prefetch_count == 0)
+	{
+		screenshot_prefetch_step();
+		return;
+	}
+
+	for (i = 0; i < prefetch_count && i < PREFETCH_TASK_GAMES; i++)
+		strcpy(background_prefetch.games[i].path, prefetch_queue[i]);
+	background_prefetch.count = i;
+	background_prefetch.delay = (long)(prefetch_after - now) > 0 ? prefetch_after - now : 0;
+	background_prefetch.budget = current_settings->prefetch_budget;
+
+	prefetch_count -= i;
+	memmove(prefetch_queue, prefetch_queue + i, sizeof(prefetch_queue[0]) * prefetch_count);
+
+	// Without a task of its own, nothing is read ahead
+	if (!prefetch_task_start(&background_prefetch))
+		prefetch_count = 0;
+}
+
+/*
+ * Called when the signal of prefetch_signal() arrives. The manifests
+ * read are kept, the games not read yet go back in the queue.
+ */
+void prefetch_poll(void)
+{
+	int i;
+
+	if (!prefetch_task_ended(&background_prefetch))
+		return;
+
+	for (i = 0; i < background_prefetch.done; i++)
+	{
+		if (background_prefetch.games[i].read)
+			manifest_put(&background_prefetch.games[i].manifest);
+	}
+
+	for (i = background_prefetch.done; i < background_prefetch.count; i++)
+		prefetch_add(background_prefetch.games[i].path, 0);
+}
+
+/*
+ * The signal the prefetching task ends with, or 0 if none runs
+ */
+ULONG prefetch_signal(void)
+{
+	return prefetch_task_signal(&background_prefetch);
+}
+
+/*
+ * Stops reading ahead, dropping what was queued and read
+ */
+static void prefetch_stop(void)
+{
+	prefetch_task_end(&background_prefetch);
+	prefetch_count = 0;
+}
+
 /*
 *   Executes whdload with the slave
 */
 void launch_game(void)
 {
 	struct Library* icon_base;
-	struct DiskObject* disk_obj;
-	char *game_title = NULL, exec[256], *tool_type;
-	int success, i, whdload = 0;
-	char str2[512], fullpath[800], helperstr[250], to_check[256];
+	char *game_title = NULL, exec[LAUNCH_COMMAND_SIZE];
+	int whdload = 0;
+	char helperstr[250], arguments[MANIFEST_ARGUMENTS_SIZE], stage_copy[STAGE_PATH_SIZE], stage_slave[STAGE_PATH_SIZE];
+
+	// One game at a time, WHDLoad takes over the machine anyway
+	if (launch_signal())
+	{
+		msg_box((const char*)GetMBString(MSG_GameStillRunning));
+		return;
+	}
 
-	// clear vars:
-	str2[0] = '\0';
-	fullpath[0] = '\0';
+	// The game gets the drives, and the staging cache, to itself
+	if (stage_signal())
+		stage_task_end(&background_stage);
+
+	// Nothing is read ahead while it runs, whether the memory is freed or not
+	screenshot_stop();
+	prefetch_stop();
+	screenshot_prefetch_row = -1;
 
 	DoMethod(app->LV_GamesList, MUIM_List_GetEntry, MUIV_List_GetEntry_Active, &game_title);
 	if (game_title == NULL || strlen(game_title) == 0)
@@ -833,10 +1303,9 @@ void launch_game(void)
 	if (strstr(slave, ".slave"))
 		whdload = 1;
 
-	const BPTR oldlock = Lock((CONST_STRPTR)PROGDIR, ACCESS_READ);
 	const BPTR lock = Lock(naked_path, ACCESS_READ);
 	if (lock)
-		CurrentDir(lock);
+		UnLock(lock);
 	else
 	{
 		msg_box((const char*)GetMBString(MSG_DirectoryNotFound));
@@ -844,114 +1313,51 @@ void launch_game(void)
 	}
 
 	if (whdload == 1)
-		sprintf(exec, "whdload ");
-	else
 	{
-		if (wbrun)
-			sprintf(exec, "C:WBRun \"%s\"", path);
-		else
-			sprintf(exec, "\"%s\"", path);
-	}
+		//tooltypes only for whdload games
+		const unsigned long start_time = os_milliseconds();
 
-	//tooltypes only for whdload games
-	if (whdload == 1)
-	{
-		if (IconBase)
+		if (!get_launch_arguments(path, slave, arguments))
 		{
-			//scan the .info files in the current dir.
-			//one of them should be the game's project icon.
-
-			/*  allocate space for a FileInfoBlock */
-#if defined(__amigaos4__)
-			struct FileInfoBlock* m = (struct FileInfoBlock *)AllocVecTags(sizeof(struct FileInfoBlock), AVT_ClearWithValue,0, TAG_DONE);
-#else
-			struct FileInfoBlock* m = (struct FileInfoBlock *)AllocMem(sizeof(struct FileInfoBlock), MEMF_CLEAR);
-#endif
-
-			Examine(lock, m);
-			if (m->fib_DirEntryType <= 0)
-			{
-				/*  We don't allow "opta file", only "opta dir" */
-				return;
-			}
-
-			while ((success = ExNext(lock, m)))
-			{
-				if (strcasestr(m->fib_FileName, ".info"))
-				{
-					NameFromLock(lock, (unsigned char*)str2, 512);
-					sprintf(fullpath, "%s/%s", str2, m->fib_FileName);
-
-					//lose the .info
-					for (i = strlen(fullpath) - 1; i >= 0; i--)
-					{
-						if (fullpath[i] == '.')
-							break;
-					}
-					fullpath[i] = '\0';
-
-					if ((disk_obj = GetDiskObject((STRPTR)fullpath)))
-					{
-						if (MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (unsigned char*)"SLAVE"), (STRPTR)slave)
-							|| MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (unsigned char*)"slave"), (STRPTR)slave))
-						{
-							for (char** tool_types = (char **)disk_obj->do_ToolTypes; (tool_type = *tool_types); ++
-							     tool_types)
-							{
-								if (!strncmp(tool_type, "IM", 2)) continue;
-								if (tool_type[0] == ' ') continue;
-								if (tool_type[0] == '(') continue;
-								if (tool_type[0] == '*') continue;
-								if (tool_type[0] == ';') continue;
-								if (tool_type[0] == '\0') continue;
-								if (tool_type[0] == -69) continue; // »
-								if (tool_type[0] == -85) continue; // «
-								if (tool_type[0] == '.') continue;
-								if (tool_type[0] == '=') continue;
-								if (tool_type[0] == '#') continue;
-								if (tool_type[0] == '!') continue;
-
-								/* Must check here for numerical values */
-								/* Those (starting with $ should be transformed to dec from hex) */
-								char** temp_tbl = my_split((char *)tool_type, "=");
-								if (temp_tbl == NULL
-									|| temp_tbl[0] == NULL
-									|| !strcmp((char *)temp_tbl[0], " ")
-									|| !strcmp((char *)temp_tbl[0], ""))
-									continue;
-
-								if (temp_tbl[1] != NULL)
-								{
-									sprintf(to_check, "%s", temp_tbl[1]);
-									if (to_check[0] == '$')
-									{
-										const int dec_rep = hex2dec(to_check);
-										sprintf(tool_type, "%s=%d", temp_tbl[0], dec_rep);
-									}
-								}
-								if (temp_tbl)
-									free(temp_tbl);
-								//req: more free's
-
-								sprintf(exec, "%s %s", exec, tool_type);
-							}
-
-							FreeDiskObject(disk_obj);
-							break;
-						}
-						FreeDiskObject(disk_obj);
-					}
-				}
-			}
+			msg_box((const char*)GetMBString(MSG_BadTooltype));
+			free(slave);
+			free(path);
+			free(naked_path);
+			return;
 		}
 
-		//if we're still here, and exec contains just whdload, add the slave and execute
-		if (!strcmp(exec, "whdload "))
+		// A copy of the game folder in the staging cache runs instead of it
+		stage_source[0] = '\0';
+		if (stage_open() && stage_cache_find(&game_stage, naked_path, stage_copy, sizeof(stage_copy))
+			&& snprintf(stage_slave, sizeof(stage_slave), "%s/%s", stage_copy, slave) < (int)sizeof(stage_slave))
 		{
-			sprintf(exec, "%s %s", exec, path);
+			stage_cache_save(&game_stage);
+			snprintf(stage_source, sizeof(stage_source), "%s", naked_path);
 		}
+
+		//without tooltypes whdload is given the slave
+		snprintf(exec, sizeof(exec), "whdload %s", arguments[0] ? arguments : stage_source[0] ? stage_slave : path);
+
+		snprintf(helperstr, sizeof(helperstr), (const char*)GetMBString(MSG_RunningGameTime), game_title,
+			os_milliseconds() - start_time);
+		set(app->TX_Status, MUIA_Text_Contents, helperstr);
+	}
+	else
+	{
+		if (wbrun)
+			snprintf(exec, sizeof(exec), "C:WBRun \"%s\"", path);
+		else
+			snprintf(exec, sizeof(exec), "\"%s\"", path);
 	}
 
+	// The game runs on a process of its own, which tells when it ends
+	snprintf(background_launch.command, sizeof(background_launch.command), "%s", exec);
+	snprintf(background_launch.dir, sizeof(background_launch.dir), "%s", stage_source[0] ? stage_copy : (char *)naked_path);
+	snprintf(background_launch.path, sizeof(background_launch.path), "%s", path);
+
+	// WBRun returns as soon as the game started, so its time is not known
+	launch_timed = whdload == 1 || !wbrun;
+
 	// Cleanup the memory allocations
 	if (slave)
 		free(slave);
@@ -978,59 +1384,649 @@ void launch_game(void)
 	if (!current_settings->save_stats_on_exit)
 		save_list(0);
 
-	success = Execute((unsigned char*)exec, 0, 0);
+	// WBRun returns at once, so the memory would be given back right away
+	if (current_settings->free_memory_on_launch && launch_timed)
+	{
+		const ULONG free_before = AvailMem(MEMF_ANY);
+		release_memory();
+		const ULONG free_after = AvailMem(MEMF_ANY);
 
-	if (success == 0)
-		msg_box((const char*)GetMBString(MSG_ErrorExecutingWhdload));
+		snprintf(helperstr, sizeof(helperstr), (const char*)GetMBString(MSG_RunningGameFreed), game_title,
+			free_after > free_before ? (free_after - free_before) / 1024 : 0, free_before / 1024, free_after / 1024);
+	}
+	set(app->TX_Status, MUIA_Text_Contents, helperstr);
 
-	CurrentDir(oldlock);
-	status_show_total();
+	if (!launch_task_start(&background_launch))
+	{
+		stage_source[0] = '\0';
+		restore_memory();
+		msg_box((const char*)GetMBString(MSG_ErrorExecutingWhdload));
+		status_show_total();
+	}
 }
 
 /*
-* Scans the repos for games
-*/
-void scan_repositories(void)
+ * Adds the time the game ran to its play time, and tells if its
+ * command failed
+ */
+static void launch_ended(void)
 {
-	char repotemp[256], helperstr[256];
+	char helperstr[256];
 
-	if (repos)
+	// What the game saved to its copy goes back to its folder
+	if (stage_source[0])
 	{
-		for (item_games = games; item_games != NULL; item_games = item_games->next)
-		{
-			//only apply the not exists hack to slaves that are in the current repos, that will be scanned later
-			//Binaries (that are added through add game) should be handled afterwards
-			if (strcasestr(item_games->path, ".slave") || strlen(item_games->path) == 0)
-				item_games->exists = 0;
-			else
-				item_games->exists = 1;
-		}
+		if (stage_cache_sync(&game_stage, stage_source) < 0)
+			msg_box((const char*)GetMBString(MSG_StageSyncFailed));
+		stage_source[0] = '\0';
+	}
 
-		const BPTR currentlock = Lock((CONST_STRPTR)PROGDIR, ACCESS_READ);
+	if (background_launch.result == LAUNCH_FAILED)
+	{
+		msg_box((const char*)GetMBString(MSG_ErrorExecutingWhdload));
+		status_show_total();
+		return;
+	}
 
-		for (item_repos = repos; item_repos != NULL; item_repos = item_repos->next)
-		{
-			sprintf(repotemp, "%s", item_repos->repo);
-			sprintf(helperstr, (const char*)GetMBString(MSG_ScanningPleaseWait), repotemp);
-			set(app->TX_Status, MUIA_Text_Contents, helperstr);
-			const BPTR oldlock = Lock((unsigned char*)repotemp, ACCESS_READ);
+	for (item_games = games; item_games != NULL; item_games = item_games->next)
+	{
+		if (!strcmp(item_games->path, background_launch.path) && !item_games->deleted)
+			break;
+	}
 
-			if (oldlock != 0)
-			{
-				CurrentDir(oldlock);
-				follow_thread(oldlock, 0);
-				CurrentDir(currentlock);
-			}
-			else
-			{
-				//could not lock
-			}
-		}
+	if (item_games == NULL || !launch_timed)
+		status_show_total();
+	else
+	{
+		const int minutes = (int)(background_launch.milliseconds / 60000);
+		item_games->play_time += (int)(background_launch.milliseconds / 1000);
+		save_session(DEFAULT_SESSIONS_FILE, background_launch.path, background_launch.started.seconds,
+			background_launch.milliseconds / 1000);
 
-		save_list(1);
-		refresh_list(1);
+		snprintf(helperstr, sizeof(helperstr), (const char*)GetMBString(MSG_PlayedGameTime), item_games->title,
+			minutes, item_games->play_time / 3600, item_games->play_time / 60 % 60);
+
+		// Saving the list shows the total on the status line
+		if (!current_settings->save_stats_on_exit)
+			save_list(0);
+
+		set(app->TX_Status, MUIA_Text_Contents, helperstr);
 	}
-}
+
+	// The command has no console, so what it printed is lost, but not that it failed
+	if (background_launch.result != 0)
+	{
+		snprintf(helperstr, sizeof(helperstr), (const char*)GetMBString(MSG_GameEndedWithError),
+			item_games ? item_games->title : (const char*)FilePart((CONST_STRPTR)background_launch.path), background_launch.result);
+		msg_box(helperstr);
+	}
+}
+
+/*
+ * Called when the signal of launch_signal() arrives
+ */
+void launch_poll(void)
+{
+	if (launch_task_ended(&background_launch))
+	{
+		restore_memory();
+		launch_ended();
+		stage_start();
+	}
+}
+
+ULONG launch_signal(void)
+{
+	return launch_task_signal(&background_launch);
+}
+
+/*
+ * Opens the staging cache with the settings, or again if they changed.
+ * Returns 0 if it is off or can't be used. Not while it is copying.
+ */
+static int stage_open(void)
+{
+	const unsigned long budget = (unsigned long)current_settings->stage_budget * 1024;
+
+	if (game_stage.dir[0] && (strcmp(game_stage.dir, current_settings->stage_dir) || game_stage.budget != budget))
+		stage_cache_close(&game_stage);
+
+	if (game_stage.dir[0] == '\0' && budget > 0)
+		stage_cache_open(&game_stage, current_settings->stage_dir, budget);
+
+	return game_stage.dir[0] != '\0';
+}
+
+/*
+ * Queues the folder of a WHDLoad game to be copied
+ */
+static void stage_add(const char *path)
+{
+	char folder[STAGE_PATH_SIZE];
+	int i;
+
+	if (background_stage.count == STAGE_TASK_GAMES || strlen(path) >= sizeof(folder) || !strcasestr(path, ".slave"))
+		return;
+
+	strip_path(path, folder);
+	for (i = 0; i < background_stage.count; i++)
+	{
+		if (!strcmp(background_stage.sources[i], folder))
+			return;
+	}
+
+	strcpy(background_stage.sources[background_stage.count++], folder);
+}
+
+/*
+ * Copies the last played game and the most played ones to the staging
+ * cache in the background, while no game runs
+ */
+static void stage_start(void)
+{
+	games_list *most_played[STAGE_TASK_GAMES];
+	int count, i;
+
+	if (stage_signal() || launch_signal() || !stage_open())
+		return;
+
+	background_stage.cache = &game_stage;
+	background_stage.count = 0;
+
+	for (item_games = games; item_games != NULL; item_games = item_games->next)
+	{
+		if (!item_games->deleted && !item_games->hidden && item_games->last_played)
+			stage_add(item_games->path);
+	}
+
+	count = most_played_games(most_played, STAGE_TASK_GAMES);
+	for (i = 0; i < count; i++)
+		stage_add(most_played[i]->path);
+
+	if (background_stage.count > 0)
+		stage_task_start(&background_stage);
+}
+
+/*
+ * Called when the signal of stage_signal() arrives
+ */
+void stage_poll(void)
+{
+	stage_task_ended(&background_stage);
+}
+
+ULONG stage_signal(void)
+{
+	return stage_task_signal(&background_stage);
+}
+
+/*
+* Scans the repos for games
+*/
+static void free_scan_state(void)
+{
+	free(scan_repo_paths);
+	free(scan_repo_excludes);
+	free(scan_repo_buffer);
+	free(scan_known_paths);
+	free(scan_known_buffer);
+	for (int i = 0; i < scan_new_count; i++)
+		free(scan_new_paths[i]);
+	free(scan_new_paths);
+	scan_repo_paths = NULL;
+	scan_repo_excludes = NULL;
+	scan_repo_buffer = NULL;
+	scan_known_paths = NULL;
+	scan_known_buffer = NULL;
+	scan_new_paths = NULL;
+	scan_known_count = 0;
+	scan_new_count = 0;
+	scan_new_size = 0;
+	scan_new_unshown = 0;
+}
+
+static int compare_game_paths(const void *a, const void *b)
+{
+	return strcmp((*(games_list * const *)a)->path, (*(games_list * const *)b)->path);
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int has_path(char **sorted, const int count, const char *path)
+{
+	return bsearch(&path, sorted, count, sizeof(char *), compare_paths) != NULL;
+}
+
+static games_list *find_game_by_path(games_list **sorted, const int count, const char *path)
+{
+	int low = 0, high = count - 1;
+
+	while (low <= high)
+	{
+		const int middle = (low + high) / 2;
+		const int result = strcmp(path, sorted[middle]->path);
+
+		if (result == 0)
+			return sorted[middle];
+		if (result < 0)
+			high = middle - 1;
+		else
+			low = middle + 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * Keeps the paths of the slaves that are in the list before a scan,
+ * sorted, so the scan results can be looked up and merged with them.
+ * Entries added with "Add Game" are not touched by a scan.
+ */
+static int collect_known_paths(void)
+{
+	size_t size = 0;
+	char *path;
+	int count = 0;
+
+	for (item_games = games; item_games != NULL; item_games = item_games->next)
+	{
+		if (strcasestr(item_games->path, ".slave"))
+		{
+			size += strlen(item_games->path) + 1;
+			count++;
+		}
+	}
+
+	scan_known_paths = malloc(sizeof(char *) * (count + 1));
+	scan_known_buffer = malloc(size + 1);
+	if (scan_known_paths == NULL || scan_known_buffer == NULL)
+		return 0;
+
+	path = scan_known_buffer;
+	for (item_games = games; item_games != NULL; item_games = item_games->next)
+	{
+		if (strcasestr(item_games->path, ".slave"))
+		{
+			strcpy(path, item_games->path);
+			scan_known_paths[scan_known_count++] = path;
+			path += strlen(path) + 1;
+		}
+	}
+	qsort(scan_known_paths, scan_known_count, sizeof(char *), compare_paths);
+
+	return 1;
+}
+
+/*
+ * Drops the entry the scan added for the path, looked up in the list
+ * sorted by path
+ */
+static void drop_new_game(games_list **sorted, const int count, const char *path)
+{
+	games_list *added;
+
+	if (!has_path(scan_new_paths, scan_new_count, path))
+		return;
+
+	if ((added = find_game_by_path(sorted, count, path)))
+	{
+		added->exists = 0;
+		added->deleted = 1;
+	}
+}
+
+/*
+ * Merges the sorted slaves of a finished scan with the known ones.
+ * A known slave that is gone is removed, unless it moved, in which
+ * case it takes the new path and keeps its title and statistics, and
+ * the entry added for the new path during the scan is dropped. The
+ * new copies of a slave that is already in the list are dropped too,
+ * if the duplicates are hidden. The games are looked up by path in the
+ * list as it is now, so it may change while the scan runs.
+ */
+static int reconcile_scan(const scan_job *job, scan_diff *diff)
+{
+	unsigned long *known_crcs = malloc(sizeof(unsigned long) * (scan_known_count + 1));
+	unsigned long *slave_crcs = malloc(sizeof(unsigned long) * (job->slaves_count + 1));
+	games_list **sorted = NULL, **known_games = NULL;
+	scan_diff_input input;
+	int i, count = 0, merged = 0;
+
+	if (known_crcs && slave_crcs)
+	{
+		// The checksums of slaves that are gone are still in the slave cache
+		for (i = 0; i < scan_known_count; i++)
+			known_crcs[i] = scan_task_slave_crc(&background_scan, scan_known_paths[i]);
+		for (i = 0; i < job->slaves_count; i++)
+			slave_crcs[i] = scan_task_slave_crc(&background_scan, job->slaves[i].path);
+
+		input.slaves = job->slaves;
+		input.slave_crcs = slave_crcs;
+		input.slaves_count = job->slaves_count;
+		input.known = (const char * const *)scan_known_paths;
+		input.known_crcs = known_crcs;
+		input.known_count = scan_known_count;
+		merged = scan_diff_run(diff, &input);
+	}
+
+	free(known_crcs);
+	free(slave_crcs);
+	if (!merged)
+		return 0;
+
+	for (item_games = games; item_games != NULL; item_games = item_games->next)
+		count++;
+
+	sorted = malloc(sizeof(games_list *) * (count + 1));
+	known_games = malloc(sizeof(games_list *) * (scan_known_count + 1));
+	if (sorted == NULL || known_games == NULL)
+	{
+		free(sorted);
+		free(known_games);
+		scan_diff_free(diff);
+		return 0;
+	}
+
+	for (item_games = games, i = 0; item_games != NULL; item_games = item_games->next)
+	{
+		item_games->exists = 1;
+		sorted[i++] = item_games;
+	}
+	qsort(sorted, count, sizeof(games_list *), compare_game_paths);
+	qsort(scan_new_paths, scan_new_count, sizeof(char *), compare_paths);
+
+	// A known game may have been deleted from the list meanwhile
+	for (i = 0; i < scan_known_count; i++)
+		known_games[i] = find_game_by_path(sorted, count, scan_known_paths[i]);
+
+	// The moved games take their new paths last, the sorted list is used until then
+	for (i = 0; i < scan_known_count; i++)
+	{
+		if (diff->known_states[i] == SCAN_REMOVED && known_games[i])
+		{
+			known_games[i]->exists = 0;
+			known_games[i]->deleted = 1;
+		}
+		else if (diff->known_states[i] == SCAN_MOVED)
+			drop_new_game(sorted, count, job->slaves[diff->known_slaves[i]].path);
+	}
+
+	if (current_settings->hide_duplicates)
+	{
+		for (i = 0; i < job->slaves_count; i++)
+		{
+			if (diff->slave_added[i] && diff->slave_copies[i] != -1)
+				drop_new_game(sorted, count, job->slaves[i].path);
+		}
+	}
+
+	for (i = 0; i < scan_known_count; i++)
+	{
+		if (diff->known_states[i] == SCAN_MOVED && known_games[i])
+			strcpy(known_games[i]->path, job->slaves[diff->known_slaves[i]].path);
+	}
+
+	free(sorted);
+	free(known_games);
+
+	return 1;
+}
+
+/*
+ * Starts a scan in the background. The games it finds arrive in
+ * batches, which are added to the list by scan_poll().
+ */
+void scan_repositories(const int full_rescan)
+{
+	char helperstr[256];
+	scan_job *job = &background_scan.job;
+	int i;
+
+	// Only one scan at a time
+	if (scan_task_signal(&background_scan))
+		return;
+
+	if (repos)
+	{
+		memset(job, 0, sizeof(scan_job));
+		for (item_repos = repos; item_repos != NULL; item_repos = item_repos->next)
+			job->repos_count++;
+
+		// The scan has its own copy of the repositories, which may change while it runs
+		scan_repo_paths = malloc(sizeof(char *) * job->repos_count);
+		scan_repo_excludes = malloc(sizeof(char *) * job->repos_count);
+		scan_repo_buffer = malloc((sizeof(item_repos->repo) + sizeof(item_repos->excludes)) * job->repos_count);
+		if (scan_repo_paths == NULL || scan_repo_excludes == NULL || scan_repo_buffer == NULL
+			|| !collect_known_paths())
+		{
+			free_scan_state();
+			msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
+			return;
+		}
+
+		// A repository may have patterns of paths to skip, e.g. "#?/data;#?/docs"
+		for (item_repos = repos, i = 0; item_repos != NULL; item_repos = item_repos->next, i++)
+		{
+			char *path = scan_repo_buffer + i * (sizeof(item_repos->repo) + sizeof(item_repos->excludes));
+			char *excludes = path + sizeof(item_repos->repo);
+
+			strcpy(path, item_repos->repo);
+			strcpy(excludes, item_repos->excludes);
+			scan_repo_paths[i] = path;
+			scan_repo_excludes[i] = excludes[0] ? excludes : NULL;
+		}
+		job->repos = scan_repo_paths;
+		job->excludes = scan_repo_excludes;
+		job->prune_game_dirs = !current_settings->scan_game_subfolders;
+		job->max_depth = current_settings->scan_max_depth;
+		job->memory_limit = (size_t)current_settings->scan_memory_limit * 1024;
+
+		background_scan.full_rescan = full_rescan;
+		background_scan.read_titles = !current_settings->titles_from_dirs;
+		background_scan.scan_cache_file = DEFAULT_SCANCACHE_FILE;
+		background_scan.slave_cache_file = DEFAULT_SLAVECACHE_FILE;
+
+		if (!scan_task_start(&background_scan))
+		{
+			free_scan_state();
+			msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
+			return;
+		}
+
+		scan_start_time = os_milliseconds();
+		scan_dirs_count = 0;
+		scan_found_count = 0;
+		set(app->BT_ScanStop, MUIA_Disabled, FALSE);
+
+		sprintf(helperstr, (const char*)GetMBString(MSG_ScanningRepositories), job->repos_count);
+		set(app->TX_Status, MUIA_Text_Contents, helperstr);
+	}
+}
+
+/*
+ * While the list shows all the games, the new ones are added to it as
+ * they are found. The other filters get them when the scan is done.
+ */
+static int shown_while_scanning(const char *title)
+{
+	char *str = NULL;
+	char *str_gen = NULL;
+
+	get(app->STR_Filter, MUIA_String_Contents, &str);
+	DoMethod(app->LV_GenresList, MUIM_List_GetEntry, MUIV_List_GetEntry_Active, &str_gen);
+
+	if (str_gen != NULL && strcmp(str_gen, GetMBString(MSG_FilterShowAll)))
+		return 0;
+
+	return str == NULL || strlen(str) == 0 || strcasestr(title, str) != NULL;
+}
+
+static void scan_finish(void)
+{
+	char helperstr[256];
+	scan_job *job = &background_scan.job;
+	scan_diff diff;
+
+	scan_task_end(&background_scan);
+	set(app->BT_ScanStop, MUIA_Disabled, TRUE);
+
+	if (!background_scan.scanned || background_scan.out_of_memory)
+	{
+		free_scan_state();
+		scan_task_free(&background_scan);
+		status_show_total();
+		msg_box((const char*)GetMBString(job->limit_reached ? MSG_ScanMemoryLimit : MSG_NotEnoughMemory));
+		return;
+	}
+
+	// A stopped scan did not see every repository, so nothing is removed
+	if (job->cancel)
+	{
+		save_list(0);
+		snprintf(helperstr, sizeof(helperstr), (const char*)GetMBString(MSG_ScanStopped), scan_dirs_count,
+			total_games);
+	}
+	else if (!reconcile_scan(job, &diff))
+	{
+		save_list(0);
+		status_show_total();
+		msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
+		helperstr[0] = '\0';
+	}
+	else
+	{
+		save_list(1);
+
+		// The new games are already in the list, unless a filter hid them
+		if (diff.removed_count > 0 || diff.moved_count > 0 || scan_new_unshown
+			|| (diff.copies_count > 0 && current_settings->hide_duplicates))
+			filter_change();
+
+		const unsigned long milliseconds = job->milliseconds ? job->milliseconds : 1;
+		snprintf(helperstr, sizeof(helperstr), (const char*)GetMBString(MSG_ScanFinished), total_games,
+			diff.added_count, diff.removed_count, diff.moved_count, diff.copies_count,
+			milliseconds / 1000, (milliseconds % 1000) / 10);
+
+		// Show how fast the filesystems were read, so different ones can be compared, in the help of the status line
+		snprintf(scan_statistics, sizeof(scan_statistics), (const char*)GetMBString(MSG_ScanStatistics),
+			job->entries_count, job->entries_count * 1000 / milliseconds,
+			job->dirs_reused, job->dirs_read + job->dirs_reused,
+			background_scan.slave_hits, background_scan.slave_hits + background_scan.slave_misses,
+			(unsigned long)((job->peak_memory + 1023) / 1024), job->max_depth_reached);
+		set(app->TX_Status, MUIA_ShortHelp, scan_statistics);
+		scan_diff_free(&diff);
+	}
+
+	free_scan_state();
+	scan_task_free(&background_scan);
+	if (helperstr[0])
+		set(app->TX_Status, MUIA_Text_Contents, helperstr);
+}
+
+/*
+ * Takes the batches the scan sent so far. Called by the main loop
+ * when the signal of scan_signal() arrives.
+ */
+void scan_poll(void)
+{
+	char helperstr[256];
+	scan_batch *batch;
+	int i, done = 0;
+
+	set(app->LV_GamesList, MUIA_List_Quiet, TRUE);
+	while (!done && (batch = scan_task_next(&background_scan)))
+	{
+		for (i = 0; i < batch->found_count; i++)
+		{
+			const char *path = batch->found[i].path;
+			games_list *game;
+
+			char *new_path;
+
+			if (has_path(scan_known_paths, scan_known_count, path))
+				continue;
+
+			// The new paths are remembered, in case some of them turn out to be moved games
+			if (scan_new_count == scan_new_size)
+			{
+				const int size = scan_new_size ? scan_new_size * 2 : 64;
+				char **grown = realloc(scan_new_paths, sizeof(char *) * size);
+				if (grown == NULL)
+					continue;
+
+				scan_new_paths = grown;
+				scan_new_size = size;
+			}
+
+			if ((new_path = strdup(path)) == NULL)
+				continue;
+
+			if ((game = add_scanned_slave(path, batch->found[i].title)) == NULL)
+			{
+				free(new_path);
+				continue;
+			}
+
+			scan_new_paths[scan_new_count++] = new_path;
+			if (shown_while_scanning(game->title))
+			{
+				total_games++;
+				DoMethod(app->LV_GamesList, MUIM_List_InsertSingle, game->title, MUIV_List_Insert_Sorted);
+			}
+			else
+			{
+				scan_new_unshown = 1;
+			}
+		}
+
+		scan_dirs_count += batch->dirs_count;
+		scan_found_count += batch->found_count;
+		done = batch->done;
+		scan_task_free_batch(&background_scan, batch);
+	}
+	set(app->LV_GamesList, MUIA_List_Quiet, FALSE);
+
+	if (done)
+	{
+		scan_finish();
+		return;
+	}
+
+	// The last scan tells how many directories there are, roughly
+	const int expected_dirs = background_scan.expected_dirs;
+	if (expected_dirs > scan_dirs_count && scan_dirs_count > 0)
+	{
+		const unsigned long elapsed = os_milliseconds() - scan_start_time;
+		const unsigned long seconds_left = elapsed / scan_dirs_count * (expected_dirs - scan_dirs_count) / 1000;
+		sprintf(helperstr, (const char*)GetMBString(MSG_ScanProgressEta), scan_dirs_count, scan_found_count, seconds_left);
+	}
+	else
+	{
+		sprintf(helperstr, (const char*)GetMBString(MSG_ScanProgress), scan_dirs_count, scan_found_count);
+	}
+	set(app->TX_Status, MUIA_Text_Contents, helperstr);
+}
+
+/*
+ * The signal the main loop has to wait for, or 0 if no scan is running
+ */
+ULONG scan_signal(void)
+{
+	return scan_task_signal(&background_scan);
+}
+
+void scan_stop(void)
+{
+	if (!scan_task_signal(&background_scan))
+		return;
+
+	scan_task_stop(&background_scan);
+	set(app->BT_ScanStop, MUIA_Disabled, TRUE);
+	set(app->TX_Status, MUIA_Text_Contents, GetMBString(MSG_ScanStopping));
+}
 
 static void refresh_sidepanel()
 {
@@ -1043,130 +2039,451 @@ static void refresh_sidepanel()
 	DoMethod(app->GR_sidepanel, OM_ADDMEMBER, app->Space_Sidepanel);
 	DoMethod(app->GR_sidepanel, OM_ADDMEMBER, app->LV_GenresList);
 	DoMethod(app->GR_sidepanel, MUIM_Group_ExitChange);
+
+	// The picture of the old screenshot goes after its object
+#if !defined(__amigaos4__)
+	if (shown_picture)
+		DeletePicture(shown_picture);
+#endif
+	shown_picture = next_picture;
+	next_picture = NULL;
+}
+
+/* the screenshot on the side panel */
+static char prvScreenshot[255];
+
+/* the screenshot read in the background, and the one to show once it is read */
+static screenshot_task background_screenshot;
+static char wanted_screenshot[SCREENSHOT_PATH_SIZE];
+
+#if !defined(__amigaos4__)
+static APTR new_screenshot_picture(const screenshot_image *image)
+{
+	return MakePicture(image->pixels, image->width, image->height,
+		GGFX_PixelFormat,   PIXFMT_CHUNKY_CLUT,
+		GGFX_Palette,       (ULONG)image->palette,
+		GGFX_PaletteFormat, PALFMT_RGB8,
+		GGFX_NumColors,     image->colors,
+		GGFX_Independent,   TRUE,
+		TAG_DONE);
+}
+
+/*
+ * Starts reading the screenshot in the background, scaled for the side
+ * panel, from the thumbnails file or from the picture. Returns 0 if it
+ * could not be started.
+ */
+static int screenshot_start(const char *path)
+{
+	const int width = current_settings->screenshot_width;
+	const int height = current_settings->screenshot_height;
+
+	// Short of memory, the cache goes first
+	if (AvailMem(MEMF_ANY) < SCREENSHOT_LOW_MEMORY)
+		screenshot_cache_trim(&screenshots, 0);
+
+	// The thumbnails of another size are scaled again
+	if (thumbnails.width != width || thumbnails.height != height)
+	{
+		thumb_pack_close(&thumbnails);
+		thumb_pack_open(&thumbnails, DEFAULT_THUMBNAILS_FILE, width, height);
+	}
+
+	background_screenshot.pack = &thumbnails;
+	strcpy(background_screenshot.path, path);
+	background_screenshot.width = width;
+	background_screenshot.height = height;
+
+	return screenshot_task_start(&background_screenshot);
+}
+
+/*
+ * Asks for the screenshot at the path to be shown once it is read. The
+ * one still read for a game passed by since is stopped, and this one
+ * starts when it ended. Returns 0 if it can't be read in the background.
+ */
+static int screenshot_request(const char *path)
+{
+	if (strlen(path) >= sizeof(wanted_screenshot))
+		return 0;
+
+	strcpy(wanted_screenshot, path);
+	if (screenshot_signal())
+	{
+		if (strcmp(background_screenshot.path, path))
+			background_screenshot.stop = 1;
+		return 1;
+	}
+
+	return screenshot_start(path);
 }
+#endif
+
+/*
+ * Puts the screenshot on the side panel, from the guigfx picture in
+ * next_picture if there is one, or else read from the file by
+ * Guigfx.mcc or dtpic.mui
+ */
+static void set_screenshot(const char *screenshot_path)
+{
+	if (current_settings->no_guigfx)
+	{
+		app->IM_GameImage_1 = MUI_NewObject(Dtpic_Classname,
+			MUIA_Dtpic_Name, screenshot_path,
+			MUIA_Frame,      MUIV_Frame_ImageButton,
+		End;
+	}
+	else if (next_picture)
+	{
+		app->IM_GameImage_1 = GuigfxObject,
+			MUIA_Guigfx_Picture,      next_picture,
+			MUIA_Guigfx_Quality,      MUIV_Guigfx_Quality_Best,
+			MUIA_Guigfx_ScaleMode,    NISMF_SCALEFREE | NISMF_KEEPASPECT_PICTURE,
+			MUIA_Guigfx_Transparency, 0,
+			MUIA_Frame,     MUIV_Frame_ImageButton,
+			MUIA_FixHeight, current_settings->screenshot_height,
+			MUIA_FixWidth,  current_settings->screenshot_width,
+		End;
+	}
+	else
+	{
+		app->IM_GameImage_1 = GuigfxObject,
+			MUIA_Guigfx_FileName,     screenshot_path,
+			MUIA_Guigfx_Quality,      MUIV_Guigfx_Quality_Best,
+			MUIA_Guigfx_ScaleMode,    NISMF_SCALEFREE | NISMF_KEEPASPECT_PICTURE,
+			MUIA_Guigfx_Transparency, 0,
+			MUIA_Frame,     MUIV_Frame_ImageButton,
+			MUIA_FixHeight, current_settings->screenshot_height,
+			MUIA_FixWidth,  current_settings->screenshot_width,
+		End;
+	}
+
+	if (app->IM_GameImage_1)
+	{
+		refresh_sidepanel();
+	}
+#if !defined(__amigaos4__)
+	else if (next_picture)
+	{
+		DeletePicture(next_picture);
+		next_picture = NULL;
+	}
+#endif
+}
+
+static void show_screenshot(STRPTR screenshot_path)
+{
+	if (strcmp(screenshot_path, prvScreenshot))
+	{
+		strcpy(prvScreenshot, screenshot_path);
+
+#if !defined(__amigaos4__)
+		// guigfx.library has no interface on AmigaOS 4 to make the pictures with
+		if (!current_settings->no_guigfx && current_settings->screenshot_cache > 0)
+		{
+			screenshot_image *image = screenshot_cache_get(&screenshots, screenshot_path,
+				current_settings->screenshot_width, current_settings->screenshot_height);
+
+			// The screenshot shown stays until the new one is read
+			if (image == NULL && screenshot_request(screenshot_path))
+				return;
+
+			// The one read in the background is not wanted any more
+			wanted_screenshot[0] = '\0';
+			background_screenshot.stop = 1;
+
+			if (image)
+				next_picture = new_screenshot_picture(image);
+		}
+#endif
+
+		set_screenshot(screenshot_path);
+	}
+}
+
+/*
+ * Called when the signal of screenshot_signal() arrives. The screenshot
+ * read is kept in the cache, and shown if it is still the one wanted.
+ */
+void screenshot_poll(void)
+{
+#if !defined(__amigaos4__)
+	screenshot_image *image;
+	int wanted;
+
+	if (!screenshot_task_ended(&background_screenshot))
+		return;
+
+	image = background_screenshot.image;
+	background_screenshot.image = NULL;
+	wanted = wanted_screenshot[0] && !strcmp(background_screenshot.path, wanted_screenshot);
+
+	// One that can't be read this way is read by Guigfx.mcc, unless it was only stopped
+	if (wanted && (image || !background_screenshot.stop))
+	{
+		wanted_screenshot[0] = '\0';
+		if (image)
+			next_picture = new_screenshot_picture(image);
+		set_screenshot(background_screenshot.path);
+	}
+
+	if (image)
+	{
+		screenshot_cache_add(&screenshots, background_screenshot.path, background_screenshot.width,
+			background_screenshot.height, image);
+	}
+
+	if (wanted_screenshot[0] && !screenshot_start(wanted_screenshot))
+	{
+		set_screenshot(wanted_screenshot);
+		wanted_screenshot[0] = '\0';
+	}
+#endif
+}
+
+ULONG screenshot_signal(void)
+{
+	return screenshot_task_signal(&background_screenshot);
+}
+
+/*
+ * Stops reading the screenshot in the background, without showing it
+ */
+static void screenshot_stop(void)
+{
+	wanted_screenshot[0] = '\0';
+	if (screenshot_signal())
+	{
+		screenshot_task_end(&background_screenshot);
+		screenshot_free(background_screenshot.image);
+		background_screenshot.image = NULL;
+	}
+}
+
+/*
+ * Puts an empty frame in place of the screenshot, which keeps the side
+ * panel as it was
+ */
+static void clear_screenshot(void)
+{
+	if (current_settings->hide_side_panel || current_settings->hide_screenshots || !prvScreenshot[0])
+		return;
+
+	app->IM_GameImage_1 = RectangleObject,
+		MUIA_Frame,     MUIV_Frame_ImageButton,
+		MUIA_FixHeight, current_settings->screenshot_height,
+		MUIA_FixWidth,  current_settings->screenshot_width,
+	End;
+
+	if (app->IM_GameImage_1)
+	{
+		refresh_sidepanel();
+		prvScreenshot[0] = '\0';
+	}
+}
+
+/*
+ * Gives the memory iGame can do without to the game that is started:
+ * the screenshots, the index of the thumbnails, the manifests of the
+ * game folders and, if set, the windows, by iconifying iGame
+ */
+static void release_memory(void)
+{
+	clear_screenshot();
+	screenshot_cache_trim(&screenshots, 0);
+
+	// Saved and freed, screenshot_start() opens it again
+	thumb_pack_close(&thumbnails);
+
+	// The manifests are loaded again when needed
+	manifest_release(DEFAULT_MANIFEST_FILE);
+
+	if (current_settings->iconify_on_launch)
+		set(app->App, MUIA_Application_Iconified, TRUE);
+
+	memory_released = 1;
+}
+
+/*
+ * Brings back the windows and the screenshot after the game ended
+ */
+static void restore_memory(void)
+{
+	if (!memory_released)
+		return;
+	memory_released = 0;
+
+	if (current_settings->iconify_on_launch)
+		set(app->App, MUIA_Application_Iconified, FALSE);
+
+	game_click();
+}
+
+/*
+ * Finds the screenshot of the game at the path: the igame.iff in its
+ * folder, or else the icon of its slave, or else the default one. Where
+ * it was found is kept in the manifest of the game, so showing a game
+ * again takes no disk access, until its folder changes. Returns 0 if
+ * there is none.
+ */
+static int get_screenshot_path(const char *path, char *screenshot_path, const size_t size)
+{
+	static int default_exists = -1;
+	const char *file = path + strlen(path);
+	const game_manifest *manifest;
+	int screenshot, folder_length, base_length;
+
+	while (file > path && file[-1] != '/' && file[-1] != ':')
+		file--;
+	folder_length = file - path;
+	base_length = strlen(path);
+	if (base_length > 6)
+	{
+		char extension[7];
+
+		strcpy(extension, path + base_length - 6);
+		string_to_lower(extension);
+		if (!strcmp(extension, ".slave"))
+			base_length -= 6;
+	}
 
-static void show_screenshot(STRPTR screenshot_path)
-{
-	static char prvScreenshot[255];
+	if ((manifest = manifest_peek(path)) == NULL)
+		manifest = manifest_get(path, 0);
 
-	if (strcmp(screenshot_path, prvScreenshot))
+	if (manifest && (manifest->flags & MANIFEST_SCREENSHOT))
 	{
-		if (current_settings->no_guigfx)
+		screenshot = manifest->flags;
+	}
+	else
+	{
+		// The manifest tells which of the files below are in the game folder
+		screenshot = MANIFEST_SCREENSHOT;
+
+		snprintf(screenshot_path, size, "%.*sigame.iff", folder_length, path);
+		if ((manifest == NULL || (manifest->flags & MANIFEST_IGAME_IFF)) && checkImageDatatype(screenshot_path))
 		{
-			app->IM_GameImage_1 = MUI_NewObject(Dtpic_Classname,
-				MUIA_Dtpic_Name, screenshot_path,
-				MUIA_Frame,      MUIV_Frame_ImageButton,
-			End;
+			screenshot |= MANIFEST_SCREENSHOT_IFF;
 		}
 		else
 		{
-			app->IM_GameImage_1 = GuigfxObject,
-				MUIA_Guigfx_FileName,     screenshot_path,
-				MUIA_Guigfx_Quality,      MUIV_Guigfx_Quality_Best,
-				MUIA_Guigfx_ScaleMode,    NISMF_SCALEFREE | NISMF_KEEPASPECT_PICTURE,
-				MUIA_Guigfx_Transparency, 0,
-				MUIA_Frame,     MUIV_Frame_ImageButton,
-				MUIA_FixHeight, current_settings->screenshot_height,
-				MUIA_FixWidth,  current_settings->screenshot_width,
-			End;
+			snprintf(screenshot_path, size, "%.*s.info", base_length, path);
+			if ((manifest == NULL || (manifest->flags & MANIFEST_GAME_ICON)) && checkImageDatatype(screenshot_path))
+				screenshot |= MANIFEST_SCREENSHOT_ICON;
 		}
 
-		if (app->IM_GameImage_1)
-		{
-			refresh_sidepanel();
-		}
-
-		strcpy(prvScreenshot, screenshot_path);
+		if (manifest)
+			manifest_set_screenshot(path, screenshot);
 	}
-}
 
-static char *get_screenshot_path(char *game_title)
-{
-#if defined(__amigaos4__)
-	STRPTR slavePath = AllocVecTags(sizeof(char) * MAX_PATH_SIZE, AVT_ClearWithValue,0, TAG_DONE);
-#else
-	STRPTR slavePath = AllocVec(sizeof(char) * MAX_PATH_SIZE, MEMF_CLEAR);
-#endif
-	if(slavePath == NULL)
+	if (screenshot & MANIFEST_SCREENSHOT_IFF)
 	{
-		msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
-		return NULL;
+		snprintf(screenshot_path, size, "%.*sigame.iff", folder_length, path);
+		return 1;
 	}
-	get_path(game_title, slavePath);
 
-#if defined(__amigaos4__)
-	STRPTR gameFolderPath = AllocVecTags(sizeof(char) * MAX_PATH_SIZE, AVT_ClearWithValue,0, TAG_DONE);
-#else
-	STRPTR gameFolderPath = AllocVec(sizeof(char) * MAX_PATH_SIZE, MEMF_CLEAR);
-#endif
-	if(gameFolderPath == NULL)
+	if (screenshot & MANIFEST_SCREENSHOT_ICON)
 	{
-		msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
-		return NULL;
+		snprintf(screenshot_path, size, "%.*s.info", base_length, path);
+		return 1;
 	}
 
-	if ((gameFolderPath = getParentPath(slavePath)) != NULL)
+	// The default image from iGame folder, if exists
+	if (default_exists == -1)
+		default_exists = check_path_exists(DEFAULT_SCREENSHOT_FILE) ? 1 : 0;
+
+	if (default_exists)
 	{
-#if defined(__amigaos4__)
-		STRPTR screenshotPath = AllocVecTags(sizeof(char) * MAX_PATH_SIZE, AVT_ClearWithValue,0, TAG_DONE);
+		snprintf(screenshot_path, size, "%s", DEFAULT_SCREENSHOT_FILE);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Tells if there are screenshots to read ahead, around the game shown,
+ * and nothing else is read in the background
+ */
+static int screenshot_prefetch_pending(void)
+{
+#if !defined(__amigaos4__)
+	return screenshot_prefetch_row >= 0 && screenshot_prefetch_tried < current_settings->screenshot_prefetch * 2
+		&& current_settings->screenshot_cache > 0 && !current_settings->no_guigfx && !screenshot_signal();
 #else
-		STRPTR screenshotPath = AllocVec(sizeof(char) * MAX_PATH_SIZE, MEMF_CLEAR);
+	return 0;
 #endif
-		if (screenshotPath == NULL)
-		{
-			msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
-			return NULL;
-		}
-
-		// Return the igame.iff from the game folder, if exists
-		snprintf(screenshotPath, sizeof(char) * MAX_PATH_SIZE, "%s/igame.iff", gameFolderPath);
-		if(checkImageDatatype(screenshotPath))
-		{
-			return screenshotPath;
-		}
+}
 
-		// Return the slave icon from the game folder, if exists
-		snprintf(screenshotPath, sizeof(char) * MAX_PATH_SIZE, "%s.info", substring(slavePath, 0, -6));
-		if(checkImageDatatype(screenshotPath))
-		{
-			return screenshotPath;
-		}
-	}
+/*
+ * Starts reading the screenshot of the next row around the game shown
+ * into the cache, the rows right above and below it first. The images
+ * read ahead, with the one shown, have to fit in the cache together.
+ * Called when iGame has nothing else to do.
+ */
+static int screenshot_prefetch_step(void)
+{
+#if !defined(__amigaos4__)
+	const unsigned long image_size = sizeof(screenshot_image)
+		+ (unsigned long)current_settings->screenshot_width * current_settings->screenshot_height;
+	const int distance = screenshot_prefetch_tried / 2 + 1;
+	const int row = screenshot_prefetch_row + (screenshot_prefetch_tried % 2 ? -distance : distance);
+	char screenshot_path[MAX_PATH_SIZE];
+	char *game_title = NULL;
+	LONG entries = 0;
 
-	// Return the default image from iGame folder, if exists
-	if(check_path_exists(DEFAULT_SCREENSHOT_FILE))
+	// The rest waits for the next game shown
+	if (AvailMem(MEMF_FAST) < SCREENSHOT_PREFETCH_LOW_MEMORY
+		|| image_size * (screenshot_prefetch_read + 2) > screenshots.budget)
 	{
-		return DEFAULT_SCREENSHOT_FILE;
+		screenshot_prefetch_row = -1;
+		return 1;
 	}
 
-	return NULL;
+	screenshot_prefetch_tried++;
+	get(app->LV_GamesList, MUIA_List_Entries, &entries);
+	if (row < 0 || row >= entries)
+		return 1;
+
+	DoMethod(app->LV_GamesList, MUIM_List_GetEntry, row, &game_title);
+	if (game_title == NULL || !title_exists(game_title)
+		|| !get_screenshot_path(item_games->path, screenshot_path, sizeof(screenshot_path))
+		|| screenshot_cache_has(&screenshots, screenshot_path, current_settings->screenshot_width,
+			current_settings->screenshot_height))
+		return 1;
+
+	if (strlen(screenshot_path) < sizeof(background_screenshot.path) && screenshot_start(screenshot_path))
+		screenshot_prefetch_read++;
+#endif
+
+	return 1;
 }
 
 void game_click(void)
 {
-	if (current_settings->hide_side_panel || current_settings->hide_screenshots)
-		return;
-
 	char *game_title = NULL;
 	DoMethod(app->LV_GamesList, MUIM_List_GetEntry, MUIV_List_GetEntry_Active, &game_title);
 
-	if (game_title) //for some reason, game_click is called and game_title is null??
+	// The game may well be started next
+	if (game_title && title_exists(game_title))
+		prefetch_add(item_games->path, 1);
+
+	if (current_settings->hide_side_panel || current_settings->hide_screenshots)
+		return;
+
+	if (game_title && title_exists(game_title)) //for some reason, game_click is called and game_title is null??
 	{
-#if defined(__amigaos4__)
-		STRPTR image_path = AllocVecTags(sizeof(char) * MAX_PATH_SIZE, AVT_ClearWithValue,0, TAG_DONE);
-#else
-		STRPTR image_path = AllocVec(sizeof(char) * MAX_PATH_SIZE, MEMF_CLEAR);
-#endif
-		if(image_path == NULL)
-		{
-			msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
-			return;
-		}
+		char image_path[MAX_PATH_SIZE];
 
-		strcpy(image_path, get_screenshot_path(game_title));
-		if (strcmp(image_path, ""))
+		if (get_screenshot_path(item_games->path, image_path, sizeof(image_path)))
 		{
 			show_screenshot(image_path);
+
+			// The next one shown is most likely right above or below
+			LONG active = -1;
+			get(app->LV_GamesList, MUIA_List_Active, &active);
+			screenshot_prefetch_row = active;
+			screenshot_prefetch_tried = 0;
+			screenshot_prefetch_read = 0;
 		}
 	}
 }
@@ -1197,25 +2514,12 @@ void game_click(void)
 void repo_add(void)
 {
 	char* repo_path = NULL;
+	char* repo_excludes = NULL;
 	get(app->PA_RepoPath, MUIA_String_Contents, &repo_path);
+	get(app->STR_RepoExcludes, MUIA_String_Contents, &repo_excludes);
 
 	if (repo_path && strlen(repo_path) != 0)
-	{
-		item_repos = (repos_list *)calloc(1, sizeof(repos_list));
-		item_repos->next = NULL;
-
-		strcpy(item_repos->repo, repo_path);
-
-		if (repos == NULL)
-			repos = item_repos;
-		else
-		{
-			item_repos->next = repos;
-			repos = item_repos;
-		}
-
-		DoMethod(app->LV_GameRepositories, MUIM_List_InsertSingle, item_repos->repo, 1, MUIV_List_Insert_Bottom);
-	}
+		add_repo(repo_path, repo_excludes ? repo_excludes : "");
 }
 
 void repo_remove(void)
@@ -1235,14 +2539,25 @@ void repo_stop(void)
 	}
 	else
 	{
-		CONST_STRPTR repo_path = NULL;
+		CONST_STRPTR repo_label = NULL;
 		for (int i = 0;; i++)
 		{
-			DoMethod(app->LV_GameRepositories, MUIM_List_GetEntry, i, &repo_path);
-			if (!repo_path)
+			DoMethod(app->LV_GameRepositories, MUIM_List_GetEntry, i, &repo_label);
+			if (!repo_label)
 				break;
 
-			FPuts(fprepos, repo_path);
+			// The list shows the labels, which belong to the repositories
+			for (item_repos = repos; item_repos != NULL && (CONST_STRPTR)item_repos->label != repo_label; item_repos = item_repos->next)
+				;
+			if (item_repos == NULL)
+				continue;
+
+			FPuts(fprepos, item_repos->repo);
+			if (item_repos->excludes[0])
+			{
+				FPutC(fprepos, '\t');
+				FPuts(fprepos, item_repos->excludes);
+			}
 			FPutC(fprepos, '\n');
 		}
 		Close(fprepos);
@@ -1276,14 +2591,12 @@ void game_properties(void)
 #if defined(__amigaos4__)
 	char* helperstr  = AllocVecTags(sizeof(char) * 512, AVT_ClearWithValue,0, TAG_DONE);
 	char* fullpath   = AllocVecTags(sizeof(char) * 800, AVT_ClearWithValue,0, TAG_DONE);
-	char* str2       = AllocVecTags(sizeof(char) * 512, AVT_ClearWithValue,0, TAG_DONE);
 	char* path       = AllocVecTags(sizeof(char) * 256, AVT_ClearWithValue,0, TAG_DONE);
 	char* naked_path = AllocVecTags(sizeof(char) * 256, AVT_ClearWithValue,0, TAG_DONE);
 	char* slave      = AllocVecTags(sizeof(char) * 256, AVT_ClearWithValue,0, TAG_DONE);
 #else
 	char* helperstr = AllocMem(512 * sizeof(char), MEMF_CLEAR);
 	char* fullpath = AllocMem(800 * sizeof(char), MEMF_CLEAR);
-	char* str2 = AllocMem(512 * sizeof(char), MEMF_CLEAR);
 	char* path = AllocMem(256 * sizeof(char), MEMF_CLEAR);
 	char* naked_path = AllocMem(256 * sizeof(char), MEMF_CLEAR);
 	char* slave = AllocMem(256 * sizeof(char), MEMF_CLEAR);
@@ -1292,7 +2605,6 @@ void game_properties(void)
 	// Check if any of them failed
 	if (helperstr == NULL
 		|| fullpath == NULL
-		|| str2 == NULL
 		|| path == NULL
 		|| naked_path == NULL
 		|| slave == NULL)
@@ -1374,61 +2686,18 @@ void game_properties(void)
 		return;
 	}
 
-	if (IconBase)
+	if ((disk_obj = get_game_icon(path, slave, fullpath)))
 	{
-		//scan the .info files in the current dir.
-		//one of them should be the game's project icon.
-
-		/*  allocate space for a FileInfoBlock */
-#if defined(__amigaos4__)
-		struct FileInfoBlock* m = (struct FileInfoBlock *)AllocVecTags(sizeof(struct FileInfoBlock), AVT_ClearWithValue,0, TAG_DONE);
-#else
-		struct FileInfoBlock* m = (struct FileInfoBlock *)AllocMem(sizeof(struct FileInfoBlock), MEMF_CLEAR);
-#endif
-
-		int success = Examine(lock, m);
-		if (m->fib_DirEntryType <= 0)
-		{
-			/*  We don't allow "opta file", only "opta dir" */
-			return;
-		}
-
-		while ((success = ExNext(lock, m)))
+		for (char** tool_types = (char **)disk_obj->do_ToolTypes; (tool_type = *tool_types); ++tool_types)
 		{
-			if (strcasestr(m->fib_FileName, ".info"))
-			{
-				NameFromLock(lock, (unsigned char*)str2, 512);
-				sprintf(fullpath, "%s/%s", str2, m->fib_FileName);
-
-				//lose the .info
-				for (i = strlen(fullpath) - 1; i >= 0; i--)
-				{
-					if (fullpath[i] == '.')
-						break;
-				}
-				fullpath[i] = '\0';
-
-				if ((disk_obj = GetDiskObject((STRPTR)fullpath)))
-				{
-					if (MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (STRPTR)SLAVE_STRING), (STRPTR)slave))
-					{
-						for (char** tool_types = (char **)disk_obj->do_ToolTypes; (tool_type = *tool_types); ++
-						     tool_types)
-						{
-							if (!strncmp(tool_type, "IM", 2))
-								continue;
-
-							sprintf(game_tooltypes, "%s%s\n", game_tooltypes, tool_type);
-							set(app->TX_PropertiesTooltypes, MUIA_TextEditor_ReadOnly, FALSE);
-						}
+			if (!strncmp(tool_type, "IM", 2))
+				continue;
 
-						FreeDiskObject(disk_obj);
-						break;
-					}
-					FreeDiskObject(disk_obj);
-				}
-			}
+			sprintf(game_tooltypes, "%s%s\n", game_tooltypes, tool_type);
+			set(app->TX_PropertiesTooltypes, MUIA_TextEditor_ReadOnly, FALSE);
 		}
+
+		FreeDiskObject(disk_obj);
 	}
 
 	// Cleanup the memory allocations
@@ -1438,7 +2707,6 @@ void game_properties(void)
 	FreeVec(naked_path);
 	FreeVec(helperstr);
 	FreeVec(fullpath);
-	FreeVec(str2);
 #else
 	if (slave)
 		FreeMem(slave, 256 * sizeof(char));
@@ -1450,8 +2718,6 @@ void game_properties(void)
 		FreeMem(helperstr, 512 * sizeof(char));
 	if (fullpath)
 		FreeMem(fullpath, 800 * sizeof(char));
-	if (str2)
-		FreeMem(str2, 512 * sizeof(char));
 #endif
 
 	if (strlen(game_tooltypes) == 0)
@@ -1468,18 +2734,15 @@ void game_properties(void)
 void game_properties_ok(void)
 {
 	int fav = 0, genre = 0, hid = 0;
-	char* tool_type;
 	int i;
-	int new_tool_type_count = 1, old_tool_type_count = 0, old_real_tool_type_count = 0;
+	int new_tool_type_count = 1;
 
 	char* game_title = NULL;
 	char* path = NULL; //AllocMem(256 * sizeof(char), MEMF_CLEAR);
 #if defined(__amigaos4__)
 	char* fullpath = AllocVecTags(sizeof(char) * 800, AVT_ClearWithValue,0, TAG_DONE);
-	char* str2     = AllocVecTags(sizeof(char) * 512, AVT_ClearWithValue,0, TAG_DONE);
 #else
 	char* fullpath = AllocMem(800 * sizeof(char), MEMF_CLEAR);
-	char* str2 = AllocMem(512 * sizeof(char), MEMF_CLEAR);
 #endif
 
 	get(app->STR_PropertiesGameTitle, MUIA_String_Contents, &game_title);
@@ -1562,114 +2825,65 @@ void game_properties_ok(void)
 
 		string_to_lower(slave);
 
-		const BPTR oldlock = Lock((CONST_STRPTR)PROGDIR, ACCESS_READ);
-		const BPTR lock = Lock((CONST_STRPTR)naked_path, ACCESS_READ);
-		CurrentDir(lock);
-
-		if (IconBase)
-		{
-			//scan the .info files in the current dir.
-			//one of them should be the game's project icon.
+		//one slot for every line of the editor, plus the terminating NULL
+		for (i = 0; tools[i] != '\0'; i++)
+			if (tools[i] == '\n') new_tool_type_count++;
+		new_tool_type_count++;
 
-			/*  allocate space for a FileInfoBlock */
 #if defined(__amigaos4__)
-			struct FileInfoBlock* m = (struct FileInfoBlock *)AllocVecTags(sizeof(struct FileInfoBlock), AVT_ClearWithValue,0, TAG_DONE);
+		unsigned char** new_tool_types = AllocVecTags(sizeof(char *) * new_tool_type_count, AVT_ClearWithValue,0, TAG_DONE);
 #else
-			struct FileInfoBlock* m = (struct FileInfoBlock *)AllocMem(sizeof(struct FileInfoBlock), MEMF_CLEAR);
+		unsigned char** new_tool_types = AllocVec(new_tool_type_count * sizeof(char *),
+		                                          MEMF_FAST | MEMF_CLEAR);
 #endif
+		if (new_tool_types == NULL)
+			msg_box((const char*)GetMBString(MSG_NotEnoughMemory));
+		else
+		{
+			unsigned char** newptr = new_tool_types;
+
+			//the exported text is ours, so the lines are terminated in place
+			tokenizer tok;
+			const char *line;
+			size_t line_length;
 
-			Examine(lock, m);
-			if (m->fib_DirEntryType <= 0)
+			tokenizer_init(&tok, (const char *)tools, "\n");
+			while (tokenizer_next(&tok, &line, &line_length))
 			{
-				/*  We don't allow "opta file", only "opta dir" */
-				return;
-			}
+				if (line_length == 0)
+					continue;
 
-			while (ExNext(lock, m))
+				((char *)line)[line_length] = '\0';
+				*newptr++ = (unsigned char*)line;
+			}
+			*newptr = NULL;
+
+			// Icons that are not classic ones are saved by icon.library
+			const int saved = save_game_tool_types(path, slave, (const char *const *)new_tool_types,
+				newptr - new_tool_types);
+			if (saved < 0)
+				msg_box((const char*)GetMBString(MSG_IconSaveFailed));
+			else if (saved == 0)
 			{
-				if (strcasestr(m->fib_FileName, ".info"))
+				struct DiskObject* disk_obj = get_game_icon(path, slave, fullpath);
+				if (disk_obj)
 				{
-					NameFromLock(lock, (unsigned char*)str2, 512);
-					sprintf(fullpath, "%s/%s", str2, m->fib_FileName);
-
-					//lose the .info
-					for (i = strlen(fullpath) - 1; i >= 0; i--)
-					{
-						if (fullpath[i] == '.')
-							break;
-					}
-					fullpath[i] = '\0';
-
-					struct DiskObject* disk_obj = GetDiskObject((STRPTR)fullpath);
-					if (disk_obj)
-					{
-						if (MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (STRPTR)SLAVE_STRING), (STRPTR)slave))
-						{
-							//check numbers for old and new tooltypes
-							for (i = 0; i <= strlen(tools); i++)
-								if (tools[i] == '\n') new_tool_type_count++;
-
-							//add one for the last tooltype that doesnt end with \n
-							new_tool_type_count++;
-
-							for (i = 0; i <= strlen(game_tooltypes); i++)
-								if (game_tooltypes[i] == '\n') old_tool_type_count++;
-
-							for (char** tool_types = (char **)disk_obj->do_ToolTypes; (tool_type = *tool_types); ++tool_types)
-								old_real_tool_type_count++;
-
-#if defined(__amigaos4__)
-							unsigned char** new_tool_types = AllocVecTags(sizeof(char *) * new_tool_type_count, AVT_ClearWithValue,0, TAG_DONE);
-#else
-							unsigned char** new_tool_types = AllocVec(new_tool_type_count * sizeof(char *),
-							                                          MEMF_FAST | MEMF_CLEAR);
-#endif
-							unsigned char** newptr = new_tool_types;
-
-							char** temp_tbl = my_split((char *)tools, "\n");
-							if (temp_tbl == NULL
-								|| temp_tbl[0] == NULL
-								|| !strcmp((char *)temp_tbl[0], " ")
-								|| !strcmp((unsigned char *)temp_tbl[0], ""))
-								break;
-
-							for (i = 0; i <= new_tool_type_count - 2; i++)
-								*newptr++ = (unsigned char*)temp_tbl[i];
-
-							*newptr = NULL;
-
-							disk_obj->do_ToolTypes = (STRPTR *)new_tool_types;
-							PutDiskObject((STRPTR)fullpath, disk_obj);
-							FreeDiskObject(disk_obj);
-
-							if (temp_tbl)
-								free(temp_tbl);
-							if (new_tool_types)
-								FreeVec(new_tool_types);
-
-							break;
-						}
-						FreeDiskObject(disk_obj);
-					}
+					STRPTR *old_tool_types = disk_obj->do_ToolTypes;
+					disk_obj->do_ToolTypes = (STRPTR *)new_tool_types;
+					PutDiskObject((STRPTR)fullpath, disk_obj);
+					disk_obj->do_ToolTypes = old_tool_types;
+					FreeDiskObject(disk_obj);
 				}
 			}
-#if defined(__amigaos4__)
-			FreeVec(m);
-#else
-			if (m)
-				FreeMem(m, sizeof(struct FileInfoBlock));
-#endif
+			FreeVec(new_tool_types);
 		}
 
-		CurrentDir(oldlock);
-
 		// Cleanup the memory allocations
 #if defined(__amigaos4__)
 		FreeVec(slave);
 		FreeVec(naked_path);
 		//FreeVec(game_tooltypes);
 		FreeVec(fullpath);
-		FreeVec(str2);
 #else
 		if (slave)
 			FreeMem(slave, 256 * sizeof(char));
@@ -1679,8 +2893,6 @@ void game_properties_ok(void)
 		//	FreeMem(game_tooltypes, 1024 * sizeof(char));
 		if (fullpath)
 			FreeMem(fullpath, 800 * sizeof(char));
-		if (str2)
-			FreeMem(str2, 512 * sizeof(char));
 #endif
 	}
 	FreeVec(tools);
@@ -1727,9 +2939,40 @@ void list_show_hidden(void)
 
 void app_stop(void)
 {
+	// The scan process has to be gone before iGame quits
+	if (scan_task_signal(&background_scan))
+	{
+		scan_task_stop(&background_scan);
+		scan_task_end(&background_scan);
+		scan_task_free(&background_scan);
+		free_scan_state();
+	}
+
+	// So do the staging process and the launch process, which waits for the game to end
+	if (stage_signal())
+		stage_task_end(&background_stage);
+
+	if (launch_signal())
+	{
+		launch_task_end(&background_launch);
+		launch_ended();
+	}
+	stage_cache_close(&game_stage);
+
 	if (current_settings->save_stats_on_exit)
 		save_list(0);
 
+	// Nothing is read ahead while the manifests are saved
+	prefetch_stop();
+	manifest_save(DEFAULT_MANIFEST_FILE);
+	manifest_free();
+
+	// The picture on the side panel can go only with its object
+	screenshot_stop();
+	clear_screenshot();
+	screenshot_cache_free(&screenshots);
+	thumb_pack_close(&thumbnails);
+
 	memset(&fname[0], 0, sizeof fname);
 
 	if (games)
@@ -1754,152 +2997,85 @@ void genres_click(void)
 	filter_change();
 }
 
-static void follow_thread(BPTR lock, int tab_level)
+/*
+ * Adds a slave found by the scanner to the gameslist,
+ * or marks it as existing if it is already there
+ */
+/*
+ * Adds a slave that is not in the list yet.
+ * Returns the new entry, or NULL if it ran out of memory.
+ */
+static games_list *add_scanned_slave(const char *fullpath, const char *slave_title)
 {
-	int exists = 0, j;
-	char str[512], fullpath[512], temptitle[256];
-
-	/*  if at the end of the road, don't print anything */
-	if (!lock)
-		return;
-
-	/*  allocate space for a FileInfoBlock */
-#if defined(__amigaos4__)
-		struct FileInfoBlock* m = (struct FileInfoBlock *)AllocVecTags(sizeof(struct FileInfoBlock), AVT_ClearWithValue,0, TAG_DONE);
-#else
-	struct FileInfoBlock* m = (struct FileInfoBlock *)AllocMem(sizeof(struct FileInfoBlock), MEMF_CLEAR);
-#endif
+	char temptitle[256];
+	int j, n = 0;
 
-	int success = Examine(lock, m);
-	if (m->fib_DirEntryType <= 0)
-		return;
-
-	/*  The first call to Examine fills the FileInfoBlock with information
-	about the directory.  If it is called at the root level, it contains
-	the volume name of the disk.  Thus, this program is only printing
-	the output of ExNext rather than both Examine and ExNext.  If it
-	printed both, it would list directory entries twice! */
+	item_games = (games_list *)calloc(1, sizeof(games_list));
+	if (item_games == NULL)
+		return NULL;
 
-	while ((success = ExNext(lock, m)))
+	/* the fallback title is the name of the directory the slave is in */
+	for (j = strlen(fullpath) - 1; j >= 0; j--)
 	{
-		/*  Print what we've got: */
-		if (m->fib_DirEntryType > 0)
-		{
-		}
+		if (fullpath[j] == '/' || fullpath[j] == ':')
+			break;
+	}
+	const int end = j;
+	for (j = end - 1; j >= 0; j--)
+	{
+		if (fullpath[j] == '/' || fullpath[j] == ':')
+			break;
+	}
+	for (int k = j + 1; k < end && n < sizeof(temptitle) - 1; k++)
+		temptitle[n++] = fullpath[k];
+	temptitle[n] = '\0';
 
-		//make m->fib_FileName to lower
-		const int kp = strlen((char *)m->fib_FileName);
-		for (int s = 0; s < kp; s++) m->fib_FileName[s] = tolower(m->fib_FileName[s]);
-		if (strcasestr(m->fib_FileName, ".slave"))
+	if (current_settings->titles_from_dirs)
+	{
+		// If the TITLESFROMDIRS tooltype is enabled, set Titles from Directory names
+		const char* title = get_directory_name(fullpath);
+		if (title != NULL)
 		{
-			NameFromLock(lock, (unsigned char*)str, 511);
-			sprintf(fullpath, "%s/%s", str, m->fib_FileName);
-
-			/* add the slave to the gameslist (if it does not already exist) */
-			for (item_games = games; item_games != NULL; item_games = item_games->next)
+			if (current_settings->no_smart_spaces)
 			{
-				if (!strcmp(item_games->path, fullpath))
-				{
-					exists = 1;
-					item_games->exists = 1;
-					break;
-				}
+				strcpy(item_games->title, title);
 			}
-			if (exists == 0)
+			else
 			{
-				item_games = (games_list *)calloc(1, sizeof(games_list));
-				item_games->next = NULL;
-
-				/* strip the path from the slave file and get the rest */
-				for (j = strlen(str) - 1; j >= 0; j--)
-				{
-					if (str[j] == '/' || str[j] == ':')
-						break;
-				}
-
-				//CHANGE 2007-12-03: init n=0 here
-				int n = 0;
-				for (int k = j + 1; k <= strlen(str) - 1; k++)
-					temptitle[n++] = str[k];
-				temptitle[n] = '\0';
-
-				if (current_settings->titles_from_dirs)
-				{
-					// If the TITLESFROMDIRS tooltype is enabled, set Titles from Directory names
-					const char* title = get_directory_name(fullpath);
-					if (title != NULL)
-					{
-						if (current_settings->no_smart_spaces)
-						{
-							strcpy(item_games->title, title);
-						}
-						else
-						{
-							const char* title_with_spaces = add_spaces_to_string(title);
-							strcpy(item_games->title, title_with_spaces);
-						}
-					}
-				}
-				else
-				{
-					// Default behavior: set Titles by the .slave contents
-					if (get_title_from_slave(fullpath, item_games->title))
-						strcpy(item_games->title, temptitle);
-				}
-
-				while (check_dup_title(item_games->title))
-				{
-					strcat(item_games->title, " Alt");
-				}
-
-				strcpy(item_games->genre, GetMBString(MSG_UnknownGenre));
-				strcpy(item_games->path, fullpath);
-				item_games->favorite = 0;
-				item_games->times_played = 0;
-				item_games->last_played = 0;
-				item_games->exists = 1;
-				item_games->hidden = 0;
-
-				if (games == NULL)
-				{
-					games = item_games;
-				}
-				else
-				{
-					item_games->next = games;
-					games = item_games;
-				}
+				const char* title_with_spaces = add_spaces_to_string(title);
+				strcpy(item_games->title, title_with_spaces);
 			}
-			exists = 0;
 		}
+	}
+	else
+	{
+		// Default behavior: set Titles by the .slave contents
+		if (slave_title[0])
+			strcpy(item_games->title, slave_title);
+		else
+			strcpy(item_games->title, temptitle);
+	}
 
-		/*  If we have a directory, then enter it: */
-		if (m->fib_DirEntryType > 0)
-		{
-			/*  Since it is a directory, get a lock on it: */
-			const BPTR newlock = Lock((CONST_STRPTR)m->fib_FileName, ACCESS_READ);
-
-			/*  cd to this directory: */
-			const BPTR oldlock = CurrentDir(newlock);
+	while (check_dup_title(item_games->title))
+	{
+		strcat(item_games->title, " Alt");
+	}
 
-			/*  recursively follow the thread down to the bottom: */
-			follow_thread(newlock, tab_level + 1);
+	strcpy(item_games->genre, GetMBString(MSG_UnknownGenre));
+	strcpy(item_games->path, fullpath);
+	item_games->favorite = 0;
+	item_games->times_played = 0;
+	item_games->last_played = 0;
+	item_games->exists = 1;
+	item_games->hidden = 0;
 
-			/*  cd back to where we used to be: */
-			CurrentDir(oldlock);
+	item_games->next = games;
+	games = item_games;
 
-			/*  Unlock the directory we just visited: */
-			if (newlock)
-				UnLock(newlock);
-		}
-	}
-#if defined(__amigaos4__)
-	FreeVec(m);
-#else
-	FreeMem(m, sizeof(struct FileInfoBlock));
-#endif
+	return item_games;
 }
 
+
 static void refresh_list(const int check_exists)
 {
 	DoMethod(app->LV_GamesList, MUIM_List_Clear);
@@ -1944,6 +3120,7 @@ static void refresh_list(const int check_exists)
 void save_list(const int check_exists)
 {
 	save_to_csv(DEFAULT_GAMESLIST_FILE, check_exists);
+	manifest_save(DEFAULT_MANIFEST_FILE);
 }
 
 void save_list_as(void)
@@ -1957,21 +3134,18 @@ void open_list(void)
 {
 	if (get_filename("Open List", "Open", FALSE))
 	{
+		// The scan was of the list open until now, what it found so far is kept in it
+		if (scan_signal())
+		{
+			scan_task_stop(&background_scan);
+			scan_finish();
+		}
+
 		clear_gameslist();
 		load_games_list(fname);
 	}
 }
 
-//function to return the dec eq of a hex no.
-static int hex2dec(char* hexin)
-{
-	int dec;
-	//lose the first $ character
-	hexin++;
-	sscanf(hexin, "%x", &dec);
-	return dec;
-}
-
 void game_duplicate(void)
 {
 	char* str = NULL;
@@ -2172,8 +3346,22 @@ void settings_use(void)
 		current_settings->screenshot_width = (int)get_str(app->STR_Width);
 		current_settings->screenshot_height = (int)get_str(app->STR_Height);
 	}
+	current_settings->scan_max_depth = (int)xget(app->STR_ScanMaxDepth, MUIA_String_Integer);
+	current_settings->scan_memory_limit = (int)xget(app->STR_ScanMemoryLimit, MUIA_String_Integer);
+	current_settings->prefetch_budget = (int)xget(app->STR_PrefetchBudget, MUIA_String_Integer);
+	strncpy(current_settings->stage_dir, get_str(app->STR_StageDir), sizeof(current_settings->stage_dir) - 1);
+	current_settings->stage_budget = (int)xget(app->STR_StageBudget, MUIA_String_Integer);
+	current_settings->screenshot_cache = (int)xget(app->STR_ScreenshotCache, MUIA_String_Integer);
+	current_settings->screenshot_prefetch = (int)xget(app->STR_ScreenshotPrefetch, MUIA_String_Integer);
+
+	// The screenshots that fit in the new budget are kept
+	screenshots.budget = (unsigned long)current_settings->screenshot_cache * 1024;
+	screenshot_cache_trim(&screenshots, screenshots.budget);
 
 	set(app->WI_Settings, MUIA_Window_Open, FALSE);
+
+	// The staging cache starts with the new settings
+	stage_start();
 }
 
 void settings_save(void)
@@ -2203,6 +3391,24 @@ void settings_save(void)
 	FPuts(fpsettings, (CONST_STRPTR)file_line);
 	snprintf(file_line, buffer_size, "start_with_favorites=%d\n", current_settings->start_with_favorites);
 	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "scan_game_subfolders=%d\n", current_settings->scan_game_subfolders);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "scan_max_depth=%d\n", current_settings->scan_max_depth);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "scan_memory_limit=%d\n", current_settings->scan_memory_limit);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "hide_duplicates=%d\n", current_settings->hide_duplicates);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "prefetch_budget=%d\n", current_settings->prefetch_budget);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "free_memory_on_launch=%d\n", current_settings->free_memory_on_launch);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "iconify_on_launch=%d\n", current_settings->iconify_on_launch);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "stage_dir=%s\n", current_settings->stage_dir);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "stage_budget=%d\n", current_settings->stage_budget);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
 	snprintf(file_line, buffer_size, "save_stats_on_exit=%d\n", current_settings->save_stats_on_exit);
 	FPuts(fpsettings, (CONST_STRPTR)file_line);
 	snprintf(file_line, buffer_size, "no_smart_spaces=%d\n", current_settings->no_smart_spaces);
@@ -2215,6 +3421,10 @@ void settings_save(void)
 	FPuts(fpsettings, (CONST_STRPTR)file_line);
 	snprintf(file_line, buffer_size, "screenshot_height=%d\n", current_settings->screenshot_height);
 	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "screenshot_cache=%d\n", current_settings->screenshot_cache);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
+	snprintf(file_line, buffer_size, "screenshot_prefetch=%d\n", current_settings->screenshot_prefetch);
+	FPuts(fpsettings, (CONST_STRPTR)file_line);
 
 	Close(fpsettings);
 	if (file_line)
@@ -2231,6 +3441,26 @@ void setting_start_with_favorites_changed(void)
 	current_settings->start_with_favorites = (BOOL)xget(app->CH_StartWithFavorites, MUIA_Selected);
 }
 
+void setting_scan_game_subfolders_changed(void)
+{
+	current_settings->scan_game_subfolders = (BOOL)xget(app->CH_ScanGameSubfolders, MUIA_Selected);
+}
+
+void setting_hide_duplicates_changed(void)
+{
+	current_settings->hide_duplicates = (BOOL)xget(app->CH_HideDuplicates, MUIA_Selected);
+}
+
+void setting_free_memory_on_launch_changed(void)
+{
+	current_settings->free_memory_on_launch = (BOOL)xget(app->CH_FreeMemoryOnLaunch, MUIA_Selected);
+}
+
+void setting_iconify_on_launch_changed(void)
+{
+	current_settings->iconify_on_launch = (BOOL)xget(app->CH_IconifyOnLaunch, MUIA_Selected);
+}
+
 void msg_box(const char* msg)
 {
 	msgbox.es_StructSize = sizeof msgbox;
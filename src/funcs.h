@@ -32,7 +32,20 @@ void joystick_input(ULONG);
 void app_stop(void);
 void save_list(const int);
 ULONG get_wb_version(void);
-void scan_repositories(void);
+void scan_repositories(int);
+void scan_poll(void);
+ULONG scan_signal(void);
+void launch_poll(void);
+ULONG launch_signal(void);
+void stage_poll(void);
+ULONG stage_signal(void);
+void screenshot_poll(void);
+ULONG screenshot_signal(void);
+int prefetch_pending(void);
+void prefetch_step(void);
+void prefetch_poll(void);
+ULONG prefetch_signal(void);
+void scan_stop(void);
 void open_list(void);
 void save_list_as(void);
 void game_duplicate(void);
@@ -59,6 +72,10 @@ void setting_screenshot_size_changed(void);
 void settings_save(void);
 void setting_hide_side_panel_changed(void);
 void setting_start_with_favorites_changed(void);
+void setting_scan_game_subfolders_changed(void);
+void setting_hide_duplicates_changed(void);
+void setting_free_memory_on_launch_changed(void);
+void setting_iconify_on_launch_changed(void);
 void settings_use(void);
 void add_games_to_listview(void);
 igame_settings *load_settings(const char *);
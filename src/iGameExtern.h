@@ -28,10 +28,15 @@
 #define TEMPLATE "SCREENSHOT/K"
 #define PROGDIR "PROGDIR:"
 #define DEFAULT_GAMESLIST_FILE "PROGDIR:gameslist"
+#define DEFAULT_SESSIONS_FILE "PROGDIR:gameslist.sessions"
 #define DEFAULT_REPOS_FILE "PROGDIR:repos.prefs"
 #define DEFAULT_GENRES_FILE "PROGDIR:genres"
 #define DEFAULT_SCREENSHOT_FILE "PROGDIR:igame.iff"
 #define DEFAULT_SETTINGS_FILE "PROGDIR:igame.prefs"
+#define DEFAULT_SCANCACHE_FILE "PROGDIR:scancache"
+#define DEFAULT_SLAVECACHE_FILE "PROGDIR:slavecache"
+#define DEFAULT_MANIFEST_FILE "PROGDIR:gamefolders"
+#define DEFAULT_THUMBNAILS_FILE "PROGDIR:thumbnails"
 #define SLAVE_STRING "slave"
 #define WB_PUBSCREEN_NAME "Workbench"
 
@@ -43,6 +48,32 @@
 #define TOOLTYPE_TITLESFROMDIRS "TITLESFROMDIRS"
 #define TOOLTYPE_NOSMARTSPACES "NOSMARTSPACES"
 #define TOOLTYPE_NOSIDEPANEL "NOSIDEPANEL"
+#define TOOLTYPE_NOGAMESUBFOLDERS "NOGAMESUBFOLDERS"
+#define TOOLTYPE_SCANMAXDEPTH "SCANMAXDEPTH"
+#define TOOLTYPE_SCANMEMORYLIMIT "SCANMEMORYLIMIT"
+#define TOOLTYPE_HIDEDUPLICATES "HIDEDUPLICATES"
+#define TOOLTYPE_PREFETCHBUDGET "PREFETCHBUDGET"
+#define TOOLTYPE_FREEMEMORYONLAUNCH "FREEMEMORYONLAUNCH"
+#define TOOLTYPE_ICONIFYONLAUNCH "ICONIFYONLAUNCH"
+#define TOOLTYPE_STAGEDIR "STAGEDIR"
+#define TOOLTYPE_STAGEBUDGET "STAGEBUDGET"
+#define TOOLTYPE_SCREENSHOTCACHE "SCREENSHOTCACHE"
+#define TOOLTYPE_SCREENSHOTPREFETCH "SCREENSHOTPREFETCH"
+
+/* the subfolders of a folder with a slave are scanned too, as they always were */
+#define DEFAULT_SCAN_GAME_SUBFOLDERS 1
+
+/* milliseconds of prefetching at a time, when iGame is idle */
+#define DEFAULT_PREFETCH_BUDGET 50
+
+/* where the game folders are copied, when a staging size is set */
+#define DEFAULT_STAGE_DIR "RAM:iGameStage"
+
+/* KB of screenshots kept in memory, scaled for the side panel */
+#define DEFAULT_SCREENSHOT_CACHE 512
+
+/* rows above and below the selected game whose screenshots are read ahead */
+#define DEFAULT_SCREENSHOT_PREFETCH 2
 
 #define FILENAME_HOTKEY 'f'
 #define QUALITY_HOTKEY 'q'
@@ -84,6 +115,17 @@ typedef struct settings
 	int hide_side_panel;
 	int no_guigfx;
 	int start_with_favorites;
+	int scan_game_subfolders;
+	int scan_max_depth;
+	int scan_memory_limit;
+	int hide_duplicates;
+	int prefetch_budget;
+	int free_memory_on_launch;
+	int iconify_on_launch;
+	char stage_dir[256];
+	int stage_budget;
+	int screenshot_cache;
+	int screenshot_prefetch;
 } igame_settings;
 
 typedef struct genres
@@ -95,6 +137,8 @@ typedef struct genres
 typedef struct repos
 {
 	char repo[256];
+	char excludes[256];  /* patterns of the folders the scan skips, separated by ';' */
+	char label[520];     /* what the list of the repositories shows */
 	struct repos* next;
 } repos_list;
 
@@ -110,12 +154,14 @@ typedef struct games
 	int exists; //indicates whether this game still exists after a scan
 	int hidden; //game is hidden from normal operation
 	int deleted; // indicates this entry should be deleted when the list is saved
+	int play_time; // seconds the game ran, from iGame
 	struct games* next;
 } games_list;
 
 enum {
 	MENU_ACTIONS=1,
 	MENU_SCAN,
+	MENU_SCANFULL,
 	MENU_ADDGAME,
 	MENU_SHOWHIDDEN,
 	MENU_ABOUT,
@@ -81,6 +81,7 @@ static struct NewMenu MenuMainWin[] =
 {
 	{ NM_TITLE, STR_ID(MSG_MNlabel2Actions), 0 ,0 ,0, (APTR)MENU_ACTIONS                        },
 	{ NM_ITEM ,  STR_ID(MSG_MNlabelScan)                    ,"R",0    ,0, (APTR)MENU_SCAN       },
+	{ NM_ITEM ,  STR_ID(MSG_MNlabelScanFull)                , 0 ,0    ,0, (APTR)MENU_SCANFULL   },
 	{ NM_ITEM ,  STR_ID(MSG_MNMainAddnonWHDLoadgame)        ,"A",0    ,0, (APTR)MENU_ADDGAME    },
 	{ NM_ITEM ,  STR_ID(MSG_MNMainMenuShowHidehiddenentries), 0 ,TICK ,0, (APTR)MENU_SHOWHIDDEN },
 	{ NM_ITEM ,  NM_BARLABEL, 0 ,0 ,0, (APTR)0                                                  },
@@ -132,17 +133,17 @@ struct ObjApp *CreateApp(void)
 	//APTR	MNMainOpenList, MNMainSaveList, MNMainSaveListAs;
 	//APTR	MNMainMenuDuplicate, MNMainDelete;
 	APTR	GROUP_ROOT;
-	APTR	GR_Filter, GR_main;
+	APTR	GR_Filter, GR_main, GR_Status;
 	APTR	GROUP_ROOT_1, GR_Genre;
 	APTR	GR_PropertiesChecks, obj_aux0, obj_aux2;
 	APTR	obj_aux3, GR_TimesPlayed;
 	APTR	GR_SlavePath, GR_Tooltypes, GR_PropertiesButtons;
-	APTR	GROUP_ROOT_2, GR_Path, GR_ReposButtons, GROUP_ROOT_3;
+	APTR	GROUP_ROOT_2, GR_Path, GR_RepoExcludes, GR_ReposButtons, GROUP_ROOT_3;
 	APTR	GR_AddGameTitle, GR_AddGamePath;
 	APTR	GR_AddGameGenre, GR_AddGameButtons;
 	APTR	GROUP_ROOT_4, GROUP_ROOT_Settings, GR_Settings;
 	APTR	GR_Screenshots;
-	APTR	GR_ScreenshotSize;
+	APTR	GR_ScreenshotSize, GR_ScreenshotCache;
 	APTR	GR_CustomSize, GR_Titles;
 	APTR	GR_TitlesFrom, GR_SmartSpaces, GR_Misc;
 	APTR	GR_SettingsButtons;
@@ -163,6 +164,7 @@ struct ObjApp *CreateApp(void)
 	static const struct Hook RepoStopHook = { { NULL,NULL }, (HOOKFUNC)repo_stop, NULL, NULL };
 	static const struct Hook RepoAddHook = { { NULL,NULL }, (HOOKFUNC)repo_add, NULL, NULL };
 	static const struct Hook RepoRemoveHook = { { NULL,NULL }, (HOOKFUNC)repo_remove, NULL, NULL };
+	static const struct Hook ScanStopHook = { { NULL,NULL }, (HOOKFUNC)scan_stop, NULL, NULL };
 	static const struct Hook SettingFilterUseEnterChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_filter_use_enter_changed, NULL, NULL };
 	static const struct Hook SettingSaveStatsOnExitChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_save_stats_on_exit_changed, NULL, NULL };
 	static const struct Hook SettingSmartSpacesChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_smart_spaces_changed, NULL, NULL };
@@ -173,6 +175,10 @@ struct ObjApp *CreateApp(void)
 	static const struct Hook SettingsSaveHook = { { NULL,NULL }, (HOOKFUNC)settings_save, NULL, NULL };
 	static const struct Hook SettingHideSidePanelChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_hide_side_panel_changed, NULL, NULL };
 	static const struct Hook SettingStartWithFavoritesChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_start_with_favorites_changed, NULL, NULL };
+	static const struct Hook SettingScanGameSubfoldersChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_scan_game_subfolders_changed, NULL, NULL };
+	static const struct Hook SettingHideDuplicatesChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_hide_duplicates_changed, NULL, NULL };
+	static const struct Hook SettingFreeMemoryOnLaunchChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_free_memory_on_launch_changed, NULL, NULL };
+	static const struct Hook SettingIconifyOnLaunchChangedHook = { { NULL,NULL }, (HOOKFUNC)setting_iconify_on_launch_changed, NULL, NULL };
 	static const struct Hook SettingsUseHook = { { NULL,NULL }, (HOOKFUNC)settings_use, NULL, NULL };
 #else
 	static const struct Hook MenuOpenListHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)open_list, NULL };
@@ -190,6 +196,7 @@ struct ObjApp *CreateApp(void)
 	static const struct Hook RepoStopHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)repo_stop, NULL };
 	static const struct Hook RepoAddHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)repo_add, NULL };
 	static const struct Hook RepoRemoveHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)repo_remove, NULL };
+	static const struct Hook ScanStopHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)scan_stop, NULL };
 	static const struct Hook SettingFilterUseEnterChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_filter_use_enter_changed, NULL };
 	static const struct Hook SettingSaveStatsOnExitChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_save_stats_on_exit_changed, NULL };
 	static const struct Hook SettingSmartSpacesChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_smart_spaces_changed, NULL };
@@ -200,6 +207,10 @@ struct ObjApp *CreateApp(void)
 	static const struct Hook SettingsSaveHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)settings_save, NULL };
 	static const struct Hook SettingHideSidePanelChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_hide_side_panel_changed, NULL };
 	static const struct Hook SettingStartWithFavoritesChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_start_with_favorites_changed, NULL };
+	static const struct Hook SettingScanGameSubfoldersChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_scan_game_subfolders_changed, NULL };
+	static const struct Hook SettingHideDuplicatesChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_hide_duplicates_changed, NULL };
+	static const struct Hook SettingFreeMemoryOnLaunchChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_free_memory_on_launch_changed, NULL };
+	static const struct Hook SettingIconifyOnLaunchChangedHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)setting_iconify_on_launch_changed, NULL };
 	static const struct Hook SettingsUseHook = { { NULL,NULL }, HookEntry, (HOOKFUNC)settings_use, NULL };
 #endif
 
@@ -327,10 +338,29 @@ struct ObjApp *CreateApp(void)
 		MUIA_Text_SetMin, TRUE,
 	End;
 
+	// Only enabled while a scan runs
+	object->BT_ScanStop = TextObject,
+		ButtonFrame,
+		MUIA_Background, MUII_ButtonBack,
+		MUIA_Text_Contents, GetMBString(MSG_BT_ScanStop),
+		MUIA_Text_PreParse, "\33c",
+		MUIA_Text_SetMax, TRUE,
+		MUIA_InputMode, MUIV_InputMode_RelVerify,
+		MUIA_Disabled, TRUE,
+		MUIA_HelpNode, "BT_ScanStop",
+	End;
+
+	GR_Status = GroupObject,
+		MUIA_HelpNode, "GR_Status",
+		MUIA_Group_Horiz, TRUE,
+		Child, object->TX_Status,
+		Child, object->BT_ScanStop,
+	End;
+
 	GROUP_ROOT = GroupObject,
 		Child, GR_Filter,
 		Child, GR_main,
-		Child, object->TX_Status,
+		Child, GR_Status,
 	End;
 
 	/*MNMainOpenList = MenuitemObject,
@@ -517,6 +547,18 @@ struct ObjApp *CreateApp(void)
 		Child, object->BT_AddRepo,
 	End;
 
+	object->STR_RepoExcludes = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_RepoExcludes",
+		MUIA_String_MaxLen, 256,
+	End;
+	GR_RepoExcludes = GroupObject,
+		MUIA_HelpNode, "GR_RepoExcludes",
+		MUIA_Group_Horiz, TRUE,
+		Child, Label(GetMBString(MSG_LA_RepoExcludes)),
+		Child, object->STR_RepoExcludes,
+	End;
+
 	object->LV_GameRepositories = ListObject,
 		MUIA_Frame, MUIV_Frame_InputList,
 	End;
@@ -538,6 +580,7 @@ struct ObjApp *CreateApp(void)
 
 	GROUP_ROOT_2 = GroupObject,
 		Child, GR_Path,
+		Child, GR_RepoExcludes,
 		Child, object->LV_GameRepositories,
 		Child, GR_ReposButtons,
 	End;
@@ -668,6 +711,27 @@ struct ObjApp *CreateApp(void)
 		Child, HSpace(0),
 	End;
 
+	object->STR_ScreenshotCache = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_ScreenshotCache",
+		MUIA_String_Accept, "0123456789",
+		MUIA_String_MaxLen, 6,
+	End;
+	object->STR_ScreenshotPrefetch = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_ScreenshotPrefetch",
+		MUIA_String_Accept, "0123456789",
+		MUIA_String_MaxLen, 3,
+	End;
+	GR_ScreenshotCache = GroupObject,
+		MUIA_HelpNode, "GR_ScreenshotCache",
+		MUIA_Group_Horiz, TRUE,
+		Child, Label2(GetMBString(MSG_LA_ScreenshotCache)),
+		Child, object->STR_ScreenshotCache,
+		Child, Label2(GetMBString(MSG_LA_ScreenshotPrefetch)),
+		Child, object->STR_ScreenshotPrefetch,
+	End;
+
 	GR_Screenshots = GroupObject,
 		MUIA_HelpNode, "GR_Screenshots",
 		MUIA_Frame, MUIV_Frame_Group,
@@ -681,6 +745,7 @@ struct ObjApp *CreateApp(void)
 		End,
 		Child, GR_ScreenshotSize,
 		Child, GR_CustomSize,
+		Child, GR_ScreenshotCache,
 	End;
 
 	/*object->RA_TitlesFrom = RadioObject,
@@ -727,6 +792,39 @@ struct ObjApp *CreateApp(void)
 	object->CH_FilterUseEnter     = CheckMark(FALSE);
 	object->CH_HideSidepanel      = CheckMark(FALSE);
 	object->CH_StartWithFavorites = CheckMark(FALSE);
+	object->CH_ScanGameSubfolders = CheckMark(FALSE);
+	object->STR_ScanMaxDepth = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_ScanMaxDepth",
+		MUIA_String_Accept, "0123456789",
+		MUIA_String_MaxLen, 3,
+	End;
+	object->STR_ScanMemoryLimit = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_ScanMemoryLimit",
+		MUIA_String_Accept, "0123456789",
+		MUIA_String_MaxLen, 7,
+	End;
+	object->CH_HideDuplicates = CheckMark(FALSE);
+	object->STR_PrefetchBudget = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_PrefetchBudget",
+		MUIA_String_Accept, "0123456789",
+		MUIA_String_MaxLen, 5,
+	End;
+	object->CH_FreeMemoryOnLaunch = CheckMark(FALSE);
+	object->CH_IconifyOnLaunch = CheckMark(FALSE);
+	object->STR_StageDir = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_StageDir",
+		MUIA_String_MaxLen, 255,
+	End;
+	object->STR_StageBudget = StringObject,
+		MUIA_Frame, MUIV_Frame_String,
+		MUIA_HelpNode, "STR_StageBudget",
+		MUIA_String_Accept, "0123456789",
+		MUIA_String_MaxLen, 7,
+	End;
 	GR_Misc = GroupObject,
 		MUIA_HelpNode, "GR_Misc",
 		MUIA_Frame, MUIV_Frame_Group,
@@ -741,6 +839,24 @@ struct ObjApp *CreateApp(void)
 		Child, object->CH_HideSidepanel,
 		Child, Label(GetMBString(MSG_LA_StartWithFavorites)),//LA_StartWithFavorites,
 		Child, object->CH_StartWithFavorites,
+		Child, Label(GetMBString(MSG_LA_ScanGameSubfolders)),
+		Child, object->CH_ScanGameSubfolders,
+		Child, Label2(GetMBString(MSG_LA_ScanMaxDepth)),
+		Child, object->STR_ScanMaxDepth,
+		Child, Label2(GetMBString(MSG_LA_ScanMemoryLimit)),
+		Child, object->STR_ScanMemoryLimit,
+		Child, Label(GetMBString(MSG_LA_HideDuplicates)),
+		Child, object->CH_HideDuplicates,
+		Child, Label2(GetMBString(MSG_LA_PrefetchBudget)),
+		Child, object->STR_PrefetchBudget,
+		Child, Label(GetMBString(MSG_LA_FreeMemoryOnLaunch)),
+		Child, object->CH_FreeMemoryOnLaunch,
+		Child, Label(GetMBString(MSG_LA_IconifyOnLaunch)),
+		Child, object->CH_IconifyOnLaunch,
+		Child, Label2(GetMBString(MSG_LA_StageDir)),
+		Child, object->STR_StageDir,
+		Child, Label2(GetMBString(MSG_LA_StageBudget)),
+		Child, object->STR_StageBudget,
 	End;
 
 	object->BT_SettingsSave   = SimpleButton(GetMBString(MSG_BT_SettingsSave));
@@ -904,6 +1020,13 @@ struct ObjApp *CreateApp(void)
 		MUIM_CallHook, &GenreClickHook
 	);
 
+	DoMethod(object->BT_ScanStop,
+		MUIM_Notify, MUIA_Pressed, FALSE,
+		object->App,
+		2,
+		MUIM_CallHook, &ScanStopHook
+	);
+
 	DoMethod(object->WI_MainWindow,
 		MUIM_Window_SetCycleChain, object->STR_Filter,
 		object->LV_GamesList,
@@ -1154,6 +1277,34 @@ struct ObjApp *CreateApp(void)
 		MUIM_CallHook, &SettingStartWithFavoritesChangedHook
 	);
 
+	DoMethod(object->CH_ScanGameSubfolders,
+		MUIM_Notify, MUIA_Selected, MUIV_EveryTime,
+		object->App,
+		2,
+		MUIM_CallHook, &SettingScanGameSubfoldersChangedHook
+	);
+
+	DoMethod(object->CH_HideDuplicates,
+		MUIM_Notify, MUIA_Selected, MUIV_EveryTime,
+		object->App,
+		2,
+		MUIM_CallHook, &SettingHideDuplicatesChangedHook
+	);
+
+	DoMethod(object->CH_FreeMemoryOnLaunch,
+		MUIM_Notify, MUIA_Selected, MUIV_EveryTime,
+		object->App,
+		2,
+		MUIM_CallHook, &SettingFreeMemoryOnLaunchChangedHook
+	);
+
+	DoMethod(object->CH_IconifyOnLaunch,
+		MUIM_Notify, MUIA_Selected, MUIV_EveryTime,
+		object->App,
+		2,
+		MUIM_CallHook, &SettingIconifyOnLaunchChangedHook
+	);
+
 	DoMethod(object->BT_SettingsSave,
 		MUIM_Notify, MUIA_Pressed, FALSE,
 		object->App,
@@ -42,6 +42,7 @@ struct ObjApp
 	APTR LV_GamesList;
 	APTR LV_GenresList;
 	APTR TX_Status;
+	APTR BT_ScanStop;
 	APTR WI_Properties;
 	APTR STR_PropertiesGameTitle;
 	APTR CY_PropertiesGenre;
@@ -54,6 +55,7 @@ struct ObjApp
 	APTR BT_PropertiesCancel;
 	APTR WI_GameRepositories;
 	APTR PA_RepoPath;
+	APTR STR_RepoExcludes;
 	//APTR STR_PA_RepoPath;
 	APTR BT_AddRepo;
 	APTR LV_GameRepositories;
@@ -81,6 +83,17 @@ struct ObjApp
 	APTR CH_FilterUseEnter;
 	APTR CH_HideSidepanel;
 	APTR CH_StartWithFavorites;
+	APTR CH_ScanGameSubfolders;
+	APTR STR_ScanMaxDepth;
+	APTR STR_ScanMemoryLimit;
+	APTR CH_HideDuplicates;
+	APTR STR_PrefetchBudget;
+	APTR CH_FreeMemoryOnLaunch;
+	APTR CH_IconifyOnLaunch;
+	APTR STR_StageDir;
+	APTR STR_StageBudget;
+	APTR STR_ScreenshotCache;
+	APTR STR_ScreenshotPrefetch;
 	APTR BT_SettingsSave;
 	APTR BT_SettingsUse;
 	APTR BT_SettingsCancel;
@@ -81,7 +81,7 @@ struct Library			*GfxBase;
 struct Library			*IconBase;
 struct Library			*LocaleBase;
 struct Library			*GuiGfxMCC;
-struct Library			*GuiGfxBase;
+struct Library			*GuiGFXBase;
 struct Library			*LowLevelBase;
 struct Library			*RenderLibBase;
 struct Library			*TextEditorMCC;
@@ -168,7 +168,11 @@ int main(int argc, char **argv)
 				break;
 
 			case MENU_SCAN:
-				scan_repositories();
+				scan_repositories(0);
+				break;
+
+			case MENU_SCANFULL:
+				scan_repositories(1);
 				break;
 
 			case MENU_ADDGAME:
@@ -219,7 +223,33 @@ int main(int argc, char **argv)
 		}
 		#endif
 
-		if (running && signals) Wait(signals);
+		// The batches of a running scan arrive with a signal of their own
+		if (running && signals)
+		{
+			const ULONG scan_signals = scan_signal();
+			const ULONG launch_signals = launch_signal();
+			const ULONG stage_signals = stage_signal();
+			const ULONG task_signals = scan_signals | launch_signals | stage_signals;
+
+			// Games and screenshots are read ahead by tasks started only while no signal is waiting
+			while (prefetch_pending() && !(SetSignal(0, 0) & (signals | task_signals | screenshot_signal() | prefetch_signal())))
+				prefetch_step();
+
+			// Reading ahead may have started just now
+			const ULONG screenshot_signals = screenshot_signal();
+			const ULONG prefetch_signals = prefetch_signal();
+			const ULONG received = Wait(signals | task_signals | screenshot_signals | prefetch_signals);
+			if (received & scan_signals)
+				scan_poll();
+			if (received & launch_signals)
+				launch_poll();
+			if (received & stage_signals)
+				stage_poll();
+			if (received & screenshot_signals)
+				screenshot_poll();
+			if (received & prefetch_signals)
+				prefetch_poll();
+		}
 	}
 
 	clean_exit(NULL);
@@ -347,7 +377,7 @@ static int initLibraries(void)
 			return clean_exit("Can't open render.library v30 or greater\n");
 		}
 
-		if (!(GuiGfxBase = OpenLibrary("guigfx.library", 17)))
+		if (!(GuiGFXBase = OpenLibrary("guigfx.library", 17)))
 		{
 			return clean_exit("Can't open guigfx.library v17 or greater\n");
 		}
@@ -381,8 +411,8 @@ static void cleanupLibraries(void)
 		CloseLibrary(RenderLibBase);
 	if (GfxBase)
 		CloseLibrary(GfxBase);
-	if (GuiGfxBase)
-		CloseLibrary(GuiGfxBase);
+	if (GuiGFXBase)
+		CloseLibrary(GuiGFXBase);
 	if (GuiGfxMCC)
 		CloseLibrary(GuiGfxMCC);
 	if (DataTypesBase)
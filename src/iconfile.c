@@ -0,0 +1,326 @@
+/*
+  iconfile.c
+  Workbench icon file parser source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Reading the tooltypes with GetDiskObject() means decoding the
+ * images of the icon as well. A classic icon is a DiskObject with its
+ * pointers saved as flags, followed by the parts they point to in a
+ * fixed order, so the tooltypes can be found by skipping the rest by
+ * size. Only plain C and no calls to the OS, like slaveheader.c.
+ */
+
+/* ANSI C */
+#include <ctype.h>
+#include <string.h>
+
+#include "iconfile.h"
+
+#define ICON_MAGIC 0xE310
+#define ICON_VERSION 1
+
+/* The parts that follow the DiskObject */
+#define ICON_DRAWERDATA_SIZE 56
+#define ICON_IMAGE_SIZE 20
+
+/* Anything bigger is a broken icon */
+#define ICON_MAX_STRING 32768
+#define ICON_MAX_TOOL_TYPES 4096
+#define ICON_MAX_DEPTH 8
+
+static unsigned short get_word(const unsigned char *p)
+{
+	return (unsigned short)((p[0] << 8) | p[1]);
+}
+
+static unsigned long get_long(const unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) | ((unsigned long)p[2] << 8) | p[3];
+}
+
+static void put_long(unsigned char *p, const unsigned long value)
+{
+	p[0] = (unsigned char)(value >> 24);
+	p[1] = (unsigned char)(value >> 16);
+	p[2] = (unsigned char)(value >> 8);
+	p[3] = (unsigned char)value;
+}
+
+/*
+ * Skips an image and its planes. Returns ICON_TRUNCATED if the data
+ * ends first and ICON_UNKNOWN if the image can't be a real one. The
+ * size of the planes is checked against what is left before it is
+ * added, so a broken icon can't move the position past the data.
+ */
+static int skip_image(const unsigned char *data, const long length, long *position)
+{
+	unsigned long width, height, depth, planes, plane_size;
+
+	if (*position + ICON_IMAGE_SIZE > length)
+		return ICON_TRUNCATED;
+
+	width = get_word(data + *position + 4);
+	height = get_word(data + *position + 6);
+	depth = get_word(data + *position + 8);
+	planes = get_long(data + *position + 10);
+
+	if (depth > ICON_MAX_DEPTH)
+		return ICON_UNKNOWN;
+
+	*position += ICON_IMAGE_SIZE;
+	if (planes && depth > 0)
+	{
+		// At most 8 KB a row and 65535 rows, so a plane fits in 32 bits
+		plane_size = ((width + 15) / 16) * 2 * height;
+		if (plane_size > (unsigned long)(length - *position) / depth)
+			return ICON_TRUNCATED;
+		*position += plane_size * depth;
+	}
+
+	return ICON_OK;
+}
+
+/*
+ * Returns the position after the string at the position, with the
+ * string and its length without the terminating NUL. Returns 0 if the
+ * string doesn't fit in the data.
+ */
+long icon_string(const unsigned char *data, const long length, const long position, const char **string,
+	size_t *string_length)
+{
+	unsigned long size;
+
+	if (position + 4 > length)
+		return 0;
+
+	size = get_long(data + position);
+	if (size == 0 || size > ICON_MAX_STRING || position + 4 + (long)size > length)
+		return 0;
+
+	*string = (const char *)data + position + 4;
+	*string_length = data[position + 4 + size - 1] == '\0' ? size - 1 : size;
+
+	return position + 4 + size;
+}
+
+/* A string that can't be read even with the whole file */
+static int string_too_long(const unsigned char *data, const long length, const long position)
+{
+	if (position + 4 > length)
+		return 0;
+
+	return get_long(data + position) == 0 || get_long(data + position) > ICON_MAX_STRING;
+}
+
+/*
+ * Finds the strings of a classic icon. Returns ICON_TRUNCATED if the
+ * data ends before the tooltypes do, so more of the file is needed.
+ */
+int icon_parse(const unsigned char *data, const long length, icon_header *header)
+{
+	const char *string;
+	size_t string_length;
+	long position = ICON_DISKOBJECT_SIZE, next;
+	unsigned long count;
+	int i, result;
+
+	memset(header, 0, sizeof(icon_header));
+
+	if (length < ICON_DISKOBJECT_SIZE)
+		return length >= 2 && get_word(data) != ICON_MAGIC ? ICON_UNKNOWN : ICON_TRUNCATED;
+
+	if (get_word(data) != ICON_MAGIC || get_word(data + 2) != ICON_VERSION)
+		return ICON_UNKNOWN;
+
+	header->type = data[48];
+	header->revision = data[47];
+
+	if (get_long(data + 66))
+		position += ICON_DRAWERDATA_SIZE;
+
+	// The gadget render and select render images
+	if ((get_long(data + 22) && (result = skip_image(data, length, &position)) != ICON_OK)
+		|| (get_long(data + 26) && (result = skip_image(data, length, &position)) != ICON_OK))
+		return result;
+
+	if (get_long(data + 50))
+	{
+		header->default_tool = position;
+		if ((next = icon_string(data, length, position, &string, &string_length)) == 0)
+			return string_too_long(data, length, position) ? ICON_UNKNOWN : ICON_TRUNCATED;
+		position = next;
+	}
+
+	if (get_long(data + 54))
+	{
+		if (position + 4 > length)
+			return ICON_TRUNCATED;
+
+		// The table is saved with its size in bytes, including the NULL at the end
+		count = get_long(data + position) / 4;
+		if (count == 0 || count > ICON_MAX_TOOL_TYPES)
+			return ICON_UNKNOWN;
+
+		header->tool_types = position;
+		header->tool_types_count = (int)count - 1;
+		position += 4;
+
+		for (i = 0; i < header->tool_types_count; i++)
+		{
+			if ((next = icon_string(data, length, position, &string, &string_length)) == 0)
+				return string_too_long(data, length, position) ? ICON_UNKNOWN : ICON_TRUNCATED;
+			position = next;
+		}
+		header->tool_types_end = position;
+	}
+
+	header->end = position;
+	return ICON_OK;
+}
+
+/*
+ * Finds a tooltype by its name, ignoring the case like FindToolType().
+ * Returns 0 if the icon has no such tooltype.
+ */
+int icon_find_tool_type(const unsigned char *data, const icon_header *header, const char *name, const char **value,
+	size_t *value_length)
+{
+	const size_t name_length = strlen(name);
+	long position = header->tool_types + 4;
+	int i, j;
+
+	for (i = 0; i < header->tool_types_count; i++)
+	{
+		const char *tool_type;
+		size_t length;
+
+		position = icon_string(data, header->tool_types_end, position, &tool_type, &length);
+		if (position == 0)
+			return 0;
+
+		if (length < name_length || (length > name_length && tool_type[name_length] != '='))
+			continue;
+
+		for (j = 0; j < (int)name_length; j++)
+		{
+			if (tolower((unsigned char)tool_type[j]) != tolower((unsigned char)name[j]))
+				break;
+		}
+
+		if (j == (int)name_length)
+		{
+			*value = length > name_length ? tool_type + name_length + 1 : tool_type + length;
+			*value_length = length > name_length ? length - name_length - 1 : 0;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Like MatchToolValue(), true if the value is one of the values of a
+ * tooltype separated by '|', ignoring the case
+ */
+int icon_match_value(const char *tool_value, const size_t tool_value_length, const char *value)
+{
+	const size_t value_length = strlen(value);
+	size_t start = 0, end, i;
+
+	while (start <= tool_value_length)
+	{
+		for (end = start; end < tool_value_length && tool_value[end] != '|'; end++)
+			;
+
+		if (end - start == value_length)
+		{
+			for (i = 0; i < value_length; i++)
+			{
+				if (tolower((unsigned char)tool_value[start + i]) != tolower((unsigned char)value[i]))
+					break;
+			}
+
+			if (i == value_length)
+				return 1;
+		}
+
+		start = end + 1;
+	}
+
+	return 0;
+}
+
+/*
+ * The size of a tooltypes table in the file
+ */
+long icon_tool_types_size(const char *const *tool_types, const int count)
+{
+	long size = 4;
+	int i;
+
+	for (i = 0; i < count; i++)
+		size += 4 + (long)strlen(tool_types[i]) + 1;
+
+	return size;
+}
+
+/*
+ * Writes the icon to out with other tooltypes. Everything else, the
+ * images and whatever follows the tooltypes, is copied as it is. The
+ * parsed icon must be ICON_OK, and out must have room for its length,
+ * less its old tooltypes table, plus icon_tool_types_size(). Returns
+ * the new length.
+ */
+long icon_set_tool_types(const unsigned char *data, const long length, const icon_header *header,
+	const char *const *tool_types, const int count, unsigned char *out)
+{
+	const long start = header->tool_types ? header->tool_types : header->end;
+	const int has_table = count > 0 || header->tool_types;
+	long position = start;
+	int i;
+
+	memcpy(out, data, start);
+
+	// The pointer to the table only tells if there is one, an empty one is kept
+	if (!has_table)
+		put_long(out + 54, 0);
+	else if (get_long(data + 54) == 0)
+		put_long(out + 54, 1);
+
+	if (has_table)
+	{
+		put_long(out + position, (unsigned long)(count + 1) * 4);
+		position += 4;
+
+		for (i = 0; i < count; i++)
+		{
+			const size_t size = strlen(tool_types[i]) + 1;
+
+			put_long(out + position, size);
+			memcpy(out + position + 4, tool_types[i], size);
+			position += 4 + (long)size;
+		}
+	}
+
+	memcpy(out + position, data + header->end, length - header->end);
+
+	return position + length - header->end;
+}
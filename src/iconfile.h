@@ -0,0 +1,60 @@
+/*
+  iconfile.h
+  Workbench icon file parser header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _ICON_FILE_H
+#define _ICON_FILE_H
+
+#include <stddef.h>
+
+/* The results of icon_parse() */
+#define ICON_UNKNOWN 0     /* not a classic icon, e.g. a PNG icon */
+#define ICON_OK 1
+#define ICON_TRUNCATED 2   /* the data ends before the tooltypes */
+
+/* The DiskObject structure at the start of every classic icon */
+#define ICON_DISKOBJECT_SIZE 78
+
+/*
+ * Where the strings of a classic icon are in the file, 0 if the icon
+ * has none. The images and the drawer data are only skipped. NewIcons
+ * are kept in the tooltypes, and the OS 3.5 icons after the classic
+ * part, so they can be read as well.
+ */
+typedef struct icon_header
+{
+	unsigned char type;
+	unsigned char revision;   /* of the drawer data */
+	long default_tool;        /* string */
+	long tool_types;          /* the table of the tooltypes */
+	long tool_types_end;      /* where the table ends */
+	int tool_types_count;
+	long end;                 /* of the strings read, where the tool window would follow */
+} icon_header;
+
+int icon_parse(const unsigned char *, long, icon_header *);
+long icon_string(const unsigned char *, long, long, const char **, size_t *);
+int icon_find_tool_type(const unsigned char *, const icon_header *, const char *, const char **, size_t *);
+int icon_match_value(const char *, size_t, const char *);
+long icon_tool_types_size(const char *const *, int);
+long icon_set_tool_types(const unsigned char *, long, const icon_header *, const char *const *, int, unsigned char *);
+
+#endif
@@ -0,0 +1,147 @@
+/*
+  launchtask.c
+  Background game launch source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Runs the command of a game on a process of its own and waits for it
+ * there, so the GUI keeps working while the game runs. When the game
+ * ends, the process sends a message to the port of the task that
+ * started it, with how long the game ran.
+ */
+
+/* Prototypes */
+#if defined(__amigaos4__)
+#include <proto/exec.h>
+#include <proto/dos.h>
+#else
+#include <clib/exec_protos.h>
+#include <clib/dos_protos.h>
+#endif
+
+/* System */
+#include <dos/dostags.h>
+
+/* ANSI C */
+#include <string.h>
+
+#include "osfuncs.h"
+#include "launchtask.h"
+
+static void launch_task_run(void *data)
+{
+	launch_task *task = data;
+	const BPTR lock = Lock((CONST_STRPTR)task->dir, SHARED_LOCK);
+	const BPTR input = Open((CONST_STRPTR)"NIL:", MODE_OLDFILE);
+	const BPTR output = Open((CONST_STRPTR)"NIL:", MODE_NEWFILE);
+	const unsigned long start_time = os_milliseconds();
+	BPTR old_dir = 0;
+
+	task->result = LAUNCH_FAILED;
+	os_date_now(&task->started);
+
+	if (lock && input && output)
+	{
+		old_dir = CurrentDir(lock);
+		task->result = SystemTags((CONST_STRPTR)task->command,
+			SYS_Input, input,
+			SYS_Output, output,
+			TAG_DONE);
+		CurrentDir(old_dir);
+	}
+
+	task->milliseconds = os_milliseconds() - start_time;
+
+	if (output)
+		Close(output);
+	if (input)
+		Close(input);
+	if (lock)
+		UnLock(lock);
+
+	PutMsg(task->port, &task->done);
+}
+
+/*
+ * Starts the command of task in its folder. Returns 0 if it could not
+ * be started. Once it started, launch_task_ended() has to be called
+ * when its signal arrives, or launch_task_end() to wait for it.
+ */
+int launch_task_start(launch_task *task)
+{
+	task->result = LAUNCH_FAILED;
+	task->milliseconds = 0;
+	memset(&task->done, 0, sizeof(task->done));
+	task->done.mn_Length = sizeof(struct Message);
+
+	if ((task->port = CreateMsgPort()))
+	{
+		if ((task->thread = os_thread_start("iGame launch", launch_task_run, task)))
+			return 1;
+
+		DeleteMsgPort(task->port);
+		task->port = NULL;
+	}
+
+	return 0;
+}
+
+/*
+ * The signal the end of the game arrives with, or 0 if none is running
+ */
+ULONG launch_task_signal(const launch_task *task)
+{
+	return task->port ? 1UL << task->port->mp_SigBit : 0;
+}
+
+static void launch_task_free(launch_task *task)
+{
+	os_thread_wait(task->thread);
+	task->thread = NULL;
+
+	DeleteMsgPort(task->port);
+	task->port = NULL;
+}
+
+/*
+ * Returns 1, and lets the launch go, if the game ended
+ */
+int launch_task_ended(launch_task *task)
+{
+	if (task->port == NULL || GetMsg(task->port) == NULL)
+		return 0;
+
+	launch_task_free(task);
+	return 1;
+}
+
+/*
+ * Waits for the game to end, as iGame can't quit while the launch
+ * process still runs its code
+ */
+void launch_task_end(launch_task *task)
+{
+	if (task->port == NULL)
+		return;
+
+	WaitPort(task->port);
+	GetMsg(task->port);
+	launch_task_free(task);
+}
@@ -0,0 +1,59 @@
+/*
+  launchtask.h
+  Background game launch header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _LAUNCH_TASK_H
+#define _LAUNCH_TASK_H
+
+#include <exec/ports.h>
+
+#include "osfuncs.h"
+
+#define LAUNCH_COMMAND_SIZE 544
+#define LAUNCH_PATH_SIZE 256
+
+/* The command could not be run at all */
+#define LAUNCH_FAILED -1
+
+typedef struct launch_task
+{
+	/* filled in by the caller */
+	char command[LAUNCH_COMMAND_SIZE];
+	char dir[LAUNCH_PATH_SIZE];     /* the folder the command runs in */
+	char path[LAUNCH_PATH_SIZE];    /* of the game, to find it when it ends */
+
+	/* filled in by the launch, safe to read once it ended */
+	long result;                    /* of the command, or LAUNCH_FAILED */
+	os_date started;                /* when it started */
+	unsigned long milliseconds;     /* how long it ran */
+
+	/* private */
+	struct MsgPort *port;
+	os_thread *thread;
+	struct Message done;
+} launch_task;
+
+int launch_task_start(launch_task *);
+ULONG launch_task_signal(const launch_task *);
+int launch_task_ended(launch_task *);
+void launch_task_end(launch_task *);
+
+#endif
@@ -0,0 +1,732 @@
+/*
+  manifest.c
+  Game folder manifest source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Finding the icon of a game means opening every icon in its folder,
+ * to look for the one with the slave in its SLAVE tooltype. This is
+ * done the first time a game is launched, shown or edited, and kept
+ * with the date of the folder, which changes when a file is added,
+ * deleted or renamed in it. After that only the date is checked.
+ * The WHDLoad arguments compiled from the tooltypes of the icon are
+ * kept the same way, with the date of the icon, and so is where the
+ * screenshot of the game was found.
+ */
+
+/* Prototypes */
+#if defined(__amigaos4__)
+#include <proto/icon.h>
+#else
+#include <clib/icon_protos.h>
+#endif
+
+/* ANSI C */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osfuncs.h"
+#include "iconfile.h"
+#include "tokenizer.h"
+#include "manifest.h"
+
+#define MANIFEST_HEADER "iGame game manifests 2\n"
+
+/* Most classic icons have their tooltypes in the first few KB */
+#define ICON_READ_SIZE 4096
+#define ICON_MAX_SIZE 262144
+
+extern struct Library *IconBase;
+
+/* The manifests read so far, sorted by path */
+static game_manifest **manifests;
+static int manifests_count, manifests_size, manifests_changed;
+static const char *released_file;   /* to load them from again, after manifest_release() */
+static manifest_reader own_reader;    /* of the task that keeps the manifests */
+
+static int find_manifest(const char *path, int *found)
+{
+	int low = 0, high = manifests_count;
+
+	*found = 0;
+	while (low < high)
+	{
+		const int middle = (low + high) / 2;
+		const int compare = strcmp(manifests[middle]->path, path);
+
+		if (compare == 0)
+		{
+			*found = 1;
+			return middle;
+		}
+
+		if (compare < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+static game_manifest *insert_manifest(const int index, const char *path)
+{
+	const size_t path_size = strlen(path) + 1;
+	game_manifest *manifest;
+
+	if (manifests_count == manifests_size)
+	{
+		const int size = manifests_size ? manifests_size * 2 : 64;
+		game_manifest **grown = realloc(manifests, sizeof(game_manifest *) * size);
+		if (grown == NULL)
+			return NULL;
+
+		manifests = grown;
+		manifests_size = size;
+	}
+
+	if ((manifest = calloc(1, sizeof(game_manifest) + path_size)) == NULL)
+		return NULL;
+
+	manifest->path = (char *)(manifest + 1);
+	memcpy(manifest->path, path, path_size);
+
+	memmove(manifests + index + 1, manifests + index, sizeof(game_manifest *) * (manifests_count - index));
+	manifests[index] = manifest;
+	manifests_count++;
+
+	return manifest;
+}
+
+static int same_name(const char *a, const char *b, const size_t length)
+{
+	size_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int has_extension(const char *name, const size_t length, const char *extension)
+{
+	const size_t extension_length = strlen(extension);
+
+	return length > extension_length && same_name(name + length - extension_length, extension, extension_length);
+}
+
+/*
+ * Reads the icon file into the buffer, growing it if needed. Returns
+ * the length read, or -1.
+ */
+static long read_icon(manifest_reader *reader, const char *info, const unsigned long size)
+{
+	if (size > reader->icon_buffer_size)
+	{
+		unsigned char *grown = realloc(reader->icon_buffer, size);
+		if (grown == NULL)
+			return -1;
+
+		reader->icon_buffer = grown;
+		reader->icon_buffer_size = size;
+	}
+
+	return os_read_file(info, 0, reader->icon_buffer, size);
+}
+
+/*
+ * Looks for the slave in the SLAVE tooltype of a classic icon, without
+ * icon.library. The start of the file is read first, as the tooltypes
+ * are usually there, and the whole file only if they are further on.
+ * Returns -1 if the icon has to be read by icon.library.
+ */
+static int read_icon_slave(manifest_reader *reader, const char *info, const char *slave)
+{
+	icon_header header;
+	unsigned long size;
+	os_date date;
+	const char *value;
+	size_t value_length;
+	long length;
+	int result;
+
+	if ((length = read_icon(reader, info, ICON_READ_SIZE)) < 0)
+		return 0;
+
+	result = icon_parse(reader->icon_buffer, length, &header);
+	if (result == ICON_TRUNCATED && length == ICON_READ_SIZE
+		&& os_file_info(info, &size, &date) && size <= ICON_MAX_SIZE && (length = read_icon(reader, info, size)) >= 0)
+	{
+		result = icon_parse(reader->icon_buffer, length, &header);
+	}
+
+	if (result != ICON_OK)
+		return -1;
+
+	return icon_find_tool_type(reader->icon_buffer, &header, "SLAVE", &value, &value_length)
+		&& icon_match_value(value, value_length, slave);
+}
+
+/*
+ * The SLAVE tooltype of an icon names the slave of the game. The
+ * path of the icon is given without ".info". Icons that are not
+ * classic ones, like PNG icons, are left to icon.library.
+ */
+static int is_game_icon(manifest_reader *reader, const char *icon, const char *slave)
+{
+	char info[MANIFEST_PATH_SIZE + 5];
+	struct DiskObject *disk_obj;
+	int result;
+
+	snprintf(info, sizeof(info), "%s.info", icon);
+	if ((result = read_icon_slave(reader, info, slave)) >= 0)
+		return result;
+
+	if (IconBase == NULL || (disk_obj = GetDiskObject((STRPTR)icon)) == NULL)
+		return 0;
+
+	result = MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (STRPTR)"SLAVE"), (STRPTR)slave)
+		|| MatchToolValue(FindToolType(disk_obj->do_ToolTypes, (STRPTR)"slave"), (STRPTR)slave);
+
+	FreeDiskObject(disk_obj);
+	return result;
+}
+
+/*
+ * Lists the folder of the game once, for the files the manifest
+ * needs. Only the icons of a WHDLoad game are opened. The folder is
+ * given with its separator, as the start of the path of the game.
+ */
+static void read_folder(manifest_reader *reader, game_manifest *manifest, os_dir *dir, const char *folder,
+	const size_t folder_length, const char *file)
+{
+	const size_t file_length = strlen(file);
+	const int whdload = has_extension(file, file_length, ".slave");
+	const size_t base_length = whdload ? file_length - 6 : file_length;
+	os_entry entry;
+
+	manifest->flags = 0;
+	manifest->icon[0] = '\0';
+
+	while (os_read_entry(reader->dir_reader, dir, &entry))
+	{
+		const size_t length = strlen(entry.name);
+
+		if (entry.is_dir)
+			continue;
+
+		if (length == 9 && same_name(entry.name, "igame.iff", 9))
+			manifest->flags |= MANIFEST_IGAME_IFF;
+
+		if (!has_extension(entry.name, length, ".info"))
+			continue;
+
+		if (length == base_length + 5 && same_name(entry.name, file, base_length))
+			manifest->flags |= MANIFEST_GAME_ICON;
+
+		if (whdload && manifest->icon[0] == '\0' && folder_length + length < MANIFEST_PATH_SIZE)
+		{
+			memcpy(manifest->icon, folder, folder_length);
+			memcpy(manifest->icon + folder_length, entry.name, length - 5);
+			manifest->icon[folder_length + length - 5] = '\0';
+
+			if (!is_game_icon(reader, manifest->icon, file))
+				manifest->icon[0] = '\0';
+		}
+	}
+}
+
+static const char *file_part(const char *path)
+{
+	const char *file = path + strlen(path);
+
+	while (file > path && file[-1] != '/' && file[-1] != ':')
+		file--;
+
+	return file;
+}
+
+/*
+ * Opens the folder of the game at the path and gets its date. Returns
+ * NULL if it can't be read.
+ */
+static os_dir *open_folder(manifest_reader *reader, const char *path, os_date *date)
+{
+	char folder[MANIFEST_PATH_SIZE];
+	const char *file = file_part(path);
+	os_dir *dir;
+
+	if (file == path || (size_t)(file - path) >= sizeof(folder))
+		return NULL;
+
+	// The folder is locked without the trailing slash, which would mean its parent
+	memcpy(folder, path, file - path);
+	folder[file - path - (file[-1] == '/')] = '\0';
+
+	if (reader->dir_reader == NULL && (reader->dir_reader = os_reader_alloc()) == NULL)
+		return NULL;
+
+	if ((dir = os_open_dir(folder)) == NULL)
+		return NULL;
+
+	if (!os_dir_date(reader->dir_reader, dir, date))
+	{
+		os_close_dir(dir);
+		return NULL;
+	}
+
+	return dir;
+}
+
+/*
+ * Appends a WHDLoad argument, separated by a space. Returns 0 if the
+ * arguments don't fit.
+ */
+static int append_argument(char *arguments, size_t *length, const char *argument, const size_t argument_length)
+{
+	const size_t separator = *length ? 1 : 0;
+
+	if (*length + separator + argument_length >= MANIFEST_ARGUMENTS_SIZE)
+		return 0;
+
+	if (separator)
+		arguments[(*length)++] = ' ';
+	memcpy(arguments + *length, argument, argument_length);
+	*length += argument_length;
+	arguments[*length] = '\0';
+
+	return 1;
+}
+
+/*
+ * Compiles the tooltypes of a game icon to WHDLoad arguments, of up to
+ * MANIFEST_ARGUMENTS_SIZE. The hex values are given in decimal.
+ * Returns 0 if the arguments are too long.
+ */
+int manifest_compile_arguments(char **tool_types, char *arguments)
+{
+	char to_check[256], *tool_type;
+	size_t length = 0;
+	int result = 1;
+
+	arguments[0] = '\0';
+
+	for (; result && (tool_type = *tool_types); ++tool_types)
+	{
+		if (!strncmp(tool_type, "IM", 2)) continue;
+		if (tool_type[0] == ' ') continue;
+		if (tool_type[0] == '(') continue;
+		if (tool_type[0] == '*') continue;
+		if (tool_type[0] == ';') continue;
+		if (tool_type[0] == '\0') continue;
+		if (tool_type[0] == -69) continue; // »
+		if (tool_type[0] == -85) continue; // «
+		if (tool_type[0] == '.') continue;
+		if (tool_type[0] == '=') continue;
+		if (tool_type[0] == '#') continue;
+		if (tool_type[0] == '!') continue;
+
+		/* Must check here for numerical values */
+		/* Those (starting with $ should be transformed to dec from hex) */
+		tokenizer tok;
+		const char *key, *value;
+		size_t key_length, value_length;
+		unsigned int number = 0;
+
+		tokenizer_init(&tok, tool_type, "=");
+		tokenizer_next(&tok, &key, &key_length);
+		if (key_length == 0)
+			continue;
+
+		if (tokenizer_next(&tok, &value, &value_length) && value[0] == '$')
+		{
+			sscanf(value + 1, "%x", &number);
+			const int check_length = snprintf(to_check, sizeof(to_check), "%.*s=%d", (int)key_length, key, (int)number);
+			result = check_length < (int)sizeof(to_check)
+				&& append_argument(arguments, &length, to_check, check_length);
+		}
+		else
+		{
+			result = append_argument(arguments, &length, tool_type, strlen(tool_type));
+		}
+	}
+
+	return result;
+}
+
+/*
+ * The WHDLoad arguments from the icon the folder was read for, or none
+ * if the game has no icon. Returns 0 if they are too long.
+ */
+static int read_arguments(game_manifest *manifest, char *arguments)
+{
+	char info[MANIFEST_PATH_SIZE + 5];
+	struct DiskObject *disk_obj;
+	unsigned long size;
+	int result;
+
+	arguments[0] = '\0';
+	manifest->icon_date.seconds = 0;
+	manifest->icon_date.fraction = 0;
+
+	if (manifest->icon[0] == '\0')
+		return 1;
+
+	if (IconBase == NULL || (disk_obj = GetDiskObject((STRPTR)manifest->icon)) == NULL)
+		return 0;
+
+	result = manifest_compile_arguments((char **)disk_obj->do_ToolTypes, arguments);
+	FreeDiskObject(disk_obj);
+
+	snprintf(info, sizeof(info), "%s.info", manifest->icon);
+	return result && os_file_info(info, &size, &manifest->icon_date);
+}
+
+/*
+ * Reads the folder of the game at the path into a manifest of the
+ * caller, without keeping it, so any task can read one with a reader
+ * of its own. The path of the manifest is the one given. For a WHDLoad
+ * game, if there is room for them, the arguments are compiled as well.
+ * Returns 0 if the folder can't be read.
+ */
+int manifest_read(manifest_reader *reader, const char *path, game_manifest *manifest, char *arguments)
+{
+	const char *file = file_part(path);
+	os_dir *dir;
+
+	memset(manifest, 0, sizeof(game_manifest));
+	manifest->path = (char *)path;
+
+	if ((dir = open_folder(reader, path, &manifest->date)) == NULL)
+		return 0;
+
+	read_folder(reader, manifest, dir, path, file - path, file);
+	os_read_end(reader->dir_reader);
+	os_close_dir(dir);
+
+	if (arguments && has_extension(file, strlen(file), ".slave") && read_arguments(manifest, arguments))
+	{
+		manifest->arguments = arguments;
+		manifest->flags |= MANIFEST_ARGUMENTS;
+	}
+
+	return 1;
+}
+
+void manifest_reader_free(manifest_reader *reader)
+{
+	if (reader->dir_reader)
+		os_reader_free(reader->dir_reader);
+	free(reader->icon_buffer);
+	memset(reader, 0, sizeof(manifest_reader));
+}
+
+/*
+ * Returns the manifest of the game at the path, reading its folder
+ * only if it changed since the last time, or if asked to. Returns NULL
+ * if the folder can't be read.
+ */
+const game_manifest *manifest_get(const char *path, const int reread)
+{
+	const char *file = file_part(path);
+	game_manifest *manifest;
+	os_date date;
+	os_dir *dir;
+	int found, index;
+
+	if (released_file)
+		manifest_load(released_file);
+
+	if ((dir = open_folder(&own_reader, path, &date)) == NULL)
+		return NULL;
+
+	index = find_manifest(path, &found);
+	if (found)
+	{
+		manifest = manifests[index];
+		if (!reread && manifest->date.seconds == date.seconds && manifest->date.fraction == date.fraction)
+		{
+			os_close_dir(dir);
+			manifest->checked = 1;
+			return manifest;
+		}
+	}
+	else if ((manifest = insert_manifest(index, path)) == NULL)
+	{
+		os_close_dir(dir);
+		return NULL;
+	}
+
+	read_folder(&own_reader, manifest, dir, path, file - path, file);
+	os_read_end(own_reader.dir_reader);
+	os_close_dir(dir);
+
+	manifest->date = date;
+	manifest->checked = 1;
+	manifests_changed = 1;
+
+	return manifest;
+}
+
+/*
+ * Keeps a manifest read by manifest_read(), e.g. on another task, in
+ * place of the one of the game, unless that one is as new and already
+ * has its arguments. Returns 0 if there is no memory.
+ */
+int manifest_put(const game_manifest *read)
+{
+	const int screenshot_mask = MANIFEST_SCREENSHOT | MANIFEST_SCREENSHOT_IFF | MANIFEST_SCREENSHOT_ICON;
+	game_manifest *manifest;
+	char *arguments = NULL;
+	int found, index, same_folder = 0;
+
+	if (released_file)
+		manifest_load(released_file);
+
+	index = find_manifest(read->path, &found);
+	if (found)
+	{
+		manifest = manifests[index];
+		same_folder = manifest->date.seconds == read->date.seconds && manifest->date.fraction == read->date.fraction;
+		if (same_folder && (!(read->flags & MANIFEST_ARGUMENTS) || ((manifest->flags & MANIFEST_ARGUMENTS)
+			&& manifest->icon_date.seconds == read->icon_date.seconds
+			&& manifest->icon_date.fraction == read->icon_date.fraction)))
+		{
+			manifest->checked = 1;
+			return 1;
+		}
+	}
+	else if ((manifest = insert_manifest(index, read->path)) == NULL)
+		return 0;
+
+	if ((read->flags & MANIFEST_ARGUMENTS) && (arguments = strdup(read->arguments)) == NULL)
+		return 0;
+
+	// Where the screenshot is stays known until the folder changes
+	free(manifest->arguments);
+	manifest->arguments = arguments;
+	manifest->flags = (read->flags & ~MANIFEST_ARGUMENTS) | (same_folder ? manifest->flags & screenshot_mask : 0)
+		| (arguments ? MANIFEST_ARGUMENTS : 0);
+	manifest->date = read->date;
+	strcpy(manifest->icon, read->icon);
+	manifest->icon_date = read->icon_date;
+	manifest->checked = 1;
+	manifests_changed = 1;
+
+	return 1;
+}
+
+/*
+ * Returns the manifest of the game at the path without touching the
+ * disk, if its folder was already checked since iGame started, else
+ * NULL, and manifest_get() has to be used.
+ */
+const game_manifest *manifest_peek(const char *path)
+{
+	int found;
+	int index;
+
+	if (released_file)
+		return NULL;
+
+	index = find_manifest(path, &found);
+	if (!found || !manifests[index]->checked)
+		return NULL;
+
+	return manifests[index];
+}
+
+/*
+ * Keeps the WHDLoad arguments compiled from the icon of the game, until
+ * the icon or its folder changes. Returns 0 if the game has no manifest
+ * or there is no memory.
+ */
+int manifest_set_arguments(const char *path, const os_date *icon_date, const char *arguments)
+{
+	game_manifest *manifest;
+	char *copy;
+	int found;
+	const int index = find_manifest(path, &found);
+
+	if (!found || (copy = strdup(arguments)) == NULL)
+		return 0;
+
+	manifest = manifests[index];
+	free(manifest->arguments);
+	manifest->arguments = copy;
+	manifest->icon_date = *icon_date;
+	manifest->flags |= MANIFEST_ARGUMENTS;
+	manifests_changed = 1;
+
+	return 1;
+}
+
+/*
+ * Keeps where the screenshot of the game was found, as MANIFEST_SCREENSHOT
+ * and the bit of the file it was found in, if any, until the folder
+ * changes. Returns 0 if the game has no manifest.
+ */
+int manifest_set_screenshot(const char *path, const int screenshot)
+{
+	int found;
+	const int index = find_manifest(path, &found);
+	const int mask = MANIFEST_SCREENSHOT | MANIFEST_SCREENSHOT_IFF | MANIFEST_SCREENSHOT_ICON;
+
+	if (!found)
+		return 0;
+
+	manifests[index]->flags = (manifests[index]->flags & ~mask) | (screenshot & mask);
+	manifests_changed = 1;
+
+	return 1;
+}
+
+/*
+ * The file has three lines for every game, one with the date of its
+ * folder, the flags and the path, one with the icon, and one with the
+ * date of the icon and the WHDLoad arguments. Returns 0 if the file is
+ * missing or broken, and no manifests are kept.
+ */
+int manifest_load(const char *filename)
+{
+	char line[MANIFEST_PATH_SIZE + 64], icon[MANIFEST_PATH_SIZE + 2], arguments[MANIFEST_ARGUMENTS_SIZE + 64];
+	int result;
+	FILE *fp;
+
+	manifest_free();
+	released_file = NULL;
+
+	if ((fp = fopen(filename, "r")) == NULL)
+		return 0;
+
+	result = fgets(line, sizeof(line), fp) && !strcmp(line, MANIFEST_HEADER);
+	while (result && fgets(line, sizeof(line), fp))
+	{
+		game_manifest *manifest;
+		unsigned long seconds, fraction, icon_seconds, icon_fraction;
+		int flags, offset = 0, arguments_offset = 0, found, index;
+
+		line[strcspn(line, "\n")] = '\0';
+		if (sscanf(line, "%lu %lu %d %n", &seconds, &fraction, &flags, &offset) < 3
+			|| offset == 0 || fgets(icon, sizeof(icon), fp) == NULL || fgets(arguments, sizeof(arguments), fp) == NULL
+			|| sscanf(arguments, "%lu %lu %n", &icon_seconds, &icon_fraction, &arguments_offset) < 2
+			|| arguments_offset == 0)
+		{
+			result = 0;
+			break;
+		}
+		icon[strcspn(icon, "\n")] = '\0';
+		arguments[strcspn(arguments, "\n")] = '\0';
+
+		index = find_manifest(line + offset, &found);
+		if (found || (manifest = insert_manifest(index, line + offset)) == NULL)
+		{
+			result = 0;
+			break;
+		}
+
+		manifest->date.seconds = seconds;
+		manifest->date.fraction = fraction;
+		manifest->flags = flags & ~MANIFEST_ARGUMENTS;
+		strncpy(manifest->icon, icon, MANIFEST_PATH_SIZE - 1);
+
+		if (flags & MANIFEST_ARGUMENTS)
+		{
+			const os_date icon_date = { icon_seconds, icon_fraction };
+			manifest_set_arguments(manifest->path, &icon_date, arguments + arguments_offset);
+		}
+	}
+
+	fclose(fp);
+
+	if (!result)
+		manifest_free();
+
+	return result;
+}
+
+/*
+ * Saves the manifests if any folder was read since they were loaded
+ */
+int manifest_save(const char *filename)
+{
+	FILE *fp;
+	int i;
+
+	if (!manifests_changed)
+		return 1;
+
+	if ((fp = fopen(filename, "w")) == NULL)
+		return 0;
+
+	fputs(MANIFEST_HEADER, fp);
+	for (i = 0; i < manifests_count; i++)
+	{
+		const game_manifest *manifest = manifests[i];
+
+		const int has_arguments = manifest->flags & MANIFEST_ARGUMENTS;
+
+		fprintf(fp, "%lu %lu %d %s\n%s\n%lu %lu %s\n", manifest->date.seconds, manifest->date.fraction,
+			manifest->flags, manifest->path, manifest->icon,
+			has_arguments ? manifest->icon_date.seconds : 0, has_arguments ? manifest->icon_date.fraction : 0,
+			has_arguments ? manifest->arguments : "");
+	}
+
+	if (fclose(fp))
+		return 0;
+
+	manifests_changed = 0;
+	return 1;
+}
+
+/*
+ * Saves the manifests and frees them, along with the buffers, to give
+ * their memory to a game. They are loaded again from the file the next
+ * time one is needed.
+ */
+void manifest_release(const char *filename)
+{
+	manifest_save(filename);
+	manifest_free();
+	released_file = filename;
+}
+
+void manifest_free(void)
+{
+	int i;
+
+	for (i = 0; i < manifests_count; i++)
+	{
+		free(manifests[i]->arguments);
+		free(manifests[i]);
+	}
+	free(manifests);
+	manifests = NULL;
+	manifests_count = 0;
+	manifests_size = 0;
+	manifests_changed = 0;
+
+	manifest_reader_free(&own_reader);
+}
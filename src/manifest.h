@@ -0,0 +1,77 @@
+/*
+  manifest.h
+  Game folder manifest header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _MANIFEST_H
+#define _MANIFEST_H
+
+#include "osfuncs.h"
+
+#define MANIFEST_PATH_SIZE 256
+#define MANIFEST_ARGUMENTS_SIZE 512
+
+/* The files found in the folder of a game */
+#define MANIFEST_IGAME_IFF 1   /* igame.iff */
+#define MANIFEST_GAME_ICON 2   /* an icon with the name of the slave or the executable */
+#define MANIFEST_ARGUMENTS 4   /* the WHDLoad arguments were compiled from the icon */
+
+/* Where the screenshot of the game was found, kept until the folder changes */
+#define MANIFEST_SCREENSHOT 8         /* it was looked for, none of the below means the default one */
+#define MANIFEST_SCREENSHOT_IFF 16    /* igame.iff is an image */
+#define MANIFEST_SCREENSHOT_ICON 32   /* the icon of the slave is an image */
+
+/*
+ * What iGame needs from the folder of a game, read once and used
+ * until the date of the folder changes
+ */
+typedef struct game_manifest
+{
+	char *path;                     /* of the slave or the executable */
+	os_date date;                   /* of the folder when it was read */
+	int flags;
+	char icon[MANIFEST_PATH_SIZE];  /* the project icon with the slave in its SLAVE tooltype, without ".info" */
+	os_date icon_date;              /* of the icon when the arguments were compiled */
+	char *arguments;                /* for WHDLoad, from the tooltypes of the icon */
+	int checked;                    /* the date was checked since iGame started, not saved */
+} game_manifest;
+
+/* What reading a folder needs, one for every task that reads them */
+typedef struct manifest_reader
+{
+	os_dir_reader *dir_reader;
+	unsigned char *icon_buffer;
+	unsigned long icon_buffer_size;
+} manifest_reader;
+
+int manifest_load(const char *);
+int manifest_save(const char *);
+void manifest_free(void);
+void manifest_release(const char *);
+const game_manifest *manifest_get(const char *, int);
+const game_manifest *manifest_peek(const char *);
+int manifest_set_arguments(const char *, const os_date *, const char *);
+int manifest_set_screenshot(const char *, int);
+int manifest_read(manifest_reader *, const char *, game_manifest *, char *);
+void manifest_reader_free(manifest_reader *);
+int manifest_put(const game_manifest *);
+int manifest_compile_arguments(char **, char *);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+  osfuncs.h
+  Operating system abstraction header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The few filesystem and process calls the scanner needs. iGame links
+ * osfuncs_amiga.c, the host tools link osfuncs_posix.c, so the same
+ * scanner code runs on both.
+ */
+
+#ifndef _OS_FUNCS_H
+#define _OS_FUNCS_H
+
+#include <stddef.h>
+
+#define OS_NAME_SIZE 108
+
+typedef struct os_dir os_dir;
+typedef struct os_dir_reader os_dir_reader;
+typedef struct os_thread os_thread;
+typedef struct os_pattern os_pattern;
+typedef struct os_file os_file;
+typedef struct os_picture os_picture;
+
+/* when a file or a directory was last changed */
+typedef struct os_date
+{
+	unsigned long seconds;
+	unsigned long fraction;
+} os_date;
+
+/* how os_open_file() opens a file */
+#define OS_FILE_READ 0
+#define OS_FILE_WRITE 1    /* a new one, or the old one emptied */
+#define OS_FILE_UPDATE 2   /* to read and write it, created if missing */
+
+typedef struct os_entry
+{
+	char name[OS_NAME_SIZE];
+	int is_dir;
+} os_entry;
+
+void *os_alloc(size_t);
+void os_free(void *);
+os_dir *os_open_dir(const char *);
+os_dir *os_open_subdir(os_dir *, const char *);
+void os_close_dir(os_dir *);
+os_dir_reader *os_reader_alloc(void);
+int os_read_entry(os_dir_reader *, const os_dir *, os_entry *);
+void os_read_end(os_dir_reader *);
+int os_dir_date(os_dir_reader *, const os_dir *, os_date *);
+void os_reader_free(os_dir_reader *);
+int os_file_info(const char *, unsigned long *, os_date *);
+long os_read_file(const char *, unsigned long, void *, unsigned long);
+int os_replace_file(const char *, const void *, unsigned long);
+os_file *os_open_file(const char *, int);
+long os_read(os_file *, void *, unsigned long);
+long os_write(os_file *, const void *, unsigned long);
+int os_seek(os_file *, unsigned long);
+int os_close_file(os_file *);
+int os_make_dir(const char *);
+int os_delete(const char *);
+int os_rename(const char *, const char *);
+os_picture *os_open_picture(const char *, int *, int *);
+int os_read_picture_row(os_picture *, int, unsigned char *);
+void os_close_picture(os_picture *);
+int os_canonical_path(const char *, char *, size_t);
+os_pattern *os_pattern_compile(const char *, size_t);
+int os_pattern_match(const os_pattern *, const char *);
+void os_pattern_free(os_pattern *);
+int os_device_key(const char *, char *, size_t);
+os_thread *os_thread_start(const char *, void (*)(void *), void *);
+void os_thread_wait(os_thread *);
+unsigned long os_milliseconds(void);
+void os_date_now(os_date *);
+
+#endif
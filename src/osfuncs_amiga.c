@@ -0,0 +1,723 @@
+/*
+  osfuncs_amiga.c
+  Operating system abstraction source for iGame on AmigaOS
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Prototypes */
+#include <clib/alib_protos.h>
+#include <proto/datatypes.h>
+
+#if defined(__amigaos4__)
+#include <proto/exec.h>
+#include <proto/dos.h>
+#else
+#include <clib/exec_protos.h>
+#include <clib/dos_protos.h>
+#endif
+
+/* System */
+#include <exec/memory.h>
+#include <dos/dosextens.h>
+#include <dos/dostags.h>
+#include <dos/exall.h>
+#include <dos/filehandler.h>
+#include <datatypes/pictureclass.h>
+
+/* ANSI C */
+#include <stdio.h>
+#include <string.h>
+
+#include "osfuncs.h"
+
+#define THREAD_STACK_SIZE 32768
+
+/*
+ * A directory is read with ExAll(), in batches of as many entries as
+ * fit in the buffer, asking only for the names and the types
+ */
+#define EXALL_BUFFER_SIZE 8192
+
+/* The files os_replace_file() writes and moves the old file to, of the same length */
+#define REPLACE_TEMP_NAME "iGame.tmp"
+#define REPLACE_BACKUP_NAME "iGame.old"
+
+struct os_dir
+{
+	BPTR lock;
+};
+
+/*
+ * One reader is shared by all the directories a scanner process opens,
+ * so the buffers are allocated once and not for every directory level
+ */
+struct os_dir_reader
+{
+	// These two come first, so they are longword aligned
+	struct FileInfoBlock fib;
+	LONG buffer[EXALL_BUFFER_SIZE / sizeof(LONG)];
+	struct ExAllControl *control;
+	struct ExAllData *next;
+	const os_dir *dir;
+	int more;
+};
+
+struct os_pattern
+{
+	char *parsed;
+	char source[1];
+};
+
+struct os_file
+{
+	BPTR handle;
+};
+
+struct os_picture
+{
+	Object *object;
+	int width;
+};
+
+struct os_thread
+{
+	struct Message message;
+	void (*entry)(void *);
+	void *data;
+};
+
+/*
+ * Allocates cleared memory. Unlike malloc() this is safe to call
+ * from the scanner processes.
+ */
+void *os_alloc(size_t size)
+{
+#if defined(__amigaos4__)
+	return AllocVecTags(size, AVT_ClearWithValue, 0, TAG_DONE);
+#else
+	return AllocVec(size, MEMF_ANY | MEMF_CLEAR);
+#endif
+}
+
+void os_free(void *memory)
+{
+	if (memory)
+		FreeVec(memory);
+}
+
+static os_dir *open_dir_lock(const BPTR lock)
+{
+	os_dir *dir;
+
+	if (!lock)
+		return NULL;
+
+	dir = os_alloc(sizeof(os_dir));
+	if (dir)
+	{
+		dir->lock = lock;
+		return dir;
+	}
+
+	UnLock(lock);
+	return NULL;
+}
+
+os_dir *os_open_dir(const char *path)
+{
+	return open_dir_lock(Lock((CONST_STRPTR)path, SHARED_LOCK));
+}
+
+/*
+ * Opens a directory by its name in the parent directory. The lock is
+ * asked from the handler relative to the parent lock, so the path is
+ * not parsed again from the volume root for every directory. What the
+ * handler can't give by itself, like a soft link, is left to Lock(),
+ * relative to the parent as the current directory.
+ */
+os_dir *os_open_subdir(os_dir *parent, const char *name)
+{
+	LONG bstr[(OS_NAME_SIZE + 1 + sizeof(LONG) - 1) / sizeof(LONG)];
+	UBYTE *bname = (UBYTE *)bstr;
+	const size_t length = strlen(name);
+	const struct FileLock *parent_lock = BADDR(parent->lock);
+	BPTR lock, old_dir;
+
+	bname[0] = length;
+	memcpy(bname + 1, name, length);
+
+	lock = (BPTR)DoPkt(
+#if defined(__amigaos4__)
+		parent_lock->fl_Port,
+#else
+		parent_lock->fl_Task,
+#endif
+		ACTION_LOCATE_OBJECT, parent->lock, MKBADDR(bname), SHARED_LOCK, 0, 0);
+
+	if (!lock)
+	{
+		old_dir = CurrentDir(parent->lock);
+		lock = Lock((CONST_STRPTR)name, SHARED_LOCK);
+		CurrentDir(old_dir);
+	}
+
+	return open_dir_lock(lock);
+}
+
+void os_close_dir(os_dir *dir)
+{
+	UnLock(dir->lock);
+	os_free(dir);
+}
+
+os_dir_reader *os_reader_alloc(void)
+{
+	os_dir_reader *reader = os_alloc(sizeof(os_dir_reader));
+
+	if (reader == NULL)
+		return NULL;
+
+	reader->control = AllocDosObject(DOS_EXALLCONTROL, NULL);
+	if (reader->control)
+		return reader;
+
+	os_free(reader);
+	return NULL;
+}
+
+/*
+ * Returns the next entry of the directory. Only one directory can be
+ * read at a time, asking for another one ends the previous reading.
+ */
+int os_read_entry(os_dir_reader *reader, const os_dir *dir, os_entry *entry)
+{
+	if (reader->dir != dir)
+	{
+		os_read_end(reader);
+		reader->dir = dir;
+		reader->control->eac_LastKey = 0;
+		reader->more = 1;
+	}
+
+	while (reader->next == NULL)
+	{
+		if (!reader->more)
+			return 0;
+
+		reader->more = ExAll(dir->lock, (struct ExAllData *)reader->buffer, sizeof(reader->buffer), ED_TYPE, reader->control);
+		if (reader->control->eac_Entries > 0)
+			reader->next = (struct ExAllData *)reader->buffer;
+	}
+
+	strncpy(entry->name, (const char *)reader->next->ed_Name, OS_NAME_SIZE - 1);
+	entry->name[OS_NAME_SIZE - 1] = '\0';
+	entry->is_dir = reader->next->ed_Type > 0;
+	reader->next = reader->next->ed_Next;
+
+	return 1;
+}
+
+void os_read_end(os_dir_reader *reader)
+{
+	// ExAll() has to be told if it was not run to the end
+	if (reader->dir && reader->more)
+		ExAllEnd(reader->dir->lock, (struct ExAllData *)reader->buffer, sizeof(reader->buffer), ED_TYPE, reader->control);
+
+	reader->dir = NULL;
+	reader->next = NULL;
+	reader->more = 0;
+}
+
+static void date_from_stamp(const struct DateStamp *stamp, os_date *date)
+{
+	date->seconds = ((unsigned long)stamp->ds_Days * 24 * 60 + stamp->ds_Minute) * 60 + stamp->ds_Tick / TICKS_PER_SECOND;
+	date->fraction = stamp->ds_Tick % TICKS_PER_SECOND;
+}
+
+/*
+ * The date of a directory changes when an entry is added to it,
+ * deleted or renamed, but not when something deeper changes
+ */
+int os_dir_date(os_dir_reader *reader, const os_dir *dir, os_date *date)
+{
+	if (!Examine(dir->lock, &reader->fib))
+		return 0;
+
+	date_from_stamp(&reader->fib.fib_Date, date);
+	return 1;
+}
+
+void os_reader_free(os_dir_reader *reader)
+{
+	if (reader == NULL)
+		return;
+
+	os_read_end(reader);
+	FreeDosObject(DOS_EXALLCONTROL, reader->control);
+	os_free(reader);
+}
+
+/*
+ * Gets the size and the date of a file without opening it
+ */
+int os_file_info(const char *path, unsigned long *size, os_date *date)
+{
+	int result = 0;
+	struct FileInfoBlock *fib;
+	const BPTR lock = Lock((CONST_STRPTR)path, SHARED_LOCK);
+
+	if (!lock)
+		return 0;
+
+	if ((fib = AllocDosObject(DOS_FIB, NULL)))
+	{
+		if (Examine(lock, fib) && fib->fib_DirEntryType < 0)
+		{
+			*size = fib->fib_Size;
+			date_from_stamp(&fib->fib_Date, date);
+			result = 1;
+		}
+		FreeDosObject(DOS_FIB, fib);
+	}
+	UnLock(lock);
+
+	return result;
+}
+
+/*
+ * Reads up to size bytes from offset in a file with a single Read().
+ * Returns the number of bytes read, or -1 on error.
+ */
+long os_read_file(const char *path, unsigned long offset, void *buffer, unsigned long size)
+{
+	long result = -1;
+	const BPTR file = Open((CONST_STRPTR)path, MODE_OLDFILE);
+
+	if (!file)
+		return -1;
+
+	if (offset == 0 || Seek(file, offset, OFFSET_BEGINNING) != -1)
+		result = Read(file, buffer, size);
+	Close(file);
+
+	return result;
+}
+
+/*
+ * Replaces a file with new contents, written to a file next to it
+ * first, so a failed write leaves the file as it was. Rename() can't
+ * replace a file, so the old one is renamed out of the way first, and
+ * deleted only once the new one took its place. If that fails, the
+ * old one is put back. The new file keeps the protection bits of the
+ * old one. The two files have short names of their own, as a name
+ * longer than the one of the file may not fit on OFS and FFS. Returns
+ * 0 if the file could not be replaced.
+ */
+int os_replace_file(const char *path, const void *buffer, unsigned long size)
+{
+	const size_t folder_length = (const char *)PathPart((CONST_STRPTR)path) - path;
+	const size_t name_size = folder_length + sizeof(REPLACE_TEMP_NAME) + 1;
+	char *temp = os_alloc(name_size * 2);
+	char *backup = temp + name_size;
+	struct FileInfoBlock *fib;
+	LONG protection = -1;
+	BPTR file, lock;
+	int result;
+
+	if (temp == NULL)
+		return 0;
+
+	// In the folder of the file, so they can be renamed to it
+	memcpy(temp, path, folder_length);
+	memcpy(backup, path, folder_length);
+	AddPart((STRPTR)temp, (CONST_STRPTR)REPLACE_TEMP_NAME, name_size);
+	AddPart((STRPTR)backup, (CONST_STRPTR)REPLACE_BACKUP_NAME, name_size);
+	if (!(file = Open((CONST_STRPTR)temp, MODE_NEWFILE)))
+	{
+		os_free(temp);
+		return 0;
+	}
+	result = Write(file, (APTR)buffer, size) == (LONG)size;
+	if (!Close(file))
+		result = 0;
+
+	if (result && (lock = Lock((CONST_STRPTR)path, SHARED_LOCK)))
+	{
+		if ((fib = AllocDosObject(DOS_FIB, NULL)))
+		{
+			if (Examine(lock, fib))
+				protection = fib->fib_Protection;
+			FreeDosObject(DOS_FIB, fib);
+		}
+		UnLock(lock);
+	}
+
+	// A backup left by an earlier failure goes first
+	if (result)
+	{
+		DeleteFile((CONST_STRPTR)backup);
+		result = Rename((CONST_STRPTR)path, (CONST_STRPTR)backup) != 0;
+	}
+
+	if (result && !Rename((CONST_STRPTR)temp, (CONST_STRPTR)path))
+	{
+		Rename((CONST_STRPTR)backup, (CONST_STRPTR)path);
+		result = 0;
+	}
+
+	if (result)
+	{
+		DeleteFile((CONST_STRPTR)backup);
+		if (protection != -1)
+			SetProtection((CONST_STRPTR)path, protection);
+	}
+	else
+		DeleteFile((CONST_STRPTR)temp);
+
+	os_free(temp);
+	return result;
+}
+
+/*
+ * Opens a file as the mode says, for copying files in big blocks with
+ * os_read() and os_write(). These go straight to the handler, without
+ * the buffering of the dos.library.
+ */
+os_file *os_open_file(const char *path, const int mode)
+{
+	os_file *file = os_alloc(sizeof(os_file));
+
+	if (file == NULL)
+		return NULL;
+
+	file->handle = Open((CONST_STRPTR)path,
+		mode == OS_FILE_UPDATE ? MODE_READWRITE : mode == OS_FILE_WRITE ? MODE_NEWFILE : MODE_OLDFILE);
+	if (file->handle)
+		return file;
+
+	os_free(file);
+	return NULL;
+}
+
+/*
+ * Returns the number of bytes read, 0 at the end of the file, or -1
+ */
+long os_read(os_file *file, void *buffer, unsigned long size)
+{
+	return Read(file->handle, buffer, size);
+}
+
+long os_write(os_file *file, const void *buffer, unsigned long size)
+{
+	return Write(file->handle, (APTR)buffer, size);
+}
+
+/*
+ * Moves to the offset from the start of the file. Returns 0 on error.
+ */
+int os_seek(os_file *file, unsigned long offset)
+{
+	return Seek(file->handle, offset, OFFSET_BEGINNING) != -1;
+}
+
+/*
+ * Returns 0 if the last writes failed
+ */
+int os_close_file(os_file *file)
+{
+	const int result = Close(file->handle) != 0;
+
+	os_free(file);
+	return result;
+}
+
+/*
+ * Creates a directory. Returns 1 if it was created or already exists.
+ */
+int os_make_dir(const char *path)
+{
+	struct FileInfoBlock *fib;
+	int result = 0;
+	BPTR lock = CreateDir((CONST_STRPTR)path);
+
+	if (lock)
+	{
+		UnLock(lock);
+		return 1;
+	}
+
+	if ((lock = Lock((CONST_STRPTR)path, SHARED_LOCK)))
+	{
+		if ((fib = AllocDosObject(DOS_FIB, NULL)))
+		{
+			result = Examine(lock, fib) && fib->fib_DirEntryType > 0;
+			FreeDosObject(DOS_FIB, fib);
+		}
+		UnLock(lock);
+	}
+
+	return result;
+}
+
+/*
+ * Deletes a file or an empty directory
+ */
+int os_delete(const char *path)
+{
+	return DeleteFile((CONST_STRPTR)path) != 0;
+}
+
+/*
+ * Renames a file, which has to stay on the same volume
+ */
+int os_rename(const char *from, const char *to)
+{
+	return Rename((CONST_STRPTR)from, (CONST_STRPTR)to) != 0;
+}
+
+/*
+ * Opens a picture with the datatypes, to read its pixels row by row.
+ * Reading the pixels needs the V43 picture.datatype or later.
+ */
+os_picture *os_open_picture(const char *path, int *width, int *height)
+{
+	struct BitMapHeader *header = NULL;
+	os_picture *picture = os_alloc(sizeof(os_picture));
+
+	if (picture == NULL)
+		return NULL;
+
+	picture->object = NewDTObject((APTR)path,
+		DTA_GroupID, GID_PICTURE,
+		PDTA_DestMode, PMODE_V43,
+		PDTA_Remap, FALSE,
+		TAG_DONE);
+
+	if (picture->object && GetDTAttrs(picture->object, PDTA_BitMapHeader, (ULONG)&header, TAG_DONE)
+		&& header && header->bmh_Width > 0 && header->bmh_Height > 0)
+	{
+		*width = picture->width = header->bmh_Width;
+		*height = header->bmh_Height;
+		return picture;
+	}
+
+	os_close_picture(picture);
+	return NULL;
+}
+
+/*
+ * Reads a row of the picture, as alpha, red, green and blue for every pixel
+ */
+int os_read_picture_row(os_picture *picture, int y, unsigned char *argb)
+{
+	return DoMethod(picture->object, PDTM_READPIXELARRAY, (ULONG)argb, PBPAFMT_ARGB, picture->width * 4,
+		0, y, picture->width, 1) != 0;
+}
+
+void os_close_picture(os_picture *picture)
+{
+	if (picture->object)
+		DisposeDTObject(picture->object);
+	os_free(picture);
+}
+
+/*
+ * Resolves a path to the form NameFromLock() gives,
+ * e.g. "DH1:Games" becomes "Work:Games"
+ */
+int os_canonical_path(const char *path, char *canonical, size_t size)
+{
+	int result = 0;
+	const BPTR lock = Lock((CONST_STRPTR)path, SHARED_LOCK);
+
+	if (lock)
+	{
+		result = NameFromLock(lock, (STRPTR)canonical, size) != 0;
+		UnLock(lock);
+	}
+
+	return result;
+}
+
+/*
+ * Compiles an AmigaDOS pattern, e.g. "#?/data", for case insensitive
+ * matching. The pattern does not have to be null-terminated.
+ */
+os_pattern *os_pattern_compile(const char *source, size_t length)
+{
+	const size_t parsed_size = length * 2 + 2;
+	os_pattern *pattern = os_alloc(sizeof(os_pattern) + length + parsed_size);
+	if (pattern == NULL)
+		return NULL;
+
+	memcpy(pattern->source, source, length);
+	pattern->source[length] = '\0';
+	pattern->parsed = pattern->source + length + 1;
+
+	if (ParsePatternNoCase((CONST_STRPTR)pattern->source, (STRPTR)pattern->parsed, parsed_size) < 0)
+	{
+		os_free(pattern);
+		return NULL;
+	}
+
+	return pattern;
+}
+
+int os_pattern_match(const os_pattern *pattern, const char *name)
+{
+	return MatchPatternNoCase((CONST_STRPTR)pattern->parsed, (STRPTR)name) != 0;
+}
+
+void os_pattern_free(os_pattern *pattern)
+{
+	os_free(pattern);
+}
+
+/*
+ * Builds a key that is the same for all the paths on the same physical
+ * drive, e.g. "scsi.device/0". Partitions of the same drive share the
+ * key, so they get scanned one after the other instead of in parallel.
+ * Handlers that are not backed by a trackdisk-like device get a key
+ * of their own.
+ */
+int os_device_key(const char *path, char *key, size_t size)
+{
+	struct MsgPort *port;
+	struct DosList *dol;
+
+	const BPTR lock = Lock((CONST_STRPTR)path, SHARED_LOCK);
+	if (!lock)
+		return 0;
+
+#if defined(__amigaos4__)
+	port = ((struct FileLock *)BADDR(lock))->fl_Port;
+#else
+	port = ((struct FileLock *)BADDR(lock))->fl_Task;
+#endif
+	UnLock(lock);
+
+	snprintf(key, size, "%08lx", (unsigned long)port);
+
+	dol = LockDosList(LDF_DEVICES | LDF_READ);
+	while ((dol = NextDosEntry(dol, LDF_DEVICES)))
+	{
+#if defined(__amigaos4__)
+		if (dol->dol_Port != port)
+#else
+		if (dol->dol_Task != port)
+#endif
+			continue;
+
+		// dol_Startup may also be a plain number, e.g. for RAM:
+		const ULONG startup = (ULONG)dol->dol_misc.dol_handler.dol_Startup;
+		const struct FileSysStartupMsg *fssm = BADDR(startup);
+		if (startup > 1024 && TypeOfMem((APTR)fssm) && TypeOfMem(BADDR(fssm->fssm_Device)))
+		{
+			const UBYTE *device = BADDR(fssm->fssm_Device);
+			snprintf(key, size, "%.*s/%lu", (int)device[0], (const char *)device + 1, (unsigned long)fssm->fssm_Unit);
+		}
+		break;
+	}
+	UnLockDosList(LDF_DEVICES | LDF_READ);
+
+	return 1;
+}
+
+static void thread_entry(void)
+{
+	struct Process *process = (struct Process *)FindTask(NULL);
+	os_thread *thread;
+
+	WaitPort(&process->pr_MsgPort);
+	thread = (os_thread *)GetMsg(&process->pr_MsgPort);
+
+	thread->entry(thread->data);
+
+	// Reply in Forbid(), so that the process is gone before the parent
+	// wakes up and maybe unloads the code
+	Forbid();
+	ReplyMsg(&thread->message);
+}
+
+/*
+ * Runs entry(data) on a new DOS process, with the priority of the
+ * task that starts it. Only that task may wait for the thread.
+ */
+os_thread *os_thread_start(const char *name, void (*entry)(void *), void *data)
+{
+	os_thread *thread = os_alloc(sizeof(os_thread));
+	if (thread == NULL)
+		return NULL;
+
+	thread->message.mn_ReplyPort = CreateMsgPort();
+	thread->message.mn_Length = sizeof(os_thread);
+	thread->entry = entry;
+	thread->data = data;
+
+	if (thread->message.mn_ReplyPort)
+	{
+		struct Process *process = CreateNewProcTags(
+			NP_Entry, (ULONG)thread_entry,
+			NP_Name, (ULONG)name,
+			NP_StackSize, THREAD_STACK_SIZE,
+			NP_Priority, FindTask(NULL)->tc_Node.ln_Pri,
+#if defined(__MORPHOS__)
+			NP_CodeType, CODETYPE_PPC,
+#endif
+			TAG_DONE);
+
+		if (process)
+		{
+			PutMsg(&process->pr_MsgPort, &thread->message);
+			return thread;
+		}
+
+		DeleteMsgPort(thread->message.mn_ReplyPort);
+	}
+
+	os_free(thread);
+	return NULL;
+}
+
+void os_thread_wait(os_thread *thread)
+{
+	WaitPort(thread->message.mn_ReplyPort);
+	GetMsg(thread->message.mn_ReplyPort);
+	DeleteMsgPort(thread->message.mn_ReplyPort);
+	os_free(thread);
+}
+
+unsigned long os_milliseconds(void)
+{
+	struct DateStamp now;
+
+	DateStamp(&now);
+	return ((unsigned long)now.ds_Days * 24 * 60 + now.ds_Minute) * 60 * 1000 + now.ds_Tick * (1000 / TICKS_PER_SECOND);
+}
+
+/*
+ * The date now, as the dates of the files are given
+ */
+void os_date_now(os_date *date)
+{
+	struct DateStamp now;
+
+	DateStamp(&now);
+	date_from_stamp(&now, date);
+}
@@ -0,0 +1,663 @@
+/*
+  osfuncs_posix.c
+  Operating system abstraction source for building iGame parts on POSIX hosts
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * This is not part of the iGame executable. It lets the host tools in
+ * helper_tools/ run the scanner over a directory tree with pthreads.
+ */
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "osfuncs.h"
+
+struct os_dir
+{
+	int fd;
+};
+
+struct os_dir_reader
+{
+	DIR *stream;
+	const os_dir *dir;
+};
+
+struct os_pattern
+{
+	const char *end;
+	char source[1];
+};
+
+struct os_file
+{
+	int fd;
+};
+
+struct os_picture
+{
+	FILE *fp;
+	long data;
+	int width;
+	unsigned char *row;
+};
+
+struct os_thread
+{
+	pthread_t thread;
+	void (*entry)(void *);
+	void *data;
+};
+
+void *os_alloc(size_t size)
+{
+	return calloc(1, size);
+}
+
+void os_free(void *memory)
+{
+	free(memory);
+}
+
+static os_dir *open_dir_fd(const int fd)
+{
+	os_dir *dir;
+
+	if (fd < 0)
+		return NULL;
+
+	dir = os_alloc(sizeof(os_dir));
+	if (dir)
+	{
+		dir->fd = fd;
+		return dir;
+	}
+
+	close(fd);
+	return NULL;
+}
+
+os_dir *os_open_dir(const char *path)
+{
+	return open_dir_fd(open(path, O_RDONLY | O_DIRECTORY));
+}
+
+os_dir *os_open_subdir(os_dir *parent, const char *name)
+{
+	return open_dir_fd(openat(parent->fd, name, O_RDONLY | O_DIRECTORY));
+}
+
+void os_close_dir(os_dir *dir)
+{
+	close(dir->fd);
+	os_free(dir);
+}
+
+os_dir_reader *os_reader_alloc(void)
+{
+	return os_alloc(sizeof(os_dir_reader));
+}
+
+/*
+ * The stream gets its own descriptor, so reading does not move the
+ * offset of the one the subdirectories are opened from
+ */
+int os_read_entry(os_dir_reader *reader, const os_dir *dir, os_entry *entry)
+{
+	struct dirent *dirent;
+	size_t length;
+
+	if (reader->dir != dir)
+	{
+		int fd;
+
+		os_read_end(reader);
+		reader->dir = dir;
+		fd = openat(dir->fd, ".", O_RDONLY | O_DIRECTORY);
+		if (fd >= 0 && (reader->stream = fdopendir(fd)) == NULL)
+			close(fd);
+	}
+
+	if (reader->stream == NULL)
+		return 0;
+
+	// Names too long for AmigaDOS are skipped, cut short they would name another file
+	do
+	{
+		if ((dirent = readdir(reader->stream)) == NULL)
+			return 0;
+		length = strlen(dirent->d_name);
+	}
+	while (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, "..") || length >= sizeof(entry->name));
+
+	memcpy(entry->name, dirent->d_name, length + 1);
+
+	if (dirent->d_type == DT_UNKNOWN)
+	{
+		struct stat st;
+		entry->is_dir = !fstatat(dir->fd, dirent->d_name, &st, 0) && S_ISDIR(st.st_mode);
+	}
+	else
+	{
+		entry->is_dir = dirent->d_type == DT_DIR;
+	}
+
+	return 1;
+}
+
+void os_read_end(os_dir_reader *reader)
+{
+	if (reader->stream)
+		closedir(reader->stream);
+
+	reader->stream = NULL;
+	reader->dir = NULL;
+}
+
+int os_dir_date(os_dir_reader *reader, const os_dir *dir, os_date *date)
+{
+	struct stat st;
+
+	(void)reader;
+	if (fstat(dir->fd, &st))
+		return 0;
+
+	date->seconds = st.st_mtim.tv_sec;
+	date->fraction = st.st_mtim.tv_nsec;
+
+	return 1;
+}
+
+void os_reader_free(os_dir_reader *reader)
+{
+	if (reader == NULL)
+		return;
+
+	os_read_end(reader);
+	os_free(reader);
+}
+
+int os_file_info(const char *path, unsigned long *size, os_date *date)
+{
+	struct stat st;
+
+	if (stat(path, &st) || !S_ISREG(st.st_mode))
+		return 0;
+
+	*size = st.st_size;
+	date->seconds = st.st_mtim.tv_sec;
+	date->fraction = st.st_mtim.tv_nsec;
+
+	return 1;
+}
+
+long os_read_file(const char *path, unsigned long offset, void *buffer, unsigned long size)
+{
+	long result = -1;
+	FILE *fp = fopen(path, "rb");
+
+	if (fp == NULL)
+		return -1;
+
+	if (fseek(fp, offset, SEEK_SET) == 0)
+		result = fread(buffer, 1, size, fp);
+	fclose(fp);
+
+	return result;
+}
+
+int os_replace_file(const char *path, const void *buffer, unsigned long size)
+{
+	const size_t path_length = strlen(path);
+	char *temp = malloc(path_length + 8);
+	FILE *fp;
+	int result;
+
+	if (temp == NULL)
+		return 0;
+
+	sprintf(temp, "%s.igtmp", path);
+	if ((fp = fopen(temp, "wb")) == NULL)
+	{
+		free(temp);
+		return 0;
+	}
+	result = fwrite(buffer, 1, size, fp) == size;
+	result = !fclose(fp) && result && !rename(temp, path);
+	if (!result)
+		remove(temp);
+
+	free(temp);
+	return result;
+}
+
+os_file *os_open_file(const char *path, const int mode)
+{
+	os_file *file = os_alloc(sizeof(os_file));
+
+	if (file == NULL)
+		return NULL;
+
+	if (mode == OS_FILE_UPDATE)
+		file->fd = open(path, O_RDWR | O_CREAT, 0644);
+	else
+		file->fd = mode == OS_FILE_WRITE ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : open(path, O_RDONLY);
+	if (file->fd >= 0)
+		return file;
+
+	os_free(file);
+	return NULL;
+}
+
+long os_read(os_file *file, void *buffer, unsigned long size)
+{
+	return read(file->fd, buffer, size);
+}
+
+long os_write(os_file *file, const void *buffer, unsigned long size)
+{
+	return write(file->fd, buffer, size);
+}
+
+int os_seek(os_file *file, unsigned long offset)
+{
+	return lseek(file->fd, (off_t)offset, SEEK_SET) != (off_t)-1;
+}
+
+int os_close_file(os_file *file)
+{
+	const int result = !close(file->fd);
+
+	os_free(file);
+	return result;
+}
+
+int os_make_dir(const char *path)
+{
+	struct stat st;
+
+	return !mkdir(path, 0755) || (!stat(path, &st) && S_ISDIR(st.st_mode));
+}
+
+int os_delete(const char *path)
+{
+	return !remove(path);
+}
+
+int os_rename(const char *from, const char *to)
+{
+	return !rename(from, to);
+}
+
+static int read_picture_number(FILE *fp)
+{
+	int c = fgetc(fp), number = 0;
+
+	while (c == '#' || (c != EOF && c <= ' '))
+	{
+		if (c == '#')
+		{
+			while (c != EOF && c != '\n')
+				c = fgetc(fp);
+		}
+		c = fgetc(fp);
+	}
+
+	while (c >= '0' && c <= '9')
+	{
+		number = number * 10 + c - '0';
+		c = fgetc(fp);
+	}
+
+	return number;
+}
+
+/*
+ * The host tools read binary PPM files, with 8 bits for each color
+ */
+os_picture *os_open_picture(const char *path, int *width, int *height)
+{
+	os_picture *picture = os_alloc(sizeof(os_picture));
+	char magic[2];
+
+	if (picture == NULL || (picture->fp = fopen(path, "rb")) == NULL)
+	{
+		os_free(picture);
+		return NULL;
+	}
+
+	if (fread(magic, 1, 2, picture->fp) == 2 && magic[0] == 'P' && magic[1] == '6')
+	{
+		*width = read_picture_number(picture->fp);
+		*height = read_picture_number(picture->fp);
+		if (*width > 0 && *height > 0 && read_picture_number(picture->fp) == 255
+			&& (picture->row = os_alloc((size_t)*width * 3)))
+		{
+			picture->width = *width;
+			picture->data = ftell(picture->fp);
+			return picture;
+		}
+	}
+
+	os_close_picture(picture);
+	return NULL;
+}
+
+/*
+ * Reads a row of the picture, as alpha, red, green and blue for every pixel
+ */
+int os_read_picture_row(os_picture *picture, int y, unsigned char *argb)
+{
+	const size_t size = (size_t)picture->width * 3;
+	int x;
+
+	if (fseek(picture->fp, picture->data + (long)(y * size), SEEK_SET)
+		|| fread(picture->row, 1, size, picture->fp) != size)
+		return 0;
+
+	for (x = 0; x < picture->width; x++)
+	{
+		argb[x * 4] = 255;
+		memcpy(argb + x * 4 + 1, picture->row + x * 3, 3);
+	}
+
+	return 1;
+}
+
+void os_close_picture(os_picture *picture)
+{
+	fclose(picture->fp);
+	os_free(picture->row);
+	os_free(picture);
+}
+
+int os_canonical_path(const char *path, char *canonical, size_t size)
+{
+	char resolved[PATH_MAX];
+
+	if (realpath(path, resolved) == NULL || strlen(resolved) >= size)
+		return 0;
+
+	strcpy(canonical, resolved);
+	return 1;
+}
+
+/*
+ * The AmigaDOS patterns are matched the way MatchPatternNoCase() does,
+ * straight from their source: ? is any character, #x is any number of
+ * x, (a|b) is a or b, [a-z] and [~a-z] are sets of characters, ~x is
+ * anything x doesn't match, % is nothing and ' takes the next
+ * character as it is. Returns where the part starting at p ends, or
+ * NULL if a bracket is not closed.
+ */
+static const char *pattern_part_end(const char *p, const char *end)
+{
+	int depth = 0;
+
+	// The repeats and the negations take the part after them
+	while (p < end && (*p == '#' || *p == '~'))
+		p++;
+
+	do
+	{
+		if (p >= end)
+			return NULL;
+
+		switch (*p)
+		{
+		case '\'':
+			if (++p >= end)
+				return NULL;
+			break;
+		case '[':
+			while (++p < end && *p != ']')
+			{
+				if (*p == '\'')
+					p++;
+			}
+			if (p >= end)
+				return NULL;
+			break;
+		case '(':
+			depth++;
+			break;
+		case ')':
+			if (--depth < 0)
+				return NULL;
+			break;
+		}
+		p++;
+	} while (depth > 0);
+
+	return p;
+}
+
+static int pattern_set_match(const char *p, const char *end, const char c)
+{
+	const int negated = *p == '~';
+	int found = 0;
+
+	for (p += negated; p < end; p++)
+	{
+		char from, to;
+
+		if (*p == '\'' && p + 1 < end)
+			p++;
+		from = to = *p;
+		if (p + 2 < end && p[1] == '-')
+		{
+			p += 2;
+			if (*p == '\'' && p + 1 < end)
+				p++;
+			to = *p;
+		}
+
+		// Either case of the character may be in the range
+		if ((tolower((unsigned char)c) >= tolower((unsigned char)from)
+				&& tolower((unsigned char)c) <= tolower((unsigned char)to))
+			|| (toupper((unsigned char)c) >= toupper((unsigned char)from)
+				&& toupper((unsigned char)c) <= toupper((unsigned char)to)))
+			found = 1;
+	}
+
+	return found != negated;
+}
+
+static int pattern_match(const char *p, const char *p_end, const char *s, const char *s_end)
+{
+	const char *part_end, *rest, *k;
+
+	if (p == p_end)
+		return s == s_end;
+
+	part_end = pattern_part_end(p, p_end);
+	rest = part_end;
+
+	switch (*p)
+	{
+	case '?':
+		return s < s_end && pattern_match(rest, p_end, s + 1, s_end);
+
+	case '%':
+		return pattern_match(rest, p_end, s, s_end);
+
+	case '#':
+		// None of it, or some of it and the rest of the repeats, never empty to not loop
+		if (pattern_match(rest, p_end, s, s_end))
+			return 1;
+		for (k = s + 1; k <= s_end; k++)
+		{
+			if (pattern_match(p + 1, part_end, s, k) && pattern_match(p, p_end, k, s_end))
+				return 1;
+		}
+		return 0;
+
+	case '~':
+		for (k = s; k <= s_end; k++)
+		{
+			if (!pattern_match(p + 1, part_end, s, k) && pattern_match(rest, p_end, k, s_end))
+				return 1;
+		}
+		return 0;
+
+	case '(':
+	{
+		// Every alternative, up to the '|' of this level
+		const char *alternative = p + 1, *q = p + 1;
+
+		while (q < part_end)
+		{
+			const char *next = *q == '|' || *q == ')' ? q : pattern_part_end(q, part_end - 1);
+
+			if (next == q)
+			{
+				for (k = s; k <= s_end; k++)
+				{
+					if (pattern_match(alternative, q, s, k) && pattern_match(rest, p_end, k, s_end))
+						return 1;
+				}
+				alternative = ++q;
+			}
+			else
+				q = next;
+		}
+		return 0;
+	}
+
+	case '[':
+		return s < s_end && pattern_set_match(p + 1, part_end - 1, *s) && pattern_match(rest, p_end, s + 1, s_end);
+
+	case '\'':
+		p++;
+		/* fall through */
+	default:
+		return s < s_end && tolower((unsigned char)*p) == tolower((unsigned char)*s)
+			&& pattern_match(rest, p_end, s + 1, s_end);
+	}
+}
+
+/*
+ * Keeps the AmigaDOS pattern, after checking that its brackets are
+ * closed, as ParsePatternNoCase() does
+ */
+os_pattern *os_pattern_compile(const char *source, size_t length)
+{
+	os_pattern *pattern;
+	const char *p;
+
+	for (p = source; p < source + length;)
+	{
+		if ((p = pattern_part_end(p, source + length)) == NULL)
+			return NULL;
+	}
+
+	if ((pattern = os_alloc(sizeof(os_pattern) + length)) == NULL)
+		return NULL;
+
+	memcpy(pattern->source, source, length);
+	pattern->source[length] = '\0';
+	pattern->end = pattern->source + length;
+
+	return pattern;
+}
+
+int os_pattern_match(const os_pattern *pattern, const char *name)
+{
+	return pattern_match(pattern->source, pattern->end, name, name + strlen(name));
+}
+
+void os_pattern_free(os_pattern *pattern)
+{
+	os_free(pattern);
+}
+
+int os_device_key(const char *path, char *key, size_t size)
+{
+	struct stat st;
+
+	if (stat(path, &st))
+		return 0;
+
+	snprintf(key, size, "%lu", (unsigned long)st.st_dev);
+	return 1;
+}
+
+static void *thread_entry(void *data)
+{
+	os_thread *thread = data;
+	thread->entry(thread->data);
+	return NULL;
+}
+
+os_thread *os_thread_start(const char *name, void (*entry)(void *), void *data)
+{
+	os_thread *thread = os_alloc(sizeof(os_thread));
+
+	// Only the processes on the Amiga have a name
+	(void)name;
+	if (thread == NULL)
+		return NULL;
+
+	thread->entry = entry;
+	thread->data = data;
+
+	if (pthread_create(&thread->thread, NULL, thread_entry, thread))
+	{
+		os_free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void os_thread_wait(os_thread *thread)
+{
+	pthread_join(thread->thread, NULL);
+	os_free(thread);
+}
+
+unsigned long os_milliseconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void os_date_now(os_date *date)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	date->seconds = now.tv_sec;
+	date->fraction = now.tv_nsec;
+}
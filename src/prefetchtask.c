@@ -0,0 +1,143 @@
+/*
+  prefetchtask.c
+  Background game prefetching source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Reads ahead the folders and the icons of the games likely to be
+ * started next, on a process of its own below the priority of the GUI.
+ * The manifests are read into the task, and the task that started it
+ * keeps them when the message that it is done arrives, so the
+ * manifests themselves are only touched by that task.
+ */
+
+/* Prototypes */
+#if defined(__amigaos4__)
+#include <proto/exec.h>
+#include <proto/dos.h>
+#else
+#include <clib/exec_protos.h>
+#include <clib/dos_protos.h>
+#endif
+
+/* ANSI C */
+#include <string.h>
+
+#include "osfuncs.h"
+#include "manifest.h"
+#include "prefetchtask.h"
+
+#define PREFETCH_TASK_PRIORITY -1
+
+static void prefetch_task_run(void *data)
+{
+	prefetch_task *task = data;
+	unsigned long start_time = os_milliseconds();
+	manifest_reader reader;
+
+	SetTaskPri(FindTask(NULL), PREFETCH_TASK_PRIORITY);
+	memset(&reader, 0, sizeof(reader));
+
+	// The selection settles first, a new one stops the task before it reads anything
+	while (!task->stop && os_milliseconds() - start_time < task->delay)
+		Delay(1);
+
+	start_time = os_milliseconds();
+	while (!task->stop && task->done < task->count
+		&& (task->done == 0 || os_milliseconds() - start_time < task->budget))
+	{
+		prefetch_game *game = &task->games[task->done];
+
+		game->read = manifest_read(&reader, game->path, &game->manifest, game->arguments);
+		task->done++;
+	}
+
+	manifest_reader_free(&reader);
+
+	PutMsg(task->port, &task->ended);
+}
+
+/*
+ * Starts reading the games of the task. Returns 0 if it could not be
+ * started. Once it started, prefetch_task_ended() has to be called
+ * when its signal arrives, or prefetch_task_end() to stop it.
+ */
+int prefetch_task_start(prefetch_task *task)
+{
+	task->done = 0;
+	task->stop = 0;
+	memset(&task->ended, 0, sizeof(task->ended));
+	task->ended.mn_Length = sizeof(struct Message);
+
+	if ((task->port = CreateMsgPort()))
+	{
+		if ((task->thread = os_thread_start("iGame prefetch", prefetch_task_run, task)))
+			return 1;
+
+		DeleteMsgPort(task->port);
+		task->port = NULL;
+	}
+
+	return 0;
+}
+
+/*
+ * The signal the end of the reading arrives with, or 0 if none runs
+ */
+ULONG prefetch_task_signal(const prefetch_task *task)
+{
+	return task->port ? 1UL << task->port->mp_SigBit : 0;
+}
+
+static void prefetch_task_free(prefetch_task *task)
+{
+	os_thread_wait(task->thread);
+	task->thread = NULL;
+
+	DeleteMsgPort(task->port);
+	task->port = NULL;
+}
+
+/*
+ * Returns 1, and lets the task go, if it ended
+ */
+int prefetch_task_ended(prefetch_task *task)
+{
+	if (task->port == NULL || GetMsg(task->port) == NULL)
+		return 0;
+
+	prefetch_task_free(task);
+	return 1;
+}
+
+/*
+ * Stops the reading after the game it reads and waits for the task to
+ * end. The games read until then are left in the task.
+ */
+void prefetch_task_end(prefetch_task *task)
+{
+	if (task->port == NULL)
+		return;
+
+	task->stop = 1;
+	WaitPort(task->port);
+	GetMsg(task->port);
+	prefetch_task_free(task);
+}
@@ -0,0 +1,66 @@
+/*
+  prefetchtask.h
+  Background game prefetching header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _PREFETCH_TASK_H
+#define _PREFETCH_TASK_H
+
+#include <exec/ports.h>
+
+#include "osfuncs.h"
+#include "manifest.h"
+
+#define PREFETCH_TASK_GAMES 8
+
+typedef struct prefetch_game
+{
+	char path[MANIFEST_PATH_SIZE];
+	game_manifest manifest;                  /* with the path above and the arguments below */
+	char arguments[MANIFEST_ARGUMENTS_SIZE];
+	int read;                                /* the folder could be read */
+} prefetch_game;
+
+typedef struct prefetch_task
+{
+	/* filled in by the caller, the paths of the games */
+	prefetch_game games[PREFETCH_TASK_GAMES];
+	int count;
+	unsigned long delay;          /* to wait before the first, in ms */
+	unsigned long budget;         /* how long it may read for, in ms, at least one game is read */
+
+	/* filled in by the task, safe to read once it ended */
+	int done;                     /* the games read, from the first */
+
+	/* set to stop it after the game it reads */
+	volatile int stop;
+
+	/* private */
+	struct MsgPort *port;
+	os_thread *thread;
+	struct Message ended;
+} prefetch_task;
+
+int prefetch_task_start(prefetch_task *);
+ULONG prefetch_task_signal(const prefetch_task *);
+int prefetch_task_ended(prefetch_task *);
+void prefetch_task_end(prefetch_task *);
+
+#endif
@@ -0,0 +1,1154 @@
+/*
+  scanner.c
+  Repository scanner source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Walks the repositories and collects the paths of the slaves in them.
+ * The repositories are grouped by the physical drive they are on and
+ * every drive gets a worker of its own, so two hard disks (or a hard
+ * disk and a CF card) are read at the same time, while partitions of
+ * the same drive are read one after the other and the heads don't
+ * have to jump between them.
+ *
+ * Every directory that is visited is remembered with its date and the
+ * subdirectories and slaves in it. On the next scan, a directory with
+ * the same date has the same entries, so they are taken from the cache
+ * and only its subdirectories are visited, to check their own dates.
+ * The data files of the games are not read again.
+ *
+ * Game folders are usually full of data directories. Once a slave is
+ * found in a directory, its subdirectories are skipped if the job asks
+ * for it. Each repository can also have patterns of paths to skip,
+ * relative to the repository, e.g. "#?/data".
+ *
+ * The walk does not recurse. The open directories wait on a stack on
+ * the heap, which only holds their locks and where their reading got
+ * to, while one directory reader per worker is shared by all of them.
+ * Everything a worker allocates is counted against its share of the
+ * memory limit of the job, so a huge tree stops the scan instead of
+ * eating all the memory of the machine.
+ *
+ * The workers only use the calls in osfuncs.h and plain string
+ * functions. Nothing in here touches the GUI or the games list.
+ */
+
+/* ANSI C */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "osfuncs.h"
+#include "scanner.h"
+
+#define DEVICE_KEY_SIZE 64
+#define ARRAY_INITIAL_SIZE 64
+#define PROGRESS_SLAVES 16
+#define PROGRESS_DIRS 32
+#define CACHE_HEADER "iGame scan cache 1\n"
+
+typedef struct scan_patterns
+{
+	os_pattern **list;
+	int count;
+} scan_patterns;
+
+/* What a worker has allocated, for the limit and the statistics */
+typedef struct scan_memory
+{
+	size_t used;
+	size_t peak;
+	size_t limit;
+	int limit_reached;
+} scan_memory;
+
+/* A directory on the stack and the next of its names to look at */
+typedef struct scan_frame
+{
+	os_dir *dir;
+	const char *name;
+	int names_left;
+	size_t length;
+} scan_frame;
+
+typedef struct scan_worker
+{
+	char device[DEVICE_KEY_SIZE];
+	int index;
+	const scan_job *job;
+	const int *repo_device;
+	const scan_patterns *patterns_of_repos;
+	const scan_patterns *patterns;
+	size_t root_length;
+	scan_slave *slaves;
+	int slaves_count;
+	int slaves_size;
+	scan_dir **dirs;
+	int dirs_count;
+	int dirs_size;
+	int slaves_reported;
+	int dirs_reported;
+	char *names;
+	size_t names_size;
+	scan_frame *stack;
+	int stack_count;
+	int stack_size;
+	os_dir_reader *reader;
+	scan_memory memory;
+	int max_depth_reached;
+	int dirs_read;
+	int dirs_reused;
+	int failed;
+	unsigned long entries_count;
+	char path[SCAN_PATH_SIZE];
+	os_thread *thread;
+} scan_worker;
+
+static int is_slave(const char *name)
+{
+	static const char extension[] = ".slave";
+	const size_t length = strlen(name);
+	const size_t extension_length = sizeof(extension) - 1;
+	size_t i;
+
+	if (length <= extension_length)
+		return 0;
+
+	name += length - extension_length;
+	for (i = 0; i < extension_length; i++)
+	{
+		if (tolower((unsigned char)name[i]) != extension[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Appends name to the path, which is length characters long.
+ * Returns the new length, or 0 if it does not fit.
+ */
+static size_t append_path(char *path, size_t length, const char *name)
+{
+	const size_t name_length = strlen(name);
+	const int separator = length > 0 && path[length - 1] != ':' && path[length - 1] != '/';
+
+	if (length + separator + name_length >= SCAN_PATH_SIZE)
+		return 0;
+
+	if (separator)
+		path[length++] = '/';
+	memcpy(path + length, name, name_length + 1);
+
+	return length + name_length;
+}
+
+/*
+ * Allocates memory counted in memory, if it is not NULL. Returns NULL
+ * if it ran out of memory or the allocation would go over the limit.
+ */
+static void *memory_alloc(scan_memory *memory, size_t size)
+{
+	void *block;
+
+	if (memory == NULL)
+		return os_alloc(size);
+
+	if (memory->limit > 0 && memory->used + size > memory->limit)
+	{
+		memory->limit_reached = 1;
+		return NULL;
+	}
+
+	if ((block = os_alloc(size)) == NULL)
+		return NULL;
+
+	memory->used += size;
+	if (memory->used > memory->peak)
+		memory->peak = memory->used;
+
+	return block;
+}
+
+static void memory_free(scan_memory *memory, void *block, size_t size)
+{
+	if (block == NULL)
+		return;
+
+	os_free(block);
+	if (memory)
+		memory->used -= size;
+}
+
+/*
+ * Makes room for one more element in an array of count elements,
+ * doubling it when it is full. Returns 0 if it ran out of memory.
+ */
+static int grow_array(scan_memory *memory, void **array, int count, int *size, size_t element_size)
+{
+	void *grown;
+	int new_size;
+
+	if (count < *size)
+		return 1;
+
+	new_size = *size ? *size * 2 : ARRAY_INITIAL_SIZE;
+	if ((grown = memory_alloc(memory, element_size * new_size)) == NULL)
+		return 0;
+
+	if (*array)
+	{
+		memcpy(grown, *array, element_size * count);
+		memory_free(memory, *array, element_size * *size);
+	}
+	*array = grown;
+	*size = new_size;
+
+	return 1;
+}
+
+static scan_dir *new_dir(scan_memory *memory, const char *path, const os_date *date, int names_count, const char *names, size_t names_size)
+{
+	const size_t path_size = strlen(path) + 1;
+	scan_dir *dir = memory_alloc(memory, sizeof(scan_dir) + path_size + names_size);
+	if (dir == NULL)
+		return NULL;
+
+	dir->path = (char *)(dir + 1);
+	memcpy(dir->path, path, path_size);
+	dir->date = *date;
+	dir->names_count = names_count;
+	dir->names_size = names_size;
+	dir->names = dir->path + path_size;
+	if (names_size)
+		memcpy(dir->names, names, names_size);
+
+	return dir;
+}
+
+static int compare_dirs(const void *a, const void *b)
+{
+	return strcmp((*(scan_dir * const *)a)->path, (*(scan_dir * const *)b)->path);
+}
+
+static int compare_slaves(const void *a, const void *b)
+{
+	return strcmp(((const scan_slave *)a)->path, ((const scan_slave *)b)->path);
+}
+
+static const scan_dir *find_dir(const scan_cache *cache, const char *path)
+{
+	scan_dir key, *key_pointer = &key;
+	scan_dir **found;
+
+	if (cache->count == 0)
+		return NULL;
+
+	key.path = (char *)path;
+	found = bsearch(&key_pointer, cache->dirs, cache->count, sizeof(scan_dir *), compare_dirs);
+
+	return found ? *found : NULL;
+}
+
+static void add_slave(scan_worker *worker, size_t name_offset)
+{
+	scan_slave *slave;
+	char *c;
+
+	if (!grow_array(&worker->memory, (void **)&worker->slaves, worker->slaves_count, &worker->slaves_size, sizeof(scan_slave)))
+	{
+		worker->failed = 1;
+		return;
+	}
+
+	slave = &worker->slaves[worker->slaves_count++];
+	strcpy(slave->path, worker->path);
+
+	// The games list always had the slave file names in lower case
+	for (c = slave->path + name_offset; *c; c++)
+		*c = tolower((unsigned char)*c);
+}
+
+/*
+ * Reads the entries of dir and keeps the subdirectories and the
+ * slaves. All the directories share the same names buffer, as each
+ * one is read to the end before going into its subdirectories.
+ */
+static scan_dir *read_directory(scan_worker *worker, const os_dir *dir, const os_date *date)
+{
+	os_entry entry;
+	size_t names_size = 0;
+	int names_count = 0;
+
+	while (os_read_entry(worker->reader, dir, &entry))
+	{
+		const size_t name_size = strlen(entry.name) + 1;
+		char type;
+
+		worker->entries_count++;
+		if (entry.is_dir)
+			type = 'd';
+		else if (is_slave(entry.name))
+			type = 's';
+		else
+			continue;
+
+		if (names_size + 1 + name_size > worker->names_size)
+		{
+			const size_t size = worker->names_size ? worker->names_size * 2 : 1024;
+			char *names = memory_alloc(&worker->memory, size);
+			if (names == NULL)
+			{
+				os_read_end(worker->reader);
+				return NULL;
+			}
+
+			if (worker->names)
+			{
+				memcpy(names, worker->names, names_size);
+				memory_free(&worker->memory, worker->names, worker->names_size);
+			}
+			worker->names = names;
+			worker->names_size = size;
+		}
+
+		worker->names[names_size] = type;
+		memcpy(worker->names + names_size + 1, entry.name, name_size);
+		names_size += 1 + name_size;
+		names_count++;
+	}
+
+	os_read_end(worker->reader);
+	return new_dir(&worker->memory, worker->path, date, names_count, worker->names, names_size);
+}
+
+/*
+ * Checks the path in worker->path, relative to the repository,
+ * against the patterns of the repository
+ */
+static int is_excluded(const scan_worker *worker)
+{
+	const char *path = worker->path + worker->root_length;
+	int i;
+
+	if (*path == '/')
+		path++;
+
+	for (i = 0; i < worker->patterns->count; i++)
+	{
+		if (os_pattern_match(worker->patterns->list[i], path))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Records dir, whose path is in worker->path and is length characters
+ * long, and its slaves. If its subdirectories have to be visited too,
+ * it is pushed on the stack, otherwise it is closed. The repository
+ * itself is at depth 0.
+ */
+static void enter_directory(scan_worker *worker, os_dir *dir, size_t length)
+{
+	const scan_dir *cached = NULL;
+	const int depth = worker->stack_count;
+	scan_dir *record;
+	scan_frame *frame;
+	const char *name;
+	os_date date;
+	int i, slave_found = 0;
+
+	if (depth > worker->max_depth_reached)
+		worker->max_depth_reached = depth;
+
+	if (!os_dir_date(worker->reader, dir, &date))
+		memset(&date, 0, sizeof(date));
+	else if (worker->job->cache)
+		cached = find_dir(worker->job->cache, worker->path);
+
+	if (cached && cached->date.seconds == date.seconds && cached->date.fraction == date.fraction)
+	{
+		record = new_dir(&worker->memory, cached->path, &cached->date, cached->names_count, cached->names, cached->names_size);
+		worker->dirs_reused++;
+	}
+	else
+	{
+		record = read_directory(worker, dir, &date);
+		worker->dirs_read++;
+	}
+
+	if (record == NULL || !grow_array(&worker->memory, (void **)&worker->dirs, worker->dirs_count, &worker->dirs_size, sizeof(scan_dir *)))
+	{
+		if (record)
+			memory_free(&worker->memory, record, sizeof(scan_dir) + strlen(record->path) + 1 + record->names_size);
+		os_close_dir(dir);
+		worker->failed = 1;
+		return;
+	}
+	worker->dirs[worker->dirs_count++] = record;
+
+	// The slaves first, so it is known if this is a game folder
+	name = record->names;
+	for (i = 0; i < record->names_count && !worker->failed; i++, name += strlen(name) + 1)
+	{
+		const size_t entry_length = name[0] == 's' ? append_path(worker->path, length, name + 1) : 0;
+		if (entry_length == 0)
+			continue;
+
+		if (!is_excluded(worker))
+		{
+			add_slave(worker, entry_length - strlen(name + 1));
+			slave_found = 1;
+		}
+		worker->path[length] = '\0';
+	}
+
+	if (worker->failed
+		|| (slave_found && worker->job->prune_game_dirs)
+		|| (worker->job->max_depth > 0 && depth >= worker->job->max_depth))
+	{
+		os_close_dir(dir);
+		return;
+	}
+
+	if (!grow_array(&worker->memory, (void **)&worker->stack, worker->stack_count, &worker->stack_size, sizeof(scan_frame)))
+	{
+		os_close_dir(dir);
+		worker->failed = 1;
+		return;
+	}
+
+	frame = &worker->stack[worker->stack_count++];
+	frame->dir = dir;
+	frame->name = record->names;
+	frame->names_left = record->names_count;
+	frame->length = length;
+}
+
+/*
+ * Passes the new slaves and the count of the new directories to the
+ * progress hook of the job, every few of them or when forced to
+ */
+static void report_progress(scan_worker *worker, const int force)
+{
+	const int slaves_count = worker->slaves_count - worker->slaves_reported;
+	const int dirs_count = worker->dirs_count - worker->dirs_reported;
+
+	if (worker->job->progress == NULL || (slaves_count == 0 && dirs_count == 0))
+		return;
+
+	if (force || slaves_count >= PROGRESS_SLAVES || dirs_count >= PROGRESS_DIRS)
+	{
+		worker->job->progress(worker->job->progress_data, worker->slaves + worker->slaves_reported, slaves_count, dirs_count);
+		worker->slaves_reported = worker->slaves_count;
+		worker->dirs_reported = worker->dirs_count;
+	}
+}
+
+/*
+ * Walks the tree under dir, whose path is in worker->path. All the
+ * directories share the same path buffer and are opened relative to
+ * their parent, which stays open on the stack until all of its
+ * subdirectories are done.
+ */
+static void scan_tree(scan_worker *worker, os_dir *dir)
+{
+	enter_directory(worker, dir, strlen(worker->path));
+
+	while (worker->stack_count > 0 && !worker->failed && !worker->job->cancel)
+	{
+		scan_frame *frame = &worker->stack[worker->stack_count - 1];
+		const char *name = NULL;
+		size_t entry_length;
+
+		for (; frame->names_left > 0 && name == NULL; frame->names_left--, frame->name += strlen(frame->name) + 1)
+		{
+			if (frame->name[0] == 'd')
+				name = frame->name + 1;
+		}
+
+		if (name == NULL)
+		{
+			os_close_dir(frame->dir);
+			worker->stack_count--;
+			continue;
+		}
+
+		entry_length = append_path(worker->path, frame->length, name);
+		if (entry_length > 0 && !is_excluded(worker))
+		{
+			// The frame may move when the stack grows
+			os_dir *subdir = os_open_subdir(frame->dir, name);
+			if (subdir)
+				enter_directory(worker, subdir, entry_length);
+			report_progress(worker, 0);
+		}
+	}
+
+	while (worker->stack_count > 0)
+		os_close_dir(worker->stack[--worker->stack_count].dir);
+}
+
+static void scan_worker_run(void *data)
+{
+	scan_worker *worker = data;
+	os_dir *dir;
+	int i;
+
+	if ((worker->reader = os_reader_alloc()) == NULL)
+	{
+		worker->failed = 1;
+		return;
+	}
+
+	for (i = 0; i < worker->job->repos_count && !worker->failed && !worker->job->cancel; i++)
+	{
+		if (worker->repo_device[i] != worker->index)
+			continue;
+
+		// The repository path is resolved once, everything
+		// under it is built up from the entry names
+		if (!os_canonical_path(worker->job->repos[i], worker->path, sizeof(worker->path)))
+			continue;
+
+		worker->patterns = &worker->patterns_of_repos[i];
+		worker->root_length = strlen(worker->path);
+		if ((dir = os_open_dir(worker->path)))
+			scan_tree(worker, dir);
+	}
+
+	if (!worker->failed)
+		report_progress(worker, 1);
+
+	os_reader_free(worker->reader);
+	worker->reader = NULL;
+}
+
+/*
+ * Compiles the ';' separated patterns of a repository once for the
+ * whole scan. Patterns that don't compile are ignored.
+ */
+static int compile_patterns(scan_patterns *patterns, const char *excludes)
+{
+	const char *start = excludes;
+	int size = 0;
+
+	while (start && *start)
+	{
+		const char *end = strchr(start, ';');
+		const size_t length = end ? (size_t)(end - start) : strlen(start);
+
+		if (length > 0)
+		{
+			os_pattern *pattern = os_pattern_compile(start, length);
+			if (pattern)
+			{
+				if (!grow_array(NULL, (void **)&patterns->list, patterns->count, &size, sizeof(os_pattern *)))
+				{
+					os_pattern_free(pattern);
+					return 0;
+				}
+				patterns->list[patterns->count++] = pattern;
+			}
+		}
+
+		start = end ? end + 1 : NULL;
+	}
+
+	return 1;
+}
+
+static void free_patterns(scan_patterns *patterns, const int count)
+{
+	int i, j;
+
+	for (i = 0; i < count; i++)
+	{
+		for (j = 0; j < patterns[i].count; j++)
+			os_pattern_free(patterns[i].list[j]);
+		os_free(patterns[i].list);
+	}
+	os_free(patterns);
+}
+
+static void free_worker(scan_worker *worker)
+{
+	int i;
+
+	for (i = 0; i < worker->dirs_count; i++)
+		os_free(worker->dirs[i]);
+	os_free(worker->dirs);
+	os_free(worker->slaves);
+	os_free(worker->names);
+	os_free(worker->stack);
+}
+
+/*
+ * Returns 0 if it ran out of memory or went over the memory limit of
+ * the job, in which case the job has no results. A cancelled job has
+ * the results found until then. Repositories that can't be found are skipped. If the job
+ * has no cache, every directory is read.
+ */
+int scan_run(scan_job *job)
+{
+	scan_worker *workers;
+	scan_patterns *patterns;
+	int *repo_device;
+	int i, j, failed = 0, slaves_count = 0, dirs_count = 0;
+	const unsigned long start = os_milliseconds();
+
+	job->slaves = NULL;
+	job->slaves_count = 0;
+	job->new_cache.dirs = NULL;
+	job->new_cache.count = 0;
+	job->devices_count = 0;
+	job->dirs_read = 0;
+	job->dirs_reused = 0;
+	job->entries_count = 0;
+	job->milliseconds = 0;
+	job->peak_memory = 0;
+	job->max_depth_reached = 0;
+	job->limit_reached = 0;
+
+	if (job->repos_count <= 0)
+		return 1;
+
+	workers = os_alloc(sizeof(scan_worker) * job->repos_count);
+	repo_device = os_alloc(sizeof(int) * job->repos_count);
+	patterns = os_alloc(sizeof(scan_patterns) * job->repos_count);
+	if (workers == NULL || repo_device == NULL || patterns == NULL)
+	{
+		os_free(workers);
+		os_free(repo_device);
+		os_free(patterns);
+		return 0;
+	}
+
+	for (i = 0; i < job->repos_count && !failed; i++)
+	{
+		if (job->excludes && !compile_patterns(&patterns[i], job->excludes[i]))
+			failed = 1;
+	}
+
+	// Group the repositories by the drive they are on
+	for (i = 0; i < job->repos_count && !failed; i++)
+	{
+		char key[DEVICE_KEY_SIZE];
+
+		repo_device[i] = -1;
+		if (!os_device_key(job->repos[i], key, sizeof(key)))
+			continue;
+
+		for (j = 0; j < job->devices_count; j++)
+		{
+			if (!strcmp(workers[j].device, key))
+				break;
+		}
+
+		if (j == job->devices_count)
+		{
+			strcpy(workers[j].device, key);
+			workers[j].index = j;
+			workers[j].job = job;
+			workers[j].repo_device = repo_device;
+			workers[j].patterns_of_repos = patterns;
+			job->devices_count++;
+		}
+		repo_device[i] = j;
+	}
+
+	// Every drive gets an equal share of the memory limit
+	for (i = 0; i < job->devices_count; i++)
+		workers[i].memory.limit = (job->memory_limit + job->devices_count - 1) / job->devices_count;
+
+	// With one drive there is nothing to overlap, so don't bother
+	// with a new process. If a process can't be started, its drive
+	// is scanned here after the others have been started.
+	if (job->devices_count > 1)
+	{
+		for (i = 0; i < job->devices_count; i++)
+			workers[i].thread = os_thread_start("iGame scanner", scan_worker_run, &workers[i]);
+	}
+
+	for (i = 0; i < job->devices_count; i++)
+	{
+		if (workers[i].thread == NULL)
+			scan_worker_run(&workers[i]);
+	}
+
+	for (i = 0; i < job->devices_count; i++)
+	{
+		if (workers[i].thread)
+			os_thread_wait(workers[i].thread);
+
+		failed |= workers[i].failed;
+		slaves_count += workers[i].slaves_count;
+		dirs_count += workers[i].dirs_count;
+		job->dirs_read += workers[i].dirs_read;
+		job->dirs_reused += workers[i].dirs_reused;
+		job->entries_count += workers[i].entries_count;
+		job->peak_memory += workers[i].memory.peak;
+		job->limit_reached |= workers[i].memory.limit_reached;
+		if (workers[i].max_depth_reached > job->max_depth_reached)
+			job->max_depth_reached = workers[i].max_depth_reached;
+	}
+	job->milliseconds = os_milliseconds() - start;
+
+	if (!failed && slaves_count > 0)
+	{
+		job->slaves = os_alloc(sizeof(scan_slave) * slaves_count);
+		if (job->slaves == NULL)
+			failed = 1;
+	}
+
+	if (!failed && dirs_count > 0)
+	{
+		job->new_cache.dirs = os_alloc(sizeof(scan_dir *) * dirs_count);
+		if (job->new_cache.dirs == NULL)
+			failed = 1;
+	}
+
+	for (i = 0; i < job->devices_count; i++)
+	{
+		if (!failed)
+		{
+			if (workers[i].slaves_count > 0)
+			{
+				memcpy(job->slaves + job->slaves_count, workers[i].slaves, sizeof(scan_slave) * workers[i].slaves_count);
+				job->slaves_count += workers[i].slaves_count;
+			}
+
+			// The directories now belong to the new cache
+			if (workers[i].dirs_count > 0)
+			{
+				memcpy(job->new_cache.dirs + job->new_cache.count, workers[i].dirs, sizeof(scan_dir *) * workers[i].dirs_count);
+				job->new_cache.count += workers[i].dirs_count;
+				workers[i].dirs_count = 0;
+			}
+		}
+		free_worker(&workers[i]);
+	}
+
+	os_free(workers);
+	os_free(repo_device);
+	free_patterns(patterns, job->repos_count);
+
+	if (failed)
+	{
+		scan_free(job);
+		return 0;
+	}
+
+	qsort(job->new_cache.dirs, job->new_cache.count, sizeof(scan_dir *), compare_dirs);
+	qsort(job->slaves, job->slaves_count, sizeof(scan_slave), compare_slaves);
+
+	return 1;
+}
+
+/*
+ * Frees the slaves of the job and its new cache,
+ * unless the cache was taken by the caller
+ */
+void scan_free(scan_job *job)
+{
+	os_free(job->slaves);
+	job->slaves = NULL;
+	job->slaves_count = 0;
+	scan_cache_free(&job->new_cache);
+}
+
+/*
+ * Reads the names of a directory from the cache file, header being
+ * its line with the date, the number of names and the path
+ */
+static scan_dir *read_cache_dir(FILE *fp, char *header, char **names, size_t *names_allocated)
+{
+	char line[SCAN_PATH_SIZE + 64];
+	size_t names_size = 0;
+	int names_count, offset = 0, i;
+	os_date date;
+
+	header[strcspn(header, "\n")] = '\0';
+	if (sscanf(header, "%lu %lu %d %n", &date.seconds, &date.fraction, &names_count, &offset) < 3
+		|| offset == 0 || names_count < 0)
+		return NULL;
+
+	for (i = 0; i < names_count; i++)
+	{
+		size_t name_size;
+
+		if (fgets(line, sizeof(line), fp) == NULL)
+			return NULL;
+
+		line[strcspn(line, "\n")] = '\0';
+		name_size = strlen(line) + 1;
+		if ((line[0] != 'd' && line[0] != 's') || name_size < 3)
+			return NULL;
+
+		if (names_size + name_size > *names_allocated)
+		{
+			const size_t allocated = *names_allocated ? *names_allocated * 2 : 1024;
+			char *grown = os_alloc(allocated);
+			if (grown == NULL)
+				return NULL;
+
+			if (*names)
+			{
+				memcpy(grown, *names, names_size);
+				os_free(*names);
+			}
+			*names = grown;
+			*names_allocated = allocated;
+		}
+		memcpy(*names + names_size, line, name_size);
+		names_size += name_size;
+	}
+
+	return new_dir(NULL, header + offset, &date, names_count, *names, names_size);
+}
+
+/*
+ * The cache file has a line for every directory with its date, the
+ * number of names and its path, followed by a line for every name.
+ * Returns 0 if the file is missing or broken, and the cache is empty.
+ */
+int scan_cache_load(scan_cache *cache, const char *filename)
+{
+	char line[SCAN_PATH_SIZE + 64];
+	char *names = NULL;
+	size_t names_allocated = 0;
+	int size = 0, result;
+	FILE *fp;
+
+	cache->dirs = NULL;
+	cache->count = 0;
+
+	if ((fp = fopen(filename, "r")) == NULL)
+		return 0;
+
+	result = fgets(line, sizeof(line), fp) && !strcmp(line, CACHE_HEADER);
+	while (result && fgets(line, sizeof(line), fp))
+	{
+		scan_dir *dir = read_cache_dir(fp, line, &names, &names_allocated);
+		if (dir && grow_array(NULL, (void **)&cache->dirs, cache->count, &size, sizeof(scan_dir *)))
+		{
+			cache->dirs[cache->count++] = dir;
+		}
+		else
+		{
+			os_free(dir);
+			result = 0;
+		}
+	}
+
+	fclose(fp);
+	os_free(names);
+
+	if (result)
+		qsort(cache->dirs, cache->count, sizeof(scan_dir *), compare_dirs);
+	else
+		scan_cache_free(cache);
+
+	return result;
+}
+
+int scan_cache_save(const scan_cache *cache, const char *filename)
+{
+	FILE *fp;
+	int i, j;
+
+	if ((fp = fopen(filename, "w")) == NULL)
+		return 0;
+
+	fputs(CACHE_HEADER, fp);
+	for (i = 0; i < cache->count; i++)
+	{
+		const scan_dir *dir = cache->dirs[i];
+		const char *name = dir->names;
+
+		fprintf(fp, "%lu %lu %d %s\n", dir->date.seconds, dir->date.fraction, dir->names_count, dir->path);
+		for (j = 0; j < dir->names_count; j++, name += strlen(name) + 1)
+			fprintf(fp, "%s\n", name);
+	}
+
+	return fclose(fp) == 0;
+}
+
+void scan_cache_free(scan_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+		os_free(cache->dirs[i]);
+	os_free(cache->dirs);
+	cache->dirs = NULL;
+	cache->count = 0;
+}
+
+/*
+ * A removed path or a new slave, while looking for moves, or a slave
+ * while looking for copies. Either the checksum or the key is used.
+ */
+typedef struct move_candidate
+{
+	unsigned long crc;
+	const char *key;
+	int index;
+	int added;
+} move_candidate;
+
+/*
+ * A slave that moved is still in a folder of the same name, e.g.
+ * "Games:A/Arkanoid/Arkanoid.slave" and "Games:A-C/Arkanoid/arkanoid.slave",
+ * so the key is the name of the folder and the slave
+ */
+static const char *move_key(const char *path)
+{
+	const char *key = path;
+	const char *c;
+	int separators = 0;
+
+	for (c = path + strlen(path); c > path && separators < 2; c--)
+	{
+		if (c[-1] == '/' || c[-1] == ':')
+		{
+			if (++separators == 2)
+				key = c;
+		}
+	}
+
+	return key;
+}
+
+static int compare_keys(const char *a, const char *b)
+{
+	while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+	{
+		a++;
+		b++;
+	}
+
+	return tolower((unsigned char)*a) - tolower((unsigned char)*b);
+}
+
+static int same_candidates(const move_candidate *first, const move_candidate *second)
+{
+	return first->key ? !compare_keys(first->key, second->key) : first->crc == second->crc;
+}
+
+static int compare_candidates(const void *a, const void *b)
+{
+	const move_candidate *first = a, *second = b;
+	int result;
+
+	if (first->key)
+		result = compare_keys(first->key, second->key);
+	else
+		result = first->crc < second->crc ? -1 : first->crc > second->crc;
+
+	if (result == 0)
+		result = first->added - second->added;
+
+	return result ? result : first->index - second->index;
+}
+
+/*
+ * Pairs the removed paths with the new slaves that have the same
+ * checksum, or the same key if checksums are not given. Checksums or
+ * keys that more than one path or slave have are left alone, as there
+ * is no telling which one went where.
+ */
+static int find_moves(scan_diff *diff, const scan_diff_input *input, const int by_crc)
+{
+	move_candidate *candidates;
+	int i, j, count = 0;
+
+	if (diff->removed_count == 0 || diff->added_count == 0)
+		return 1;
+
+	candidates = os_alloc(sizeof(move_candidate) * (diff->removed_count + diff->added_count));
+	if (candidates == NULL)
+		return 0;
+
+	for (i = 0; i < input->known_count; i++)
+	{
+		if (diff->known_states[i] == SCAN_REMOVED && (!by_crc || input->known_crcs[i]))
+		{
+			candidates[count].crc = by_crc ? input->known_crcs[i] : 0;
+			candidates[count].key = by_crc ? NULL : move_key(input->known[i]);
+			candidates[count].index = i;
+			candidates[count++].added = 0;
+		}
+	}
+	for (i = 0; i < input->slaves_count; i++)
+	{
+		if (diff->slave_added[i] && (!by_crc || input->slave_crcs[i]))
+		{
+			candidates[count].crc = by_crc ? input->slave_crcs[i] : 0;
+			candidates[count].key = by_crc ? NULL : move_key(input->slaves[i].path);
+			candidates[count].index = i;
+			candidates[count++].added = 1;
+		}
+	}
+
+	qsort(candidates, count, sizeof(move_candidate), compare_candidates);
+
+	for (i = 0; i < count; i = j)
+	{
+		for (j = i + 1; j < count && same_candidates(&candidates[i], &candidates[j]); j++)
+			;
+
+		if (j - i == 2 && !candidates[i].added && candidates[i + 1].added)
+		{
+			const int from = candidates[i].index, to = candidates[i + 1].index;
+
+			diff->known_states[from] = SCAN_MOVED;
+			diff->known_slaves[from] = to;
+			diff->slave_added[to] = 0;
+			diff->removed_count--;
+			diff->added_count--;
+			diff->moved_count++;
+		}
+	}
+
+	os_free(candidates);
+	return 1;
+}
+
+/*
+ * Marks the slaves that have the checksum of another slave of the scan.
+ * Of all the copies, the first one that was already in the list is the
+ * original, or the first one by path if they are all new.
+ */
+static int find_copies(scan_diff *diff, const scan_diff_input *input)
+{
+	move_candidate *candidates;
+	int i, j, count = 0;
+
+	for (i = 0; i < input->slaves_count; i++)
+		diff->slave_copies[i] = -1;
+
+	if (input->slave_crcs == NULL)
+		return 1;
+
+	candidates = os_alloc(sizeof(move_candidate) * (input->slaves_count + 1));
+	if (candidates == NULL)
+		return 0;
+
+	for (i = 0; i < input->slaves_count; i++)
+	{
+		if (input->slave_crcs[i])
+		{
+			candidates[count].crc = input->slave_crcs[i];
+			candidates[count].key = NULL;
+			candidates[count].index = i;
+			candidates[count++].added = diff->slave_added[i];
+		}
+	}
+
+	qsort(candidates, count, sizeof(move_candidate), compare_candidates);
+
+	for (i = 0; i < count; i = j)
+	{
+		for (j = i + 1; j < count && same_candidates(&candidates[i], &candidates[j]); j++)
+		{
+			diff->slave_copies[candidates[j].index] = candidates[i].index;
+			diff->copies_count++;
+		}
+	}
+
+	os_free(candidates);
+	return 1;
+}
+
+/*
+ * Compares the sorted slaves of a scan with the known paths, which
+ * have to be sorted the same way, in one pass over both. The same path
+ * may be known more than once. Moves are looked for by checksum first,
+ * then by the names of the slave and its folder. Returns 0 if it ran
+ * out of memory.
+ */
+int scan_diff_run(scan_diff *diff, const scan_diff_input *input)
+{
+	const scan_slave *slaves = input->slaves;
+	const char * const *known = input->known;
+	const int slaves_count = input->slaves_count, known_count = input->known_count;
+	int i = 0, j = 0;
+
+	memset(diff, 0, sizeof(scan_diff));
+	diff->known_states = os_alloc(known_count + 1);
+	diff->known_slaves = os_alloc(sizeof(int) * (known_count + 1));
+	diff->slave_added = os_alloc(slaves_count + 1);
+	diff->slave_copies = os_alloc(sizeof(int) * (slaves_count + 1));
+	if (diff->known_states == NULL || diff->known_slaves == NULL || diff->slave_added == NULL
+		|| diff->slave_copies == NULL)
+	{
+		scan_diff_free(diff);
+		return 0;
+	}
+
+	while (i < known_count || j < slaves_count)
+	{
+		const int result = i == known_count ? 1 : j == slaves_count ? -1 : strcmp(known[i], slaves[j].path);
+
+		if (result == 0)
+		{
+			diff->known_states[i] = SCAN_UNCHANGED;
+			diff->known_slaves[i++] = j;
+			diff->unchanged_count++;
+		}
+		else if (result < 0)
+		{
+			diff->known_states[i] = SCAN_REMOVED;
+			diff->known_slaves[i++] = -1;
+			diff->removed_count++;
+		}
+		else
+		{
+			// A slave is new if no known path matched it before moving on
+			diff->slave_added[j] = i == 0 || diff->known_slaves[i - 1] != j;
+			diff->added_count += diff->slave_added[j];
+			j++;
+		}
+	}
+
+	if ((input->known_crcs && input->slave_crcs && !find_moves(diff, input, 1))
+		|| !find_moves(diff, input, 0) || !find_copies(diff, input))
+	{
+		scan_diff_free(diff);
+		return 0;
+	}
+
+	return 1;
+}
+
+void scan_diff_free(scan_diff *diff)
+{
+	os_free(diff->known_states);
+	os_free(diff->known_slaves);
+	os_free(diff->slave_added);
+	os_free(diff->slave_copies);
+	diff->known_states = NULL;
+	diff->known_slaves = NULL;
+	diff->slave_added = NULL;
+	diff->slave_copies = NULL;
+}
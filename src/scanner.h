@@ -0,0 +1,137 @@
+/*
+  scanner.h
+  Repository scanner header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SCANNER_H
+#define _SCANNER_H
+
+#include "osfuncs.h"
+
+#define SCAN_PATH_SIZE 256
+
+typedef struct scan_slave
+{
+	char path[SCAN_PATH_SIZE];
+} scan_slave;
+
+/*
+ * What a scan found in one directory. The names are the subdirectories
+ * and the slaves in it, one after the other, each one null-terminated
+ * and starting with 'd' for a directory or 's' for a slave.
+ */
+typedef struct scan_dir
+{
+	char *path;
+	os_date date;
+	int names_count;
+	size_t names_size;
+	char *names;
+} scan_dir;
+
+/* The directories of the last scan, sorted by path */
+typedef struct scan_cache
+{
+	scan_dir **dirs;
+	int count;
+} scan_cache;
+
+typedef struct scan_job
+{
+	/* filled in by the caller */
+	const char **repos;
+	const char **excludes; /* patterns for each repository, separated by ';' */
+	int repos_count;
+	const scan_cache *cache;
+	int prune_game_dirs;   /* skip the subdirectories of a directory with a slave */
+	int max_depth;         /* levels below the repository, 0 for no limit */
+	size_t memory_limit;   /* bytes, shared by all the drives, 0 for no limit */
+
+	/*
+	 * Called by the workers, maybe at the same time, with the slaves
+	 * they found and the number of directories they visited since
+	 * their last call. It may be NULL.
+	 */
+	void (*progress)(void *, const scan_slave *, int, int);
+	void *progress_data;
+
+	/* can be set while the scan runs, which then returns what it found so far */
+	volatile int cancel;
+
+	/* filled in by scan_run() */
+	scan_slave *slaves;    /* sorted by path */
+	int slaves_count;
+	scan_cache new_cache;
+	int devices_count;
+	int dirs_read;
+	int dirs_reused;
+	unsigned long entries_count;
+	unsigned long milliseconds;
+	size_t peak_memory;    /* the peaks of all the drives added up */
+	int max_depth_reached;
+	int limit_reached;     /* the scan failed because of memory_limit */
+} scan_job;
+
+/* What happened to a known path after a scan */
+#define SCAN_UNCHANGED 0
+#define SCAN_REMOVED 1
+#define SCAN_MOVED 2
+
+/*
+ * The slaves of a scan and the paths known before it, both sorted by
+ * path. The checksums are optional, with 0 for the ones not known.
+ */
+typedef struct scan_diff_input
+{
+	const scan_slave *slaves;
+	const unsigned long *slave_crcs;
+	int slaves_count;
+	const char * const *known;
+	const unsigned long *known_crcs;
+	int known_count;
+} scan_diff_input;
+
+/*
+ * The differences between the slaves of a scan and the paths that were
+ * known before it. The slaves that are neither at a known path nor
+ * moved from one are new.
+ */
+typedef struct scan_diff
+{
+	unsigned char *known_states; /* SCAN_UNCHANGED, SCAN_REMOVED or SCAN_MOVED */
+	int *known_slaves;           /* the slave a known path is now at, -1 if removed */
+	unsigned char *slave_added;  /* 1 for every new slave */
+	int *slave_copies;           /* the slave with the same checksum it is a copy of, or -1 */
+	int added_count;
+	int removed_count;
+	int moved_count;
+	int unchanged_count;
+	int copies_count;
+} scan_diff;
+
+int scan_run(scan_job *);
+void scan_free(scan_job *);
+int scan_cache_load(scan_cache *, const char *);
+int scan_cache_save(const scan_cache *, const char *);
+void scan_cache_free(scan_cache *);
+int scan_diff_run(scan_diff *, const scan_diff_input *);
+void scan_diff_free(scan_diff *);
+
+#endif
@@ -0,0 +1,230 @@
+/*
+  scantask.c
+  Background repository scan source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Runs a scan on a process of its own, below the priority of the GUI,
+ * so the games list can still be used while the repositories are
+ * read. The workers of the scan send what they find to the port of
+ * the task that started it, in batches, with the titles of the slaves
+ * already read. The caches are loaded before the process starts and
+ * saved after it ended, on the task that started it, as the C library
+ * that reads and writes them is not safe to use from two processes at
+ * once.
+ */
+
+/* Prototypes */
+#if defined(__amigaos4__)
+#include <proto/exec.h>
+#else
+#include <clib/exec_protos.h>
+#endif
+
+/* ANSI C */
+#include <string.h>
+
+#include "osfuncs.h"
+#include "scanner.h"
+#include "slavefuncs.h"
+#include "scantask.h"
+
+#define SCAN_TASK_PRIORITY -1
+
+/*
+ * The progress hook of the job, called by the workers. The slave cache
+ * is shared by all of them, so only one at a time may read slaves.
+ */
+static void send_batch(void *data, const scan_slave *slaves, int slaves_count, int dirs_count)
+{
+	scan_task *task = data;
+	scan_batch *batch = os_alloc(sizeof(scan_batch) + sizeof(scan_found) * slaves_count);
+	int i;
+
+	if (batch == NULL)
+	{
+		task->out_of_memory = 1;
+		task->job.cancel = 1;
+		return;
+	}
+
+	batch->message.mn_Length = sizeof(scan_batch);
+	batch->dirs_count = dirs_count;
+	batch->found_count = slaves_count;
+
+	for (i = 0; i < slaves_count; i++)
+	{
+		const slave_info *info;
+
+		strcpy(batch->found[i].path, slaves[i].path);
+
+		// The checksums find the moved games, so the slaves are read even without the titles
+		ObtainSemaphore(&task->slaves_lock);
+		if ((info = slave_cache_get(&task->slaves, slaves[i].path)) && task->read_titles)
+			strcpy(batch->found[i].title, info->title);
+		ReleaseSemaphore(&task->slaves_lock);
+	}
+
+	PutMsg(task->port, &batch->message);
+}
+
+static void scan_task_run(void *data)
+{
+	scan_task *task = data;
+
+	SetTaskPri(FindTask(NULL), SCAN_TASK_PRIORITY);
+
+	task->job.cache = &task->cache;
+	task->scanned = scan_run(&task->job);
+	scan_cache_free(&task->cache);
+	task->job.cache = NULL;
+
+	PutMsg(task->port, &task->done->message);
+}
+
+/*
+ * Starts the scan of task->job. Returns 0 if it could not be started.
+ * Once it started, scan_task_end() has to be called after the batch
+ * marked as done arrives.
+ */
+int scan_task_start(scan_task *task)
+{
+	task->expected_dirs = 0;
+	task->scanned = 0;
+	task->out_of_memory = 0;
+	task->slave_hits = 0;
+	task->slave_misses = 0;
+	task->job.cancel = 0;
+	task->job.progress = send_batch;
+	task->job.progress_data = task;
+	memset(&task->slaves, 0, sizeof(task->slaves));
+	InitSemaphore(&task->slaves_lock);
+
+	// The last batch is allocated now, so the end of the scan is always sent
+	if ((task->done = os_alloc(sizeof(scan_batch))) == NULL)
+		return 0;
+
+	// Directories that did not change since the last scan are not read again
+	task->cache.dirs = NULL;
+	task->cache.count = 0;
+	if (!task->full_rescan)
+		scan_cache_load(&task->cache, task->scan_cache_file);
+	task->expected_dirs = task->cache.count;
+
+	// The slave headers are only read once, unless the slave changes
+	slave_cache_load(&task->slaves, task->slave_cache_file);
+
+	task->done->message.mn_Length = sizeof(scan_batch);
+	task->done->done = 1;
+
+	if ((task->port = CreateMsgPort()))
+	{
+		if ((task->thread = os_thread_start("iGame scan", scan_task_run, task)))
+			return 1;
+
+		DeleteMsgPort(task->port);
+		task->port = NULL;
+	}
+
+	scan_cache_free(&task->cache);
+	slave_cache_free(&task->slaves);
+	os_free(task->done);
+	task->done = NULL;
+	return 0;
+}
+
+/*
+ * The signal the batches arrive with, or 0 if there is no scan
+ */
+ULONG scan_task_signal(const scan_task *task)
+{
+	return task->port ? 1UL << task->port->mp_SigBit : 0;
+}
+
+scan_batch *scan_task_next(scan_task *task)
+{
+	return task->port ? (scan_batch *)GetMsg(task->port) : NULL;
+}
+
+void scan_task_free_batch(scan_task *task, scan_batch *batch)
+{
+	if (batch != task->done)
+		os_free(batch);
+}
+
+/*
+ * Asks the scan to stop. It still ends with a batch marked as done.
+ */
+void scan_task_stop(scan_task *task)
+{
+	task->job.cancel = 1;
+}
+
+/*
+ * Waits for the scan process to exit, throws away the batches that
+ * were not taken and saves the caches. The results have to be freed
+ * with scan_task_free().
+ */
+void scan_task_end(scan_task *task)
+{
+	scan_batch *batch;
+
+	if (task->port == NULL)
+		return;
+
+	os_thread_wait(task->thread);
+	task->thread = NULL;
+
+	while ((batch = (scan_batch *)GetMsg(task->port)))
+		scan_task_free_batch(task, batch);
+
+	// A stopped scan did not see every directory
+	if (task->scanned && !task->job.cancel)
+		scan_cache_save(&task->job.new_cache, task->scan_cache_file);
+
+	// The headers are kept for the checksums, until scan_task_free(). The
+	// slaves a whole scan did not find are gone, so they are not saved.
+	slave_cache_save(&task->slaves, task->slave_cache_file, task->full_rescan && task->scanned && !task->job.cancel);
+	task->slave_hits = task->slaves.hits;
+	task->slave_misses = task->slaves.misses;
+
+	DeleteMsgPort(task->port);
+	task->port = NULL;
+	os_free(task->done);
+	task->done = NULL;
+}
+
+/*
+ * The checksum of a slave the scan read, or of one that an earlier
+ * scan read and is gone now. Returns 0 if it is not known. Only safe
+ * after scan_task_end().
+ */
+unsigned long scan_task_slave_crc(const scan_task *task, const char *path)
+{
+	const slave_info *info = slave_cache_find(&task->slaves, path);
+
+	return info ? info->crc : 0;
+}
+
+void scan_task_free(scan_task *task)
+{
+	scan_free(&task->job);
+	slave_cache_free(&task->slaves);
+}
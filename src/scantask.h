@@ -0,0 +1,85 @@
+/*
+  scantask.h
+  Background repository scan header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SCAN_TASK_H
+#define _SCAN_TASK_H
+
+#include <exec/ports.h>
+#include <exec/semaphores.h>
+
+#include "scanner.h"
+#include "slavefuncs.h"
+
+typedef struct scan_found
+{
+	char path[SCAN_PATH_SIZE];
+	char title[SLAVE_TITLE_SIZE]; /* empty if it was not read */
+} scan_found;
+
+/*
+ * Sent by the scan to the task that started it, with what was found
+ * since the last one. The last batch of a scan is marked as done.
+ */
+typedef struct scan_batch
+{
+	struct Message message;
+	int done;
+	int dirs_count;
+	int found_count;
+	scan_found found[1];
+} scan_batch;
+
+typedef struct scan_task
+{
+	/* filled in by the caller, with the job inputs */
+	scan_job job;
+	int full_rescan;
+	int read_titles;
+	const char *scan_cache_file;
+	const char *slave_cache_file;
+
+	/* filled in by the scan, safe to read once a batch arrived, the counts of the slaves after scan_task_end() */
+	int expected_dirs;   /* directories in the scan cache, 0 without one */
+	int scanned;         /* scan_run() succeeded */
+	int out_of_memory;   /* a batch could not be sent */
+	int slave_hits;
+	int slave_misses;
+
+	/* private */
+	struct MsgPort *port;
+	os_thread *thread;
+	scan_batch *done;
+	struct SignalSemaphore slaves_lock;
+	slave_cache slaves;
+	scan_cache cache;
+} scan_task;
+
+int scan_task_start(scan_task *);
+ULONG scan_task_signal(const scan_task *);
+scan_batch *scan_task_next(scan_task *);
+void scan_task_free_batch(scan_task *, scan_batch *);
+void scan_task_stop(scan_task *);
+void scan_task_end(scan_task *);
+unsigned long scan_task_slave_crc(const scan_task *, const char *);
+void scan_task_free(scan_task *);
+
+#endif
@@ -0,0 +1,496 @@
+/*
+  screenshot.c
+  Screenshot decoding and cache source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * A screenshot is read row by row, scaled down to fit the side panel
+ * by averaging the pixels each new pixel covers, and reduced to 256
+ * colors with a median cut, so it takes a byte for every pixel shown.
+ * The cache keeps the screenshots shown last, within a budget, so
+ * going back to a game doesn't read and scale its picture again.
+ * Only plain C and the os_ calls, so it runs on a host too.
+ */
+
+/* ANSI C */
+#include <string.h>
+
+#include "osfuncs.h"
+#include "screenshot.h"
+
+/* The colors are counted with 5 bits for each of red, green and blue */
+#define HISTOGRAM_SIZE 32768
+#define COLOR_BIN(r, g, b) ((unsigned long)(r) << 10 | (unsigned long)(g) << 5 | (unsigned long)(b))
+
+/* A box of bins in the color space, that becomes a color of the palette */
+typedef struct color_box
+{
+	int low[3], high[3];    /* red, green and blue, 0 to 31 */
+	unsigned long count;    /* of the pixels in it */
+} color_box;
+
+/*
+ * Shrinks the box to the bins that have pixels, and counts them
+ */
+static void shrink_box(color_box *box, const unsigned long *histogram)
+{
+	int low[3] = { 31, 31, 31 }, high[3] = { 0, 0, 0 };
+	int c[3], i;
+
+	box->count = 0;
+	for (c[0] = box->low[0]; c[0] <= box->high[0]; c[0]++)
+		for (c[1] = box->low[1]; c[1] <= box->high[1]; c[1]++)
+			for (c[2] = box->low[2]; c[2] <= box->high[2]; c[2]++)
+			{
+				const unsigned long count = histogram[COLOR_BIN(c[0], c[1], c[2])];
+
+				if (count == 0)
+					continue;
+
+				box->count += count;
+				for (i = 0; i < 3; i++)
+				{
+					if (c[i] < low[i])
+						low[i] = c[i];
+					if (c[i] > high[i])
+						high[i] = c[i];
+				}
+			}
+
+	if (box->count)
+	{
+		memcpy(box->low, low, sizeof(low));
+		memcpy(box->high, high, sizeof(high));
+	}
+}
+
+/*
+ * Splits the box across its longest side, where half of its pixels are
+ * on either side. Returns 0 if it is a single bin.
+ */
+static int split_box(color_box *box, color_box *other, const unsigned long *histogram)
+{
+	unsigned long slices[32] = { 0 }, sum;
+	int axis = 0, c[3], i, middle;
+
+	for (i = 1; i < 3; i++)
+	{
+		if (box->high[i] - box->low[i] > box->high[axis] - box->low[axis])
+			axis = i;
+	}
+	if (box->high[axis] == box->low[axis])
+		return 0;
+
+	for (c[0] = box->low[0]; c[0] <= box->high[0]; c[0]++)
+		for (c[1] = box->low[1]; c[1] <= box->high[1]; c[1]++)
+			for (c[2] = box->low[2]; c[2] <= box->high[2]; c[2]++)
+				slices[c[axis]] += histogram[COLOR_BIN(c[0], c[1], c[2])];
+
+	middle = box->low[axis];
+	sum = slices[middle];
+	while (middle < box->high[axis] - 1 && sum < box->count / 2)
+		sum += slices[++middle];
+
+	*other = *box;
+	box->high[axis] = middle;
+	other->low[axis] = middle + 1;
+	shrink_box(box, histogram);
+	shrink_box(other, histogram);
+
+	return 1;
+}
+
+/*
+ * Makes the palette of the image from the colors of its pixels, three
+ * bytes each, and the pixels from the palette. The histogram is used
+ * for the counts first, then to map the bins to the colors, and last
+ * to add up the pixels of every color.
+ */
+static void reduce_colors(screenshot_image *image, const unsigned char *rgb, unsigned long *histogram)
+{
+	color_box boxes[SCREENSHOT_COLORS];
+	const unsigned long pixels = (unsigned long)image->width * image->height;
+	unsigned long i;
+	int count = 1, c[3];
+
+	for (i = 0; i < pixels; i++)
+		histogram[COLOR_BIN(rgb[i * 3] >> 3, rgb[i * 3 + 1] >> 3, rgb[i * 3 + 2] >> 3)]++;
+
+	boxes[0].low[0] = boxes[0].low[1] = boxes[0].low[2] = 0;
+	boxes[0].high[0] = boxes[0].high[1] = boxes[0].high[2] = 31;
+	shrink_box(&boxes[0], histogram);
+
+	// The box with the most pixels is split next, until there are enough colors
+	while (count < SCREENSHOT_COLORS)
+	{
+		int largest = -1, n;
+
+		for (n = 0; n < count; n++)
+		{
+			const color_box *box = &boxes[n];
+
+			if ((box->low[0] != box->high[0] || box->low[1] != box->high[1] || box->low[2] != box->high[2])
+				&& (largest == -1 || box->count > boxes[largest].count))
+				largest = n;
+		}
+
+		if (largest == -1 || !split_box(&boxes[largest], &boxes[count], histogram))
+			break;
+		count++;
+	}
+
+	// The boxes don't overlap, so the counts can go now
+	for (i = 0; i < (unsigned long)count; i++)
+	{
+		const color_box *box = &boxes[i];
+
+		for (c[0] = box->low[0]; c[0] <= box->high[0]; c[0]++)
+			for (c[1] = box->low[1]; c[1] <= box->high[1]; c[1]++)
+				for (c[2] = box->low[2]; c[2] <= box->high[2]; c[2]++)
+					histogram[COLOR_BIN(c[0], c[1], c[2])] = i;
+	}
+
+	for (i = 0; i < pixels; i++)
+		image->pixels[i] = histogram[COLOR_BIN(rgb[i * 3] >> 3, rgb[i * 3 + 1] >> 3, rgb[i * 3 + 2] >> 3)];
+
+	// Every color is the average of the pixels it stands for, so up to 256 colors stay as they were
+	memset(histogram, 0, sizeof(unsigned long) * SCREENSHOT_COLORS * 4);
+	for (i = 0; i < pixels; i++)
+	{
+		unsigned long *sum = &histogram[image->pixels[i] * 4];
+
+		sum[0] += rgb[i * 3];
+		sum[1] += rgb[i * 3 + 1];
+		sum[2] += rgb[i * 3 + 2];
+		sum[3]++;
+	}
+
+	image->colors = count;
+	for (i = 0; i < (unsigned long)count; i++)
+	{
+		const unsigned long *sum = &histogram[i * 4];
+		const unsigned long half = sum[3] / 2;
+
+		image->palette[i] = sum[3] == 0 ? 0
+			: (sum[0] + half) / sum[3] << 16 | (sum[1] + half) / sum[3] << 8 | (sum[2] + half) / sum[3];
+	}
+}
+
+/*
+ * The size that fits in the side panel keeping the aspect of the
+ * picture. Smaller pictures keep their size, the side panel scales
+ * them up when it shows them.
+ */
+static void fit_size(const int width, const int height, const int max_width, const int max_height,
+	int *fit_width, int *fit_height)
+{
+	*fit_width = width;
+	*fit_height = height;
+
+	if (max_width <= 0 || max_height <= 0 || (width <= max_width && height <= max_height))
+		return;
+
+	if ((unsigned long)width * max_height > (unsigned long)height * max_width)
+	{
+		*fit_width = max_width;
+		*fit_height = (int)((unsigned long)height * max_width / width);
+	}
+	else
+	{
+		*fit_height = max_height;
+		*fit_width = (int)((unsigned long)width * max_height / height);
+	}
+
+	if (*fit_width < 1)
+		*fit_width = 1;
+	if (*fit_height < 1)
+		*fit_height = 1;
+}
+
+/*
+ * Scales the rows of the picture down to the pixels of the image,
+ * three bytes each, every one the average of the pixels it covers.
+ * Returns 0 if a row can't be read, or it was stopped.
+ */
+static int scale_picture(os_picture *picture, const int width, const int height,
+	const int fit_width, const int fit_height, unsigned char *rgb, volatile const int *stop)
+{
+	unsigned char *row = os_alloc((size_t)width * 4);
+	unsigned long *sums = os_alloc(sizeof(unsigned long) * fit_width * 3);
+	int *starts = os_alloc(sizeof(int) * (fit_width + 1));
+	int result = row && sums && starts;
+	int x, y, dx, dy, i;
+
+	for (dx = 0; result && dx <= fit_width; dx++)
+		starts[dx] = (int)((unsigned long)dx * width / fit_width);
+
+	for (dy = 0; result && dy < fit_height; dy++)
+	{
+		const int top = (int)((unsigned long)dy * height / fit_height);
+		const int bottom = (int)((unsigned long)(dy + 1) * height / fit_height);
+
+		if (stop && *stop)
+		{
+			result = 0;
+			break;
+		}
+
+		memset(sums, 0, sizeof(unsigned long) * fit_width * 3);
+		for (y = top; result && y < bottom; y++)
+		{
+			if (!(result = os_read_picture_row(picture, y, row)))
+				break;
+
+			for (dx = 0; dx < fit_width; dx++)
+			{
+				for (x = starts[dx]; x < starts[dx + 1]; x++)
+				{
+					for (i = 0; i < 3; i++)
+						sums[dx * 3 + i] += row[x * 4 + 1 + i];
+				}
+			}
+		}
+
+		for (dx = 0; result && dx < fit_width; dx++)
+		{
+			const unsigned long area = (unsigned long)(starts[dx + 1] - starts[dx]) * (bottom - top);
+
+			for (i = 0; i < 3; i++)
+				rgb[((unsigned long)dy * fit_width + dx) * 3 + i] = (sums[dx * 3 + i] + area / 2) / area;
+		}
+	}
+
+	os_free(starts);
+	os_free(sums);
+	os_free(row);
+
+	return result;
+}
+
+/*
+ * Reads the picture at the path and makes an image of it that fits in
+ * the given size. Setting what stop points at, if not NULL, stops it
+ * between two rows. Returns NULL if it is not a picture, there is no
+ * memory or it was stopped.
+ */
+screenshot_image *screenshot_load(const char *path, const int max_width, const int max_height,
+	volatile const int *stop)
+{
+	int width, height, fit_width, fit_height;
+	os_picture *picture = os_open_picture(path, &width, &height);
+	screenshot_image *image;
+	unsigned long *histogram;
+	unsigned char *rgb;
+	int result;
+
+	if (picture == NULL)
+		return NULL;
+
+	fit_size(width, height, max_width, max_height, &fit_width, &fit_height);
+
+	image = os_alloc(sizeof(screenshot_image));
+	rgb = os_alloc((size_t)fit_width * fit_height * 3);
+	histogram = os_alloc(sizeof(unsigned long) * HISTOGRAM_SIZE);
+	result = image && rgb && histogram
+		&& (image->pixels = os_alloc((size_t)fit_width * fit_height)) != NULL;
+
+	if (result)
+	{
+		image->width = fit_width;
+		image->height = fit_height;
+		result = scale_picture(picture, width, height, fit_width, fit_height, rgb, stop);
+	}
+
+	if (result)
+		reduce_colors(image, rgb, histogram);
+
+	os_free(histogram);
+	os_free(rgb);
+	os_close_picture(picture);
+
+	if (!result)
+	{
+		screenshot_free(image);
+		return NULL;
+	}
+
+	return image;
+}
+
+void screenshot_free(screenshot_image *image)
+{
+	if (image == NULL)
+		return;
+
+	os_free(image->pixels);
+	os_free(image);
+}
+
+/*
+ * The memory the image takes, to count it against the budget
+ */
+unsigned long screenshot_size(const screenshot_image *image)
+{
+	return sizeof(screenshot_image) + (unsigned long)image->width * image->height;
+}
+
+void screenshot_cache_init(screenshot_cache *cache, const unsigned long budget)
+{
+	memset(cache, 0, sizeof(screenshot_cache));
+	cache->budget = budget;
+}
+
+static int find_entry(const screenshot_cache *cache, const char *path, const int width, const int height)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+	{
+		const screenshot_entry *entry = &cache->entries[i];
+
+		if (entry->width == width && entry->height == height && !strcmp(entry->path, path))
+			return i;
+	}
+
+	return -1;
+}
+
+static void remove_entry(screenshot_cache *cache, const int index)
+{
+	screenshot_entry *entry = &cache->entries[index];
+
+	cache->used_size -= screenshot_size(entry->image);
+	screenshot_free(entry->image);
+	os_free(entry->path);
+
+	*entry = cache->entries[--cache->count];
+}
+
+/*
+ * Returns the image of the picture at the path for the side panel of
+ * the given size, if it is in the cache. The image belongs to the
+ * cache, and is good until something else is added to it.
+ */
+screenshot_image *screenshot_cache_get(screenshot_cache *cache, const char *path, const int width, const int height)
+{
+	const int index = find_entry(cache, path, width, height);
+
+	if (index == -1)
+	{
+		cache->misses++;
+		return NULL;
+	}
+
+	cache->hits++;
+	cache->entries[index].used = ++cache->clock;
+
+	return cache->entries[index].image;
+}
+
+/*
+ * Tells if the picture at the path is in the cache, without counting
+ * it as used
+ */
+int screenshot_cache_has(const screenshot_cache *cache, const char *path, const int width, const int height)
+{
+	return find_entry(cache, path, width, height) != -1;
+}
+
+/*
+ * Keeps the image in the cache, making room for it by letting go of
+ * the ones used the longest time ago. The image belongs to the cache
+ * from now on, and is freed at once if it doesn't fit in the budget.
+ */
+void screenshot_cache_add(screenshot_cache *cache, const char *path, const int width, const int height,
+	screenshot_image *image)
+{
+	const unsigned long size = screenshot_size(image);
+	const int index = find_entry(cache, path, width, height);
+	screenshot_entry *entry;
+	char *copy;
+
+	if (index != -1)
+		remove_entry(cache, index);
+
+	if (size > cache->budget || (copy = os_alloc(strlen(path) + 1)) == NULL)
+	{
+		screenshot_free(image);
+		return;
+	}
+
+	screenshot_cache_trim(cache, cache->budget - size);
+
+	if (cache->count == cache->size)
+	{
+		const int new_size = cache->size ? cache->size * 2 : 16;
+		screenshot_entry *entries = os_alloc(sizeof(screenshot_entry) * new_size);
+
+		if (entries == NULL)
+		{
+			os_free(copy);
+			screenshot_free(image);
+			return;
+		}
+
+		if (cache->count)
+			memcpy(entries, cache->entries, sizeof(screenshot_entry) * cache->count);
+		os_free(cache->entries);
+		cache->entries = entries;
+		cache->size = new_size;
+	}
+
+	strcpy(copy, path);
+	entry = &cache->entries[cache->count++];
+	entry->path = copy;
+	entry->width = width;
+	entry->height = height;
+	entry->image = image;
+	entry->used = ++cache->clock;
+	cache->used_size += size;
+}
+
+/*
+ * Lets go of the images used the longest time ago, until the rest
+ * take no more than size bytes. 0 empties the cache.
+ */
+void screenshot_cache_trim(screenshot_cache *cache, const unsigned long size)
+{
+	while (cache->used_size > size && cache->count > 0)
+	{
+		int oldest = 0, i;
+
+		for (i = 1; i < cache->count; i++)
+		{
+			if (cache->entries[i].used < cache->entries[oldest].used)
+				oldest = i;
+		}
+
+		remove_entry(cache, oldest);
+	}
+}
+
+void screenshot_cache_free(screenshot_cache *cache)
+{
+	while (cache->count > 0)
+		remove_entry(cache, cache->count - 1);
+
+	os_free(cache->entries);
+	screenshot_cache_init(cache, cache->budget);
+}
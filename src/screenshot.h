@@ -0,0 +1,67 @@
+/*
+  screenshot.h
+  Screenshot decoding and cache header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SCREENSHOT_H
+#define _SCREENSHOT_H
+
+#include "osfuncs.h"
+
+#define SCREENSHOT_COLORS 256
+
+/* A screenshot scaled to fit the side panel, in up to 256 colors */
+typedef struct screenshot_image
+{
+	unsigned short width, height;
+	unsigned short colors;
+	unsigned long palette[SCREENSHOT_COLORS];   /* 0x00RRGGBB */
+	unsigned char *pixels;                      /* one byte each, row after row */
+} screenshot_image;
+
+typedef struct screenshot_entry
+{
+	char *path;               /* of the picture */
+	int width, height;        /* of the side panel it was scaled for */
+	screenshot_image *image;
+	unsigned long used;       /* by the clock of the cache, the oldest one goes first */
+} screenshot_entry;
+
+typedef struct screenshot_cache
+{
+	unsigned long budget;     /* in bytes */
+	unsigned long used_size;
+	screenshot_entry *entries;
+	int count, size;
+	unsigned long clock;
+	unsigned long hits, misses;
+} screenshot_cache;
+
+screenshot_image *screenshot_load(const char *, int, int, volatile const int *);
+void screenshot_free(screenshot_image *);
+unsigned long screenshot_size(const screenshot_image *);
+void screenshot_cache_init(screenshot_cache *, unsigned long);
+screenshot_image *screenshot_cache_get(screenshot_cache *, const char *, int, int);
+int screenshot_cache_has(const screenshot_cache *, const char *, int, int);
+void screenshot_cache_add(screenshot_cache *, const char *, int, int, screenshot_image *);
+void screenshot_cache_trim(screenshot_cache *, unsigned long);
+void screenshot_cache_free(screenshot_cache *);
+
+#endif
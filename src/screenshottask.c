@@ -0,0 +1,141 @@
+/*
+  screenshottask.c
+  Background screenshot reading source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Reads a screenshot on a process of its own, below the priority of
+ * the GUI, so going through the games list doesn't wait for pictures
+ * to be decoded. The thumbnail is taken from the pack if it is there
+ * and up to date, or scaled from the picture and added to it. When it
+ * is done, it sends a message to the port of the task that started it.
+ */
+
+/* Prototypes */
+#if defined(__amigaos4__)
+#include <proto/exec.h>
+#else
+#include <clib/exec_protos.h>
+#endif
+
+/* ANSI C */
+#include <string.h>
+
+#include "osfuncs.h"
+#include "screenshot.h"
+#include "thumbpack.h"
+#include "screenshottask.h"
+
+#define SCREENSHOT_TASK_PRIORITY -1
+
+static void screenshot_task_run(void *data)
+{
+	screenshot_task *task = data;
+	const unsigned long start_time = os_milliseconds();
+	unsigned long size;
+	os_date date;
+	int dated;
+
+	SetTaskPri(FindTask(NULL), SCREENSHOT_TASK_PRIORITY);
+
+	dated = task->pack && os_file_info(task->path, &size, &date);
+	if (dated)
+		task->image = thumb_pack_get(task->pack, task->path, &date);
+
+	if (task->image == NULL && !task->stop)
+	{
+		task->image = screenshot_load(task->path, task->width, task->height, &task->stop);
+		if (task->image && dated)
+			thumb_pack_add(task->pack, task->path, &date, task->image);
+	}
+
+	task->milliseconds = os_milliseconds() - start_time;
+
+	PutMsg(task->port, &task->done);
+}
+
+/*
+ * Starts reading the screenshot of the task. Returns 0 if it could not
+ * be started. Once it started, screenshot_task_ended() has to be called
+ * when its signal arrives, or screenshot_task_end() to stop it.
+ */
+int screenshot_task_start(screenshot_task *task)
+{
+	task->image = NULL;
+	task->milliseconds = 0;
+	task->stop = 0;
+	memset(&task->done, 0, sizeof(task->done));
+	task->done.mn_Length = sizeof(struct Message);
+
+	if ((task->port = CreateMsgPort()))
+	{
+		if ((task->thread = os_thread_start("iGame screenshot", screenshot_task_run, task)))
+			return 1;
+
+		DeleteMsgPort(task->port);
+		task->port = NULL;
+	}
+
+	return 0;
+}
+
+/*
+ * The signal the screenshot arrives with, or 0 if none is read
+ */
+ULONG screenshot_task_signal(const screenshot_task *task)
+{
+	return task->port ? 1UL << task->port->mp_SigBit : 0;
+}
+
+static void screenshot_task_free(screenshot_task *task)
+{
+	os_thread_wait(task->thread);
+	task->thread = NULL;
+
+	DeleteMsgPort(task->port);
+	task->port = NULL;
+}
+
+/*
+ * Returns 1, and lets the task go, if it ended
+ */
+int screenshot_task_ended(screenshot_task *task)
+{
+	if (task->port == NULL || GetMsg(task->port) == NULL)
+		return 0;
+
+	screenshot_task_free(task);
+	return 1;
+}
+
+/*
+ * Stops reading the screenshot and waits for the task to end. An image
+ * it finished anyway is left for the caller to free.
+ */
+void screenshot_task_end(screenshot_task *task)
+{
+	if (task->port == NULL)
+		return;
+
+	task->stop = 1;
+	WaitPort(task->port);
+	GetMsg(task->port);
+	screenshot_task_free(task);
+}
@@ -0,0 +1,59 @@
+/*
+  screenshottask.h
+  Background screenshot reading header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SCREENSHOT_TASK_H
+#define _SCREENSHOT_TASK_H
+
+#include <exec/ports.h>
+
+#include "osfuncs.h"
+#include "screenshot.h"
+#include "thumbpack.h"
+
+#define SCREENSHOT_PATH_SIZE 256
+
+typedef struct screenshot_task
+{
+	/* filled in by the caller, the pack is not used by anyone else until the task ended */
+	thumb_pack *pack;             /* NULL to always read the picture */
+	char path[SCREENSHOT_PATH_SIZE];
+	int width, height;            /* the image has to fit in */
+
+	/* filled in by the task, safe to read once it ended */
+	screenshot_image *image;      /* NULL if it could not be read or it was stopped, freed by the caller */
+	unsigned long milliseconds;   /* how long it took */
+
+	/* set to stop it, the image it reads is not wanted any more */
+	volatile int stop;
+
+	/* private */
+	struct MsgPort *port;
+	os_thread *thread;
+	struct Message done;
+} screenshot_task;
+
+int screenshot_task_start(screenshot_task *);
+ULONG screenshot_task_signal(const screenshot_task *);
+int screenshot_task_ended(screenshot_task *);
+void screenshot_task_end(screenshot_task *);
+
+#endif
@@ -0,0 +1,321 @@
+/*
+  slavefuncs.c
+  WHDLoad slave functions source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ANSI C */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osfuncs.h"
+#include "crc32.h"
+#include "slaveheader.h"
+#include "slavefuncs.h"
+
+#define SLAVE_READ_SIZE 2048
+#define SLAVE_MAX_SIZE 262144
+#define CACHE_HEADER "iGame slave cache 2\n"
+
+/*
+ * A name may end with a line break. Returns 0 if it does not end
+ * within the data.
+ */
+static int copy_title(char *title, const unsigned char *data, const long length, const long position)
+{
+	const int ended = slave_string(data, length, position, title, SLAVE_TITLE_SIZE);
+
+	title[strcspn(title, "\n")] = '\0';
+	return ended;
+}
+
+/*
+ * Reads the whole slave in one go, for the header, the name and the
+ * checksum of the file. Slaves are a few KB, so only the start of a
+ * file bigger than SLAVE_MAX_SIZE is read, without a checksum, and its
+ * name may need a second read. Returns 0 if the file is not a slave.
+ * Slaves older than version 10 have no name, so the title is left empty.
+ */
+int slave_read(const char *path, const unsigned long size, slave_info *info)
+{
+	const unsigned long buffer_size = size > SLAVE_MAX_SIZE || size < SLAVE_READ_SIZE ? SLAVE_READ_SIZE : size;
+	unsigned char *buffer = os_alloc(buffer_size);
+	slave_header header;
+	long length;
+	int result = 0;
+
+	memset(info, 0, sizeof(slave_info));
+	if (buffer == NULL)
+		return 0;
+
+	length = os_read_file(path, 0, buffer, buffer_size);
+	if (slave_parse(buffer, length, &header))
+	{
+		const int whole_file = (unsigned long)length == size;
+
+		if (whole_file)
+			info->crc = crc32_update(0, buffer, length);
+
+		info->version = header.version;
+		info->flags = header.flags;
+		info->base_mem_size = header.base_mem_size;
+		info->exp_mem = header.exp_mem;
+
+		// The name may be further than the part of a big slave that was read
+		if (header.name && !copy_title(info->title, buffer, length, header.name) && !whole_file)
+		{
+			const long name_length = os_read_file(path, header.name, buffer, SLAVE_TITLE_SIZE);
+			if (name_length > 0)
+				copy_title(info->title, buffer, name_length, 0);
+		}
+		result = 1;
+	}
+
+	os_free(buffer);
+	return result;
+}
+
+/*
+ * Returns the position of the path in the cache, or where it
+ * should be inserted if it is not there
+ */
+static int find_entry(const slave_cache *cache, const char *path, int *found)
+{
+	int low = 0, high = cache->count;
+
+	*found = 0;
+	while (low < high)
+	{
+		const int middle = (low + high) / 2;
+		const int compare = strcmp(cache->entries[middle]->path, path);
+
+		if (compare == 0)
+		{
+			*found = 1;
+			return middle;
+		}
+
+		if (compare < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+static slave_cache_entry *insert_entry(slave_cache *cache, const int index, const char *path)
+{
+	const size_t path_size = strlen(path) + 1;
+	slave_cache_entry *entry;
+
+	if (cache->count == cache->size)
+	{
+		const int size = cache->size ? cache->size * 2 : 256;
+		slave_cache_entry **entries = os_alloc(sizeof(slave_cache_entry *) * size);
+		if (entries == NULL)
+			return NULL;
+
+		if (cache->entries)
+		{
+			memcpy(entries, cache->entries, sizeof(slave_cache_entry *) * cache->count);
+			os_free(cache->entries);
+		}
+		cache->entries = entries;
+		cache->size = size;
+	}
+
+	if ((entry = os_alloc(sizeof(slave_cache_entry) + path_size)) == NULL)
+		return NULL;
+
+	entry->path = (char *)(entry + 1);
+	memcpy(entry->path, path, path_size);
+
+	memmove(cache->entries + index + 1, cache->entries + index, sizeof(slave_cache_entry *) * (cache->count - index));
+	cache->entries[index] = entry;
+	cache->count++;
+
+	return entry;
+}
+
+/*
+ * Returns the header of the slave, reading it only if it is not in
+ * the cache or the file changed since. Files that are not slaves are
+ * remembered as well, with an empty header. Returns NULL if the file
+ * can't be found.
+ */
+const slave_info *slave_cache_get(slave_cache *cache, const char *path)
+{
+	slave_cache_entry *entry;
+	unsigned long size;
+	os_date date;
+	int found, index;
+
+	if (!os_file_info(path, &size, &date))
+		return NULL;
+
+	index = find_entry(cache, path, &found);
+	if (found)
+	{
+		entry = cache->entries[index];
+		entry->seen = 1;
+		if (entry->size == size && entry->date.seconds == date.seconds && entry->date.fraction == date.fraction)
+		{
+			cache->hits++;
+			return &entry->info;
+		}
+	}
+	else if ((entry = insert_entry(cache, index, path)) == NULL)
+	{
+		return NULL;
+	}
+
+	cache->misses++;
+	cache->changed = 1;
+	entry->seen = 1;
+	entry->size = size;
+	entry->date = date;
+	slave_read(path, size, &entry->info);
+
+	return &entry->info;
+}
+
+/*
+ * Returns the header of a slave that is in the cache, without looking
+ * at the file, e.g. for a slave that is gone. NULL if it is not there.
+ */
+const slave_info *slave_cache_find(const slave_cache *cache, const char *path)
+{
+	int found;
+	const int index = find_entry(cache, path, &found);
+
+	return found ? &cache->entries[index]->info : NULL;
+}
+
+/*
+ * The cache file has two lines for every slave, one with the file
+ * size, the date, the header fields, the checksum and the path, and
+ * one with the title. Returns 0 if the file is missing or broken, and the cache
+ * is empty.
+ */
+int slave_cache_load(slave_cache *cache, const char *filename)
+{
+	char line[512], title[SLAVE_TITLE_SIZE + 2];
+	int result;
+	FILE *fp;
+
+	memset(cache, 0, sizeof(slave_cache));
+
+	if ((fp = fopen(filename, "r")) == NULL)
+		return 0;
+
+	result = fgets(line, sizeof(line), fp) && !strcmp(line, CACHE_HEADER);
+	while (result && fgets(line, sizeof(line), fp))
+	{
+		slave_cache_entry *entry;
+		unsigned long size, version, flags, base_mem_size, exp_mem, crc;
+		int offset = 0, found, index;
+		os_date date;
+
+		line[strcspn(line, "\n")] = '\0';
+		if (sscanf(line, "%lu %lu %lu %lu %lu %lu %lu %lx %n", &size, &date.seconds, &date.fraction,
+				&version, &flags, &base_mem_size, &exp_mem, &crc, &offset) < 8
+			|| offset == 0 || fgets(title, sizeof(title), fp) == NULL)
+		{
+			result = 0;
+			break;
+		}
+		title[strcspn(title, "\n")] = '\0';
+
+		// A title that does not fit was not written by slave_cache_save()
+		index = find_entry(cache, line + offset, &found);
+		if (strlen(title) >= SLAVE_TITLE_SIZE || found || (entry = insert_entry(cache, index, line + offset)) == NULL)
+		{
+			result = 0;
+			break;
+		}
+
+		entry->size = size;
+		entry->date = date;
+		entry->info.version = version;
+		entry->info.flags = flags;
+		entry->info.base_mem_size = base_mem_size;
+		entry->info.exp_mem = exp_mem;
+		entry->info.crc = crc;
+		strcpy(entry->info.title, title);
+	}
+
+	fclose(fp);
+
+	if (!result)
+		slave_cache_free(cache);
+
+	return result;
+}
+
+/*
+ * Saves the cache if anything was read since it was loaded. With
+ * seen_only, e.g. after a full scan, the slaves that were not looked
+ * up are left out of the file, but stay in the cache until it is freed.
+ */
+int slave_cache_save(slave_cache *cache, const char *filename, const int seen_only)
+{
+	int changed = cache->changed;
+	FILE *fp;
+	int i;
+
+	for (i = 0; seen_only && !changed && i < cache->count; i++)
+		changed = !cache->entries[i]->seen;
+
+	if (!changed)
+		return 1;
+
+	if ((fp = fopen(filename, "w")) == NULL)
+		return 0;
+
+	fputs(CACHE_HEADER, fp);
+	for (i = 0; i < cache->count; i++)
+	{
+		const slave_cache_entry *entry = cache->entries[i];
+
+		if (seen_only && !entry->seen)
+			continue;
+
+		fprintf(fp, "%lu %lu %lu %u %u %lu %lu %08lx %s\n%s\n", entry->size, entry->date.seconds, entry->date.fraction,
+			entry->info.version, entry->info.flags, entry->info.base_mem_size, entry->info.exp_mem,
+			entry->info.crc, entry->path, entry->info.title);
+	}
+
+	if (fclose(fp))
+		return 0;
+
+	cache->changed = 0;
+	return 1;
+}
+
+void slave_cache_free(slave_cache *cache)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+		os_free(cache->entries[i]);
+	os_free(cache->entries);
+	memset(cache, 0, sizeof(slave_cache));
+}
@@ -0,0 +1,68 @@
+/*
+  slavefuncs.h
+  WHDLoad slave functions header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SLAVE_FUNCS_H
+#define _SLAVE_FUNCS_H
+
+#include "osfuncs.h"
+
+#define SLAVE_TITLE_SIZE 100
+
+/* The parts of the slave header iGame uses */
+typedef struct slave_info
+{
+	unsigned short version;
+	unsigned short flags;
+	unsigned long base_mem_size;
+	unsigned long exp_mem;
+	unsigned long crc; /* CRC-32 of the whole file, 0 if it was not read */
+	char title[SLAVE_TITLE_SIZE];
+} slave_info;
+
+typedef struct slave_cache_entry
+{
+	char *path;
+	unsigned long size;
+	os_date date;
+	int seen; /* looked up since the cache was loaded */
+	slave_info info;
+} slave_cache_entry;
+
+/* The slaves read so far, sorted by path */
+typedef struct slave_cache
+{
+	slave_cache_entry **entries;
+	int count;
+	int size;
+	int changed;
+	int hits;
+	int misses;
+} slave_cache;
+
+int slave_read(const char *, unsigned long, slave_info *);
+int slave_cache_load(slave_cache *, const char *);
+int slave_cache_save(slave_cache *, const char *, int);
+void slave_cache_free(slave_cache *);
+const slave_info *slave_cache_get(slave_cache *, const char *);
+const slave_info *slave_cache_find(const slave_cache *, const char *);
+
+#endif
@@ -0,0 +1,141 @@
+/*
+  slaveheader.c
+  WHDLoad slave header parser source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Only plain C and no calls to the OS, so the helper tools can use
+ * it on any host. The fields are read byte by byte, so neither the
+ * endianness nor the struct padding of the host matter.
+ */
+
+/* ANSI C */
+#include <string.h>
+
+#include "slaveheader.h"
+
+/* The size of the slave structure up to the last field of a version */
+#define SLAVE_SIZE_V1 30
+#define SLAVE_SIZE_V4 32
+#define SLAVE_SIZE_V8 36
+#define SLAVE_SIZE_V10 42
+#define SLAVE_SIZE_V16 50
+#define SLAVE_SIZE_V17 52
+
+static unsigned short get_word(const unsigned char *p)
+{
+	return (unsigned short)((p[0] << 8) | p[1]);
+}
+
+static unsigned long get_long(const unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) | ((unsigned long)p[2] << 8) | p[3];
+}
+
+/* The fields that point into the slave are offsets from its start */
+static long get_position(const unsigned char *p)
+{
+	const unsigned short offset = get_word(p);
+
+	return offset ? SLAVE_HEADER_OFFSET + offset : 0;
+}
+
+/*
+ * Decodes the slave structure from the start of the file. A field is
+ * only read if the version of the slave has it and it is within the
+ * length. Returns 0 if the data is not a slave.
+ */
+int slave_parse(const unsigned char *data, const long length, slave_header *header)
+{
+	const unsigned char *slave = data + SLAVE_HEADER_OFFSET;
+	const long size = length - SLAVE_HEADER_OFFSET;
+
+	memset(header, 0, sizeof(slave_header));
+
+	if (size < SLAVE_SIZE_V1 || memcmp(slave + 4, "WHDLOADS", 8))
+		return 0;
+
+	header->version = get_word(slave + 12);
+	header->flags = get_word(slave + 14);
+	header->base_mem_size = get_long(slave + 16);
+	header->exec_install = get_long(slave + 20);
+	header->game_loader = get_position(slave + 24);
+	header->current_dir = get_position(slave + 26);
+	header->dont_cache = get_position(slave + 28);
+
+	if (header->version >= 4 && size >= SLAVE_SIZE_V4)
+	{
+		header->key_debug = slave[30];
+		header->key_exit = slave[31];
+	}
+
+	if (header->version >= 8 && size >= SLAVE_SIZE_V8)
+		header->exp_mem = get_long(slave + 32);
+
+	if (header->version >= 10 && size >= SLAVE_SIZE_V10)
+	{
+		header->name = get_position(slave + 36);
+		header->copy = get_position(slave + 38);
+		header->info = get_position(slave + 40);
+	}
+
+	if (header->version >= 16 && size >= SLAVE_SIZE_V16)
+	{
+		header->kick_name = get_position(slave + 42);
+		header->kick_size = get_long(slave + 44);
+		header->kick_crc = get_word(slave + 48);
+	}
+
+	if (header->version >= 17 && size >= SLAVE_SIZE_V17)
+		header->config = get_position(slave + 50);
+
+	return 1;
+}
+
+/*
+ * Copies the string at a position of the data, as long as it fits.
+ * The byte -1 that WHDLoad uses for line breaks becomes '\n'.
+ * Returns 0 if the string does not end within the data, with the
+ * part that is there copied.
+ */
+int slave_string(const unsigned char *data, const long length, const long position, char *string, const size_t size)
+{
+	long i;
+	size_t copied = 0;
+	int ended = 0;
+
+	if (size == 0)
+		return 0;
+
+	for (i = position; i >= 0 && i < length; i++)
+	{
+		if (data[i] == '\0')
+		{
+			ended = 1;
+			break;
+		}
+
+		if (copied < size - 1)
+			string[copied++] = data[i] == 0xFF ? '\n' : (char)data[i];
+	}
+	string[copied] = '\0';
+
+	return ended;
+}
@@ -0,0 +1,67 @@
+/*
+  slaveheader.h
+  WHDLoad slave header parser header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SLAVE_HEADER_H
+#define _SLAVE_HEADER_H
+
+#include <stddef.h>
+
+/*
+ * A slave is an executable with a single hunk, so the slave
+ * structure starts right after the 32 bytes of the hunk header
+ */
+#define SLAVE_HEADER_OFFSET 32
+
+/* The kickstart CRC of a slave that supports more than one kickstart */
+#define SLAVE_KICK_LIST 0xFFFF
+
+/*
+ * The fields of the slave structure, decoded from big endian. The
+ * strings are given as positions in the file, 0 if the slave has none,
+ * to be read with slave_string(). The fields newer than the version
+ * of the slave are 0.
+ */
+typedef struct slave_header
+{
+	unsigned short version;
+	unsigned short flags;
+	unsigned long base_mem_size;
+	unsigned long exec_install;
+	long game_loader;
+	long current_dir;       /* string */
+	long dont_cache;
+	unsigned char key_debug; /* version 4 */
+	unsigned char key_exit;
+	unsigned long exp_mem;   /* version 8 */
+	long name;               /* version 10, strings */
+	long copy;
+	long info;
+	long kick_name;          /* version 16, string or list of kickstarts */
+	unsigned long kick_size;
+	unsigned short kick_crc;
+	long config;             /* version 17, string */
+} slave_header;
+
+int slave_parse(const unsigned char *, long, slave_header *);
+int slave_string(const unsigned char *, long, long, char *, size_t);
+
+#endif
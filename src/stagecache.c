@@ -0,0 +1,771 @@
+/*
+  stagecache.c
+  Game folder staging cache source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Games on a slow drive, like a CF card or a network volume, start
+ * faster from a copy of their folder on a fast one, usually RAM:. The
+ * copies are kept in a folder of their own, one numbered folder for
+ * every game, with an index file that tells which game each one is.
+ * A copy is used only while the date of the game folder is the same
+ * as when it was copied. When the copies don't fit in the budget, the
+ * ones used the longest time ago are deleted. The files the game wrote
+ * to its copy, like high scores and saved games, are copied back to
+ * the game folder when it ends. Only plain C and the os_ calls, so it
+ * runs on a host too.
+ */
+
+/* ANSI C */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osfuncs.h"
+#include "stagecache.h"
+
+#define STAGE_HEADER "iGame stage cache 1\n"
+#define STAGE_INDEX_NAME "iGame.stage"
+
+/* The digits of the largest number in the index and a space after them */
+#define STAGE_NUMBER_SIZE 21
+
+/* The files are copied in big blocks, a few reads for most of them */
+#define STAGE_BUFFER_SIZE 65536
+
+/* Game folders are not deep, anything deeper is not copied */
+#define STAGE_MAX_DEPTH 16
+
+static int join_path(char *path, const size_t size, const char *folder, const char *name)
+{
+	const size_t length = strlen(folder);
+	const int separator = length > 0 && folder[length - 1] != ':' && folder[length - 1] != '/';
+
+	return snprintf(path, size, separator ? "%s/%s" : "%s%s", folder, name) < (int)size;
+}
+
+static int copy_path(const stage_cache *cache, const unsigned long number, char *path, const size_t size)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), "%lu", number);
+	return join_path(path, size, cache->dir, name);
+}
+
+static int same_date(const os_date *a, const os_date *b)
+{
+	return a->seconds == b->seconds && a->fraction == b->fraction;
+}
+
+static int date_after(const os_date *a, const os_date *b)
+{
+	return a->seconds > b->seconds || (a->seconds == b->seconds && a->fraction > b->fraction);
+}
+
+static int folder_date(stage_cache *cache, const char *path, os_date *date)
+{
+	os_dir *dir = os_open_dir(path);
+	int result;
+
+	if (dir == NULL)
+		return 0;
+
+	result = os_dir_date(cache->reader, dir, date);
+	os_close_dir(dir);
+
+	return result;
+}
+
+/*
+ * Reads all the entries of a folder, as the reader can read only one
+ * folder at a time, and its subfolders are read before it is done.
+ * Returns 0 if the folder can't be read.
+ */
+static int read_folder(stage_cache *cache, const char *path, os_entry **entries, int *count)
+{
+	os_dir *dir = os_open_dir(path);
+	int size = 0, result = 1;
+
+	*entries = NULL;
+	*count = 0;
+	if (dir == NULL)
+		return 0;
+
+	while (result)
+	{
+		if (*count == size)
+		{
+			os_entry *more = os_alloc(sizeof(os_entry) * (size ? size * 2 : 16));
+
+			if (more == NULL)
+			{
+				result = 0;
+				break;
+			}
+			if (*entries)
+				memcpy(more, *entries, sizeof(os_entry) * size);
+			os_free(*entries);
+			*entries = more;
+			size = size ? size * 2 : 16;
+		}
+
+		if (!os_read_entry(cache->reader, dir, *entries + *count))
+			break;
+		(*count)++;
+	}
+	os_read_end(cache->reader);
+	os_close_dir(dir);
+
+	if (!result)
+	{
+		os_free(*entries);
+		*entries = NULL;
+		*count = 0;
+	}
+
+	return result;
+}
+
+/*
+ * Adds up the sizes of the files in a folder, stopping as soon as they
+ * don't fit in the budget
+ */
+static int measure_folder(stage_cache *cache, const char *path, const int depth, unsigned long *size)
+{
+	char entry_path[STAGE_PATH_SIZE];
+	os_entry *entries;
+	int count, i, result;
+
+	if (depth > STAGE_MAX_DEPTH || !read_folder(cache, path, &entries, &count))
+		return 0;
+
+	for (i = 0, result = 1; result && i < count && *size <= cache->budget; i++)
+	{
+		unsigned long file_size;
+		os_date date;
+
+		result = !cache->stop && join_path(entry_path, sizeof(entry_path), path, entries[i].name);
+		if (result && entries[i].is_dir)
+			result = measure_folder(cache, entry_path, depth + 1, size);
+		else if (result && os_file_info(entry_path, &file_size, &date))
+			*size += file_size;
+	}
+
+	os_free(entries);
+	return result;
+}
+
+/*
+ * Copies a file in blocks of the size of the buffer. A file that could
+ * not be copied to the end is deleted.
+ */
+static int copy_file(stage_cache *cache, const char *from, const char *to)
+{
+	os_file *source, *target;
+	long length;
+	int result = STAGE_OK;
+
+	if ((source = os_open_file(from, OS_FILE_READ)) == NULL)
+		return STAGE_FAILED;
+
+	if ((target = os_open_file(to, OS_FILE_WRITE)) == NULL)
+	{
+		os_close_file(source);
+		return STAGE_FAILED;
+	}
+
+	while (result == STAGE_OK && (length = os_read(source, cache->buffer, STAGE_BUFFER_SIZE)) != 0)
+	{
+		if (cache->stop)
+			result = STAGE_STOPPED;
+		else if (length < 0 || os_write(target, cache->buffer, length) != length)
+			result = STAGE_FAILED;
+		else
+			cache->copied += length;
+	}
+
+	os_close_file(source);
+	if (!os_close_file(target) && result == STAGE_OK)
+		result = STAGE_FAILED;
+
+	if (result != STAGE_OK)
+		os_delete(to);
+
+	return result;
+}
+
+static int copy_folder(stage_cache *cache, const char *from, const char *to, const int depth)
+{
+	char from_path[STAGE_PATH_SIZE], to_path[STAGE_PATH_SIZE];
+	os_entry *entries;
+	int count, i, result;
+
+	if (depth > STAGE_MAX_DEPTH || !os_make_dir(to) || !read_folder(cache, from, &entries, &count))
+		return STAGE_FAILED;
+
+	for (i = 0, result = STAGE_OK; result == STAGE_OK && i < count; i++)
+	{
+		if (!join_path(from_path, sizeof(from_path), from, entries[i].name)
+			|| !join_path(to_path, sizeof(to_path), to, entries[i].name))
+			result = STAGE_FAILED;
+		else if (entries[i].is_dir)
+			result = copy_folder(cache, from_path, to_path, depth + 1);
+		else
+			result = copy_file(cache, from_path, to_path);
+	}
+
+	os_free(entries);
+	return result;
+}
+
+static void delete_folder(stage_cache *cache, const char *path, const int depth)
+{
+	char entry_path[STAGE_PATH_SIZE];
+	os_entry *entries;
+	int count, i;
+
+	if (depth <= STAGE_MAX_DEPTH && read_folder(cache, path, &entries, &count))
+	{
+		for (i = 0; i < count; i++)
+		{
+			if (!join_path(entry_path, sizeof(entry_path), path, entries[i].name))
+				continue;
+
+			if (entries[i].is_dir)
+				delete_folder(cache, entry_path, depth + 1);
+			else
+				os_delete(entry_path);
+		}
+		os_free(entries);
+	}
+
+	os_delete(path);
+}
+
+/*
+ * Copies the files of the copy that changed after the date back to the
+ * game folder, along with the folders they are in
+ */
+static int sync_folder(stage_cache *cache, const char *copy, const char *source, const int depth, const os_date *since,
+	int *synced)
+{
+	char copy_entry[STAGE_PATH_SIZE], source_entry[STAGE_PATH_SIZE];
+	os_entry *entries;
+	int count, i, result;
+
+	if (depth > STAGE_MAX_DEPTH || !read_folder(cache, copy, &entries, &count))
+		return 0;
+
+	for (i = 0, result = 1; i < count; i++)
+	{
+		unsigned long size;
+		os_date date;
+
+		if (!join_path(copy_entry, sizeof(copy_entry), copy, entries[i].name)
+			|| !join_path(source_entry, sizeof(source_entry), source, entries[i].name))
+		{
+			result = 0;
+			continue;
+		}
+
+		if (entries[i].is_dir)
+		{
+			if (!os_make_dir(source_entry) || !sync_folder(cache, copy_entry, source_entry, depth + 1, since, synced))
+				result = 0;
+		}
+		else if (os_file_info(copy_entry, &size, &date) && date_after(&date, since))
+		{
+			if (copy_file(cache, copy_entry, source_entry) == STAGE_OK)
+				(*synced)++;
+			else
+				result = 0;
+		}
+	}
+
+	os_free(entries);
+	return result;
+}
+
+static int find_entry(const stage_cache *cache, const char *source)
+{
+	int i;
+
+	for (i = 0; i < cache->count; i++)
+	{
+		if (!strcmp(cache->entries[i]->source, source))
+			return i;
+	}
+
+	return -1;
+}
+
+static stage_entry *add_entry(stage_cache *cache, const char *source)
+{
+	const size_t source_size = strlen(source) + 1;
+	stage_entry *entry;
+
+	if (cache->count == cache->size)
+	{
+		const int size = cache->size ? cache->size * 2 : 16;
+		stage_entry **entries = os_alloc(sizeof(stage_entry *) * size);
+
+		if (entries == NULL)
+			return NULL;
+
+		if (cache->entries)
+			memcpy(entries, cache->entries, sizeof(stage_entry *) * cache->count);
+		os_free(cache->entries);
+		cache->entries = entries;
+		cache->size = size;
+	}
+
+	if ((entry = os_alloc(sizeof(stage_entry) + source_size)) == NULL)
+		return NULL;
+
+	entry->source = (char *)(entry + 1);
+	memcpy(entry->source, source, source_size);
+	cache->entries[cache->count++] = entry;
+	cache->changed = 1;
+
+	return entry;
+}
+
+/*
+ * Forgets a game, deleting its copy if asked to
+ */
+static void remove_entry(stage_cache *cache, const int index, const int delete_copy)
+{
+	stage_entry *entry = cache->entries[index];
+	char path[STAGE_PATH_SIZE];
+
+	if (delete_copy && copy_path(cache, entry->number, path, sizeof(path)))
+		delete_folder(cache, path, 0);
+
+	cache->used_size -= entry->size < cache->used_size ? entry->size : cache->used_size;
+	cache->entries[index] = cache->entries[--cache->count];
+	cache->changed = 1;
+	os_free(entry);
+}
+
+/*
+ * Deletes the copies used the longest time ago, until there is room for
+ * the size. The ones used since keep_since are kept, 0 keeps none.
+ * Returns 0 if there can't be room.
+ */
+static int make_room(stage_cache *cache, const unsigned long size, const unsigned long keep_since)
+{
+	while (cache->used_size + size > cache->budget)
+	{
+		int oldest = -1, i;
+
+		for (i = 0; i < cache->count; i++)
+		{
+			if ((keep_since == 0 || cache->entries[i]->used < keep_since)
+				&& (oldest < 0 || cache->entries[i]->used < cache->entries[oldest]->used))
+				oldest = i;
+		}
+
+		if (oldest < 0)
+			return 0;
+
+		remove_entry(cache, oldest, 1);
+	}
+
+	return 1;
+}
+
+/*
+ * The index is read and written with the os_ calls, like the copies,
+ * as it is saved by the staging process too. The numbers are parsed
+ * and formatted here for the same reason.
+ */
+static const char *parse_number(const char *text, unsigned long *value)
+{
+	if (*text < '0' || *text > '9')
+		return NULL;
+
+	for (*value = 0; *text >= '0' && *text <= '9'; text++)
+		*value = *value * 10 + (*text - '0');
+
+	return *text == ' ' ? text + 1 : NULL;
+}
+
+static char *format_number(char *text, unsigned long value)
+{
+	char digits[STAGE_NUMBER_SIZE];
+	int count = 0;
+
+	do
+	{
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	while (count)
+		*text++ = digits[--count];
+	*text++ = ' ';
+
+	return text;
+}
+
+/*
+ * The index has a line for every copy, with its number, its size, when
+ * it was last used, the dates of the game folder and of the copy, and
+ * the game folder. Copies that are gone, e.g. from RAM: after a reboot,
+ * are left out.
+ */
+static void load_index(stage_cache *cache)
+{
+	char path[STAGE_PATH_SIZE], *text, *line, *next;
+	unsigned long size;
+	os_date date;
+
+	if (!join_path(path, sizeof(path), cache->dir, STAGE_INDEX_NAME) || !os_file_info(path, &size, &date)
+		|| size < strlen(STAGE_HEADER) || (text = os_alloc(size + 1)) == NULL)
+		return;
+
+	if (os_read_file(path, 0, text, size) != (long)size || strncmp(text, STAGE_HEADER, strlen(STAGE_HEADER)))
+	{
+		os_free(text);
+		return;
+	}
+	text[size] = '\0';
+
+	for (line = text + strlen(STAGE_HEADER); *line; line = next)
+	{
+		unsigned long number, used, values[4];
+		os_date copy_folder_date;
+		stage_entry *entry;
+		const char *source;
+		int i;
+
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+
+		source = parse_number(line, &number);
+		source = source ? parse_number(source, &size) : NULL;
+		source = source ? parse_number(source, &used) : NULL;
+		for (i = 0; i < 4 && source; i++)
+			source = parse_number(source, &values[i]);
+		if (source == NULL || *source == '\0')
+			break;
+
+		if (find_entry(cache, source) >= 0 || !copy_path(cache, number, path, sizeof(path))
+			|| !folder_date(cache, path, &copy_folder_date))
+		{
+			cache->changed = 1;
+			continue;
+		}
+
+		if ((entry = add_entry(cache, source)) == NULL)
+			break;
+
+		entry->number = number;
+		entry->size = size;
+		entry->used = used;
+		entry->source_date.seconds = values[0];
+		entry->source_date.fraction = values[1];
+		entry->copy_date.seconds = values[2];
+		entry->copy_date.fraction = values[3];
+		cache->used_size += size;
+
+		if (used > cache->clock)
+			cache->clock = used;
+		if (number >= cache->next_number)
+			cache->next_number = number + 1;
+	}
+
+	os_free(text);
+}
+
+/*
+ * Deletes the numbered folders that are not in the index, left by a
+ * copy that did not finish
+ */
+static void remove_strays(stage_cache *cache)
+{
+	char path[STAGE_PATH_SIZE], *end;
+	os_entry *entries;
+	int count, i, j;
+
+	if (!read_folder(cache, cache->dir, &entries, &count))
+		return;
+
+	for (i = 0; i < count; i++)
+	{
+		const unsigned long number = strtoul(entries[i].name, &end, 10);
+
+		if (!entries[i].is_dir || *end != '\0' || end == entries[i].name)
+			continue;
+
+		for (j = 0; j < cache->count && cache->entries[j]->number != number; j++)
+			;
+
+		if (j == cache->count && join_path(path, sizeof(path), cache->dir, entries[i].name))
+			delete_folder(cache, path, 0);
+	}
+
+	os_free(entries);
+}
+
+/*
+ * Opens the cache in the folder, creating the folder if needed, with
+ * the budget in bytes. Copies that don't fit a smaller budget than
+ * before are deleted. Returns 0 if the folder can't be used.
+ */
+int stage_cache_open(stage_cache *cache, const char *dir, const unsigned long budget)
+{
+	memset(cache, 0, sizeof(stage_cache));
+
+	if (strlen(dir) == 0 || strlen(dir) >= sizeof(cache->dir) || !os_make_dir(dir))
+		return 0;
+
+	strcpy(cache->dir, dir);
+	cache->budget = budget;
+	cache->next_number = 1;
+	cache->buffer = os_alloc(STAGE_BUFFER_SIZE);
+	cache->reader = os_reader_alloc();
+
+	if (cache->buffer == NULL || cache->reader == NULL)
+	{
+		stage_cache_close(cache);
+		return 0;
+	}
+
+	load_index(cache);
+	remove_strays(cache);
+	make_room(cache, 0, 0);
+
+	return 1;
+}
+
+/*
+ * Saves the index if anything changed since it was loaded
+ */
+int stage_cache_save(stage_cache *cache)
+{
+	char path[STAGE_PATH_SIZE], *text, *end;
+	unsigned long size = strlen(STAGE_HEADER);
+	os_file *file;
+	int i, result = 0;
+
+	if (!cache->changed)
+		return 1;
+
+	if (!join_path(path, sizeof(path), cache->dir, STAGE_INDEX_NAME))
+		return 0;
+
+	/* seven numbers with a space after each, the folder and a new line */
+	for (i = 0; i < cache->count; i++)
+		size += 7 * STAGE_NUMBER_SIZE + strlen(cache->entries[i]->source) + 1;
+
+	if ((text = os_alloc(size)) == NULL)
+		return 0;
+
+	strcpy(text, STAGE_HEADER);
+	end = text + strlen(STAGE_HEADER);
+	for (i = 0; i < cache->count; i++)
+	{
+		const stage_entry *entry = cache->entries[i];
+		const size_t length = strlen(entry->source);
+
+		end = format_number(end, entry->number);
+		end = format_number(end, entry->size);
+		end = format_number(end, entry->used);
+		end = format_number(end, entry->source_date.seconds);
+		end = format_number(end, entry->source_date.fraction);
+		end = format_number(end, entry->copy_date.seconds);
+		end = format_number(end, entry->copy_date.fraction);
+		memcpy(end, entry->source, length);
+		end += length;
+		*end++ = '\n';
+	}
+
+	if ((file = os_open_file(path, OS_FILE_WRITE)) != NULL)
+	{
+		result = os_write(file, text, end - text) == end - text;
+		if (!os_close_file(file))
+			result = 0;
+	}
+	os_free(text);
+
+	if (result)
+		cache->changed = 0;
+	return result;
+}
+
+/*
+ * Saves the index and frees the cache. The copies stay for the next time.
+ */
+void stage_cache_close(stage_cache *cache)
+{
+	int i;
+
+	if (cache->dir[0])
+		stage_cache_save(cache);
+
+	for (i = 0; i < cache->count; i++)
+		os_free(cache->entries[i]);
+	os_free(cache->entries);
+	os_free(cache->buffer);
+	os_reader_free(cache->reader);
+
+	memset(cache, 0, sizeof(stage_cache));
+}
+
+/*
+ * The date of the index, written after the files, tells which files
+ * were written to the copy later
+ */
+static int index_date(const stage_cache *cache, os_date *date)
+{
+	char path[STAGE_PATH_SIZE];
+	unsigned long size;
+
+	return join_path(path, sizeof(path), cache->dir, STAGE_INDEX_NAME) && os_file_info(path, &size, date);
+}
+
+/*
+ * Finds the copy of a game folder to run the game from, and marks it
+ * as used. A copy older than the game folder is deleted. Returns 0 if
+ * there is no copy that can be used.
+ */
+int stage_cache_find(stage_cache *cache, const char *source, char *copy, const size_t copy_size)
+{
+	const int index = find_entry(cache, source);
+	os_date date;
+
+	if (index < 0 || !folder_date(cache, source, &date))
+		return 0;
+
+	if (!same_date(&date, &cache->entries[index]->source_date))
+	{
+		remove_entry(cache, index, 1);
+		return 0;
+	}
+
+	if (!copy_path(cache, cache->entries[index]->number, copy, copy_size))
+		return 0;
+
+	cache->entries[index]->used = ++cache->clock;
+	cache->changed = 1;
+
+	return 1;
+}
+
+/*
+ * Copies a game folder to the cache, unless its copy is up to date,
+ * making room for it if needed. The copies used since keep_since are
+ * not deleted for it. Returns one of the STAGE_ results.
+ */
+int stage_cache_add(stage_cache *cache, const char *source, const unsigned long keep_since)
+{
+	char copy[STAGE_PATH_SIZE];
+	unsigned long size = 0;
+	stage_entry *entry;
+	os_date date;
+	int index = find_entry(cache, source), result;
+
+	// Taken before copying, so a change while copying shows next time
+	if (!folder_date(cache, source, &date))
+		return STAGE_FAILED;
+
+	if (index >= 0)
+	{
+		if (same_date(&date, &cache->entries[index]->source_date))
+		{
+			cache->entries[index]->used = ++cache->clock;
+			cache->changed = 1;
+			return STAGE_OK;
+		}
+		remove_entry(cache, index, 1);
+	}
+
+	if (!measure_folder(cache, source, 0, &size))
+		return cache->stop ? STAGE_STOPPED : STAGE_FAILED;
+
+	if (size > cache->budget || !make_room(cache, size, keep_since))
+		return STAGE_TOO_BIG;
+
+	if (!copy_path(cache, cache->next_number, copy, sizeof(copy)))
+		return STAGE_FAILED;
+
+	result = copy_folder(cache, source, copy, 0);
+	if (result == STAGE_OK && (entry = add_entry(cache, source)) != NULL)
+	{
+		entry->number = cache->next_number++;
+		entry->size = size;
+		entry->used = ++cache->clock;
+		entry->source_date = date;
+		cache->used_size += size;
+
+		if (stage_cache_save(cache) && index_date(cache, &entry->copy_date))
+		{
+			cache->changed = 1;
+			return STAGE_OK;
+		}
+
+		remove_entry(cache, cache->count - 1, 0);
+		result = STAGE_FAILED;
+	}
+
+	delete_folder(cache, copy, 0);
+	return result == STAGE_OK ? STAGE_FAILED : result;
+}
+
+/*
+ * Copies the files the game wrote to its copy back to the game folder.
+ * The copy is then up to date with the folder again. Returns the number
+ * of files copied back, or -1 if some could not be.
+ */
+int stage_cache_sync(stage_cache *cache, const char *source)
+{
+	const int index = find_entry(cache, source);
+	char copy[STAGE_PATH_SIZE];
+	unsigned long size = 0;
+	stage_entry *entry;
+	int synced = 0, result;
+
+	if (index < 0 || !copy_path(cache, cache->entries[index]->number, copy, sizeof(copy)))
+		return 0;
+
+	entry = cache->entries[index];
+	result = sync_folder(cache, copy, source, 0, &entry->copy_date, &synced);
+
+	if (synced == 0)
+		return result ? 0 : -1;
+
+	// The game may have added files, and the folder date changed with them
+	folder_date(cache, source, &entry->source_date);
+	if (measure_folder(cache, copy, 0, &size))
+	{
+		cache->used_size += size;
+		cache->used_size -= entry->size < cache->used_size ? entry->size : cache->used_size;
+		entry->size = size;
+	}
+
+	cache->changed = 1;
+	if (stage_cache_save(cache) && index_date(cache, &entry->copy_date))
+		cache->changed = 1;
+
+	return result ? synced : -1;
+}
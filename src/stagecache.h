@@ -0,0 +1,68 @@
+/*
+  stagecache.h
+  Game folder staging cache header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _STAGE_CACHE_H
+#define _STAGE_CACHE_H
+
+#include "osfuncs.h"
+
+#define STAGE_PATH_SIZE 256
+
+/* The results of stage_cache_add() */
+#define STAGE_FAILED 0
+#define STAGE_OK 1
+#define STAGE_TOO_BIG 2   /* it doesn't fit in the budget, even without the older copies */
+#define STAGE_STOPPED 3
+
+/* A game folder with its copy in the cache */
+typedef struct stage_entry
+{
+	char *source;            /* the game folder */
+	unsigned long number;    /* the name of the copy in the cache */
+	unsigned long size;      /* of the files, in bytes */
+	unsigned long used;      /* by the clock of the cache, the oldest one goes first */
+	os_date source_date;     /* of the game folder when it was copied */
+	os_date copy_date;       /* files of the copy changed after this were written by the game */
+} stage_entry;
+
+typedef struct stage_cache
+{
+	char dir[STAGE_PATH_SIZE];
+	unsigned long budget;    /* in bytes */
+	unsigned long used_size;
+	stage_entry **entries;
+	int count, size, changed;
+	unsigned long clock, next_number;
+	unsigned char *buffer;   /* for copying */
+	os_dir_reader *reader;
+	unsigned long copied;    /* bytes copied so far */
+	volatile int stop;
+} stage_cache;
+
+int stage_cache_open(stage_cache *, const char *, unsigned long);
+int stage_cache_save(stage_cache *);
+void stage_cache_close(stage_cache *);
+int stage_cache_find(stage_cache *, const char *, char *, size_t);
+int stage_cache_add(stage_cache *, const char *, unsigned long);
+int stage_cache_sync(stage_cache *, const char *);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+  stagetask.c
+  Background game staging source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Copies game folders to the staging cache on a process of its own,
+ * below the priority of the GUI, like the scan. When it is done, it
+ * sends a message to the port of the task that started it.
+ */
+
+/* Prototypes */
+#if defined(__amigaos4__)
+#include <proto/exec.h>
+#else
+#include <clib/exec_protos.h>
+#endif
+
+/* ANSI C */
+#include <string.h>
+
+#include "osfuncs.h"
+#include "stagecache.h"
+#include "stagetask.h"
+
+#define STAGE_TASK_PRIORITY -1
+
+static void stage_task_run(void *data)
+{
+	stage_task *task = data;
+	const unsigned long start_time = os_milliseconds();
+	// The games of this run don't push each other out of the cache
+	const unsigned long keep_since = task->cache->clock + 1;
+	int i;
+
+	SetTaskPri(FindTask(NULL), STAGE_TASK_PRIORITY);
+
+	for (i = 0; i < task->count && !task->cache->stop; i++)
+	{
+		if (stage_cache_add(task->cache, task->sources[i], keep_since) == STAGE_OK)
+			task->staged++;
+	}
+	stage_cache_save(task->cache);
+
+	task->milliseconds = os_milliseconds() - start_time;
+
+	PutMsg(task->port, &task->done);
+}
+
+/*
+ * Starts copying the game folders of the task. Returns 0 if it could
+ * not be started. Once it started, stage_task_ended() has to be called
+ * when its signal arrives, or stage_task_end() to stop it.
+ */
+int stage_task_start(stage_task *task)
+{
+	task->staged = 0;
+	task->milliseconds = 0;
+	task->cache->stop = 0;
+	memset(&task->done, 0, sizeof(task->done));
+	task->done.mn_Length = sizeof(struct Message);
+
+	if ((task->port = CreateMsgPort()))
+	{
+		if ((task->thread = os_thread_start("iGame staging", stage_task_run, task)))
+			return 1;
+
+		DeleteMsgPort(task->port);
+		task->port = NULL;
+	}
+
+	return 0;
+}
+
+/*
+ * The signal the end of the copies arrives with, or 0 if none runs
+ */
+ULONG stage_task_signal(const stage_task *task)
+{
+	return task->port ? 1UL << task->port->mp_SigBit : 0;
+}
+
+static void stage_task_free(stage_task *task)
+{
+	os_thread_wait(task->thread);
+	task->thread = NULL;
+
+	DeleteMsgPort(task->port);
+	task->port = NULL;
+}
+
+/*
+ * Returns 1, and lets the task go, if it ended
+ */
+int stage_task_ended(stage_task *task)
+{
+	if (task->port == NULL || GetMsg(task->port) == NULL)
+		return 0;
+
+	stage_task_free(task);
+	return 1;
+}
+
+/*
+ * Stops the copies, deleting the one that was not finished, and waits
+ * for the task to end
+ */
+void stage_task_end(stage_task *task)
+{
+	if (task->port == NULL)
+		return;
+
+	task->cache->stop = 1;
+	WaitPort(task->port);
+	GetMsg(task->port);
+	stage_task_free(task);
+}
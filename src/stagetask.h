@@ -0,0 +1,55 @@
+/*
+  stagetask.h
+  Background game staging header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _STAGE_TASK_H
+#define _STAGE_TASK_H
+
+#include <exec/ports.h>
+
+#include "osfuncs.h"
+#include "stagecache.h"
+
+#define STAGE_TASK_GAMES 8
+
+typedef struct stage_task
+{
+	/* filled in by the caller, the cache is not used by anyone else until the task ended */
+	stage_cache *cache;
+	char sources[STAGE_TASK_GAMES][STAGE_PATH_SIZE];  /* the game folders, the first one first */
+	int count;
+
+	/* filled in by the task, safe to read once it ended */
+	int staged;                   /* folders that have an up to date copy */
+	unsigned long milliseconds;   /* how long it took */
+
+	/* private */
+	struct MsgPort *port;
+	os_thread *thread;
+	struct Message done;
+} stage_task;
+
+int stage_task_start(stage_task *);
+ULONG stage_task_signal(const stage_task *);
+int stage_task_ended(stage_task *);
+void stage_task_end(stage_task *);
+
+#endif
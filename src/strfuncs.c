@@ -97,54 +97,6 @@ void string_to_lower(char* slave)
 }
 
 
-/*
- * Splits a string using spl
- */
-char** my_split(char* str, char* spl)
-{
-	char **ret, *buffer[256], buf[4096];
-	int i;
-
-	if (!spl)
-	{
-		ret = (char **)malloc(2 * sizeof(char *));
-		ret[0] = (char *)strdup(str);
-		ret[1] = NULL;
-		return (ret);
-	}
-
-	int count = 0;
-
-	char* fptr = str;
-	const int spl_len = strlen(spl);
-	char* sptr = strstr(fptr, spl);
-	while (sptr)
-	{
-		i = sptr - fptr;
-		memcpy(buf, fptr, i);
-		buf[i] = '\0';
-		buffer[count++] = (char *)strdup(buf);
-		fptr = sptr + spl_len;
-		sptr = strstr(fptr, spl);
-	}
-	sptr = strchr(fptr, '\0');
-	i = sptr - fptr;
-	memcpy(buf, fptr, i);
-	buf[i] = '\0';
-	buffer[count++] = (char *)strdup(buf);
-
-	ret = (char **)malloc((count + 1) * sizeof(char *));
-
-	for (i = 0; i < count; i++)
-	{
-		ret[i] = buffer[i];
-	}
-	ret[count] = NULL;
-
-	return ret;
-}
-
-
 int get_delimiter_position(const char* str)
 {
 	char* delimiter = strrchr(str, '/');
@@ -0,0 +1,566 @@
+/*
+  thumbpack.c
+  Screenshot thumbnail pack source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The screenshots, already scaled for the side panel, kept in one file
+ * so that showing one again is a single read instead of decoding the
+ * picture. The file starts with a header that tells the size the
+ * thumbnails fit in and where the index is. Every thumbnail is a small
+ * header, its palette and one byte for every pixel, and the index at
+ * the end has the path and the date of the screenshot of each one. New
+ * thumbnails are written after the end of the file and the header is
+ * written last, so a file cut short still has its old index. A pack
+ * of another size is started over, and a thumbnail older than its
+ * screenshot is scaled again. Only plain C and the os_ calls, so it
+ * runs on a host too.
+ */
+
+/* ANSI C */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osfuncs.h"
+#include "screenshot.h"
+#include "thumbpack.h"
+
+#define THUMB_MAGIC "iGTP"
+#define THUMB_VERSION 1
+#define THUMB_HEADER_SIZE 32
+#define THUMB_IMAGE_HEADER_SIZE 8
+#define THUMB_ENTRY_SIZE 18     /* and the path */
+
+/* The file is written again without the unused parts when they are more than this, and more than the rest */
+#define THUMB_COMPACT_SIZE 65536
+
+/* All the numbers in the file are big endian */
+static void put_word(unsigned char *buffer, const unsigned long value)
+{
+	buffer[0] = (unsigned char)(value >> 8);
+	buffer[1] = (unsigned char)value;
+}
+
+static void put_long(unsigned char *buffer, const unsigned long value)
+{
+	put_word(buffer, value >> 16);
+	put_word(buffer + 2, value & 0xffff);
+}
+
+static unsigned long get_word(const unsigned char *buffer)
+{
+	return (unsigned long)buffer[0] << 8 | buffer[1];
+}
+
+static unsigned long get_long(const unsigned char *buffer)
+{
+	return get_word(buffer) << 16 | get_word(buffer + 2);
+}
+
+static int same_date(const os_date *a, const os_date *b)
+{
+	return a->seconds == b->seconds && a->fraction == b->fraction;
+}
+
+static int grow_buffer(thumb_pack *pack, const unsigned long size)
+{
+	if (size > pack->buffer_size)
+	{
+		unsigned char *buffer = os_alloc(size);
+
+		if (buffer == NULL)
+			return 0;
+
+		os_free(pack->buffer);
+		pack->buffer = buffer;
+		pack->buffer_size = size;
+	}
+
+	return 1;
+}
+
+static int find_entry(const thumb_pack *pack, const char *path, int *found)
+{
+	int low = 0, high = pack->count;
+
+	*found = 0;
+	while (low < high)
+	{
+		const int middle = (low + high) / 2;
+		const int compare = strcmp(pack->entries[middle]->path, path);
+
+		if (compare == 0)
+		{
+			*found = 1;
+			return middle;
+		}
+
+		if (compare < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+static thumb_entry *insert_entry(thumb_pack *pack, const int index, const char *path)
+{
+	const size_t path_size = strlen(path) + 1;
+	thumb_entry *entry;
+
+	if (pack->count == pack->size)
+	{
+		const int size = pack->size ? pack->size * 2 : 64;
+		thumb_entry **entries = os_alloc(sizeof(thumb_entry *) * size);
+
+		if (entries == NULL)
+			return NULL;
+
+		if (pack->entries)
+			memcpy(entries, pack->entries, sizeof(thumb_entry *) * pack->count);
+		os_free(pack->entries);
+		pack->entries = entries;
+		pack->size = size;
+	}
+
+	if ((entry = os_alloc(sizeof(thumb_entry) + path_size)) == NULL)
+		return NULL;
+
+	memset(entry, 0, sizeof(thumb_entry));
+	entry->path = (char *)(entry + 1);
+	memcpy(entry->path, path, path_size);
+
+	memmove(pack->entries + index + 1, pack->entries + index, sizeof(thumb_entry *) * (pack->count - index));
+	pack->entries[index] = entry;
+	pack->count++;
+
+	return entry;
+}
+
+static void free_entries(thumb_pack *pack)
+{
+	int i;
+
+	for (i = 0; i < pack->count; i++)
+		os_free(pack->entries[i]);
+	os_free(pack->entries);
+
+	pack->entries = NULL;
+	pack->count = 0;
+	pack->size = 0;
+	pack->live_size = 0;
+}
+
+/*
+ * Reads the index the header points at. A file that is not a pack of
+ * the same size, or is broken, leaves the pack empty and is written
+ * again with the first thumbnail.
+ */
+static void load_index(thumb_pack *pack)
+{
+	unsigned char header[THUMB_HEADER_SIZE];
+	unsigned long index_offset, index_size, position;
+	int count, i, result;
+
+	if (os_read_file(pack->file, 0, header, THUMB_HEADER_SIZE) != THUMB_HEADER_SIZE
+		|| memcmp(header, THUMB_MAGIC, 4) || get_long(header + 4) != THUMB_VERSION
+		|| (int)get_word(header + 8) != pack->width || (int)get_word(header + 10) != pack->height)
+		return;
+
+	index_offset = get_long(header + 12);
+	count = (int)get_long(header + 16);
+	index_size = get_long(header + 20);
+	if (index_offset < THUMB_HEADER_SIZE || !grow_buffer(pack, index_size)
+		|| os_read_file(pack->file, index_offset, pack->buffer, index_size) != (long)index_size)
+		return;
+
+	for (i = 0, position = 0, result = 1; result && i < count; i++)
+	{
+		char path[THUMB_PATH_SIZE];
+		const unsigned char *data = pack->buffer + position;
+		unsigned long length = 0;
+		thumb_entry *entry = NULL;
+		int index, found;
+
+		result = position + THUMB_ENTRY_SIZE <= index_size;
+		if (result)
+		{
+			length = get_word(data + 16);
+			result = length > 0 && length < THUMB_PATH_SIZE && position + THUMB_ENTRY_SIZE + length <= index_size
+				&& get_long(data + 8) >= THUMB_HEADER_SIZE && get_long(data + 8) + get_long(data + 12) <= index_offset;
+		}
+		if (result)
+		{
+			memcpy(path, data + THUMB_ENTRY_SIZE, length);
+			path[length] = '\0';
+			index = find_entry(pack, path, &found);
+			result = !found && (entry = insert_entry(pack, index, path)) != NULL;
+		}
+		if (result)
+		{
+			entry->date.seconds = get_long(data);
+			entry->date.fraction = get_long(data + 4);
+			entry->offset = get_long(data + 8);
+			entry->size = get_long(data + 12);
+			pack->live_size += entry->size;
+			position += THUMB_ENTRY_SIZE + length;
+		}
+	}
+
+	if (!result)
+	{
+		free_entries(pack);
+		return;
+	}
+
+	pack->end = index_offset + index_size;
+}
+
+/*
+ * Opens the pack in the file, for thumbnails that fit in the size. It
+ * is read only when a thumbnail is needed or added.
+ */
+int thumb_pack_open(thumb_pack *pack, const char *file, const int width, const int height)
+{
+	memset(pack, 0, sizeof(thumb_pack));
+
+	if (strlen(file) == 0 || strlen(file) + 4 >= sizeof(pack->file) || width <= 0 || height <= 0
+		|| width > 0xffff || height > 0xffff)
+		return 0;
+
+	strcpy(pack->file, file);
+	pack->width = width;
+	pack->height = height;
+	load_index(pack);
+
+	return 1;
+}
+
+/*
+ * Returns the image of the thumbnail of the screenshot at the path, if
+ * there is one as new as the date of the screenshot. Free it with
+ * screenshot_free().
+ */
+screenshot_image *thumb_pack_get(thumb_pack *pack, const char *path, const os_date *date)
+{
+	screenshot_image *image;
+	const unsigned char *data;
+	unsigned long width, height, colors, i;
+	int index, found;
+
+	if (pack->file[0] == '\0')
+		return NULL;
+
+	index = find_entry(pack, path, &found);
+	if (!found || !same_date(&pack->entries[index]->date, date) || !grow_buffer(pack, pack->entries[index]->size)
+		|| os_read_file(pack->file, pack->entries[index]->offset, pack->buffer, pack->entries[index]->size)
+			!= (long)pack->entries[index]->size)
+		return NULL;
+
+	data = pack->buffer;
+	width = get_word(data);
+	height = get_word(data + 2);
+	colors = get_word(data + 4);
+	if (width == 0 || height == 0 || (int)width > pack->width || (int)height > pack->height
+		|| colors == 0 || colors > SCREENSHOT_COLORS
+		|| THUMB_IMAGE_HEADER_SIZE + colors * 3 + width * height != pack->entries[index]->size)
+		return NULL;
+
+	if ((image = os_alloc(sizeof(screenshot_image))) == NULL)
+		return NULL;
+
+	memset(image, 0, sizeof(screenshot_image));
+	if ((image->pixels = os_alloc(width * height)) == NULL)
+	{
+		os_free(image);
+		return NULL;
+	}
+
+	image->width = (unsigned short)width;
+	image->height = (unsigned short)height;
+	image->colors = (unsigned short)colors;
+	for (i = 0, data += THUMB_IMAGE_HEADER_SIZE; i < colors; i++, data += 3)
+		image->palette[i] = (unsigned long)data[0] << 16 | (unsigned long)data[1] << 8 | data[2];
+	memcpy(image->pixels, data, width * height);
+	pack->reads++;
+
+	return image;
+}
+
+/*
+ * Adds the thumbnail of the screenshot at the path, written at the end
+ * of the file at once. The one it had before is left unused in the
+ * file. Returns 0 if it could not be written.
+ */
+int thumb_pack_add(thumb_pack *pack, const char *path, const os_date *date, const screenshot_image *image)
+{
+	const unsigned long pixels = (unsigned long)image->width * image->height;
+	const unsigned long size = THUMB_IMAGE_HEADER_SIZE + image->colors * 3UL + pixels;
+	unsigned char *data;
+	thumb_entry *entry;
+	os_file *file;
+	int index, found, result;
+	unsigned long i;
+
+	if (pack->file[0] == '\0' || strlen(path) == 0 || strlen(path) >= THUMB_PATH_SIZE
+		|| image->width > pack->width || image->height > pack->height || !grow_buffer(pack, size))
+		return 0;
+
+	data = pack->buffer;
+	put_word(data, image->width);
+	put_word(data + 2, image->height);
+	put_word(data + 4, image->colors);
+	put_word(data + 6, 0);
+	for (i = 0, data += THUMB_IMAGE_HEADER_SIZE; i < image->colors; i++, data += 3)
+	{
+		data[0] = (unsigned char)(image->palette[i] >> 16);
+		data[1] = (unsigned char)(image->palette[i] >> 8);
+		data[2] = (unsigned char)image->palette[i];
+	}
+	memcpy(data, image->pixels, pixels);
+
+	// A new file gets an empty header, which makes it no pack until it is saved
+	if (pack->end == 0)
+	{
+		unsigned char header[THUMB_HEADER_SIZE];
+
+		memset(header, 0, sizeof(header));
+		if ((file = os_open_file(pack->file, OS_FILE_WRITE)) == NULL)
+			return 0;
+
+		result = os_write(file, header, THUMB_HEADER_SIZE) == THUMB_HEADER_SIZE;
+		if (result)
+			pack->end = THUMB_HEADER_SIZE;
+	}
+	else
+	{
+		if ((file = os_open_file(pack->file, OS_FILE_UPDATE)) == NULL)
+			return 0;
+
+		result = os_seek(file, pack->end);
+	}
+
+	result = result && os_write(file, pack->buffer, size) == (long)size;
+	if (!os_close_file(file))
+		result = 0;
+	if (!result)
+		return 0;
+
+	index = find_entry(pack, path, &found);
+	if (found)
+	{
+		entry = pack->entries[index];
+		pack->live_size -= entry->size;
+	}
+	else if ((entry = insert_entry(pack, index, path)) == NULL)
+		return 0;
+
+	entry->date = *date;
+	entry->offset = pack->end;
+	entry->size = size;
+	pack->end += size;
+	pack->live_size += size;
+	pack->changed = 1;
+	pack->writes++;
+
+	return 1;
+}
+
+/*
+ * Makes the index, with the offsets the thumbnails have in the file
+ * or, to write them again without the unused parts, the ones they
+ * will have
+ */
+static unsigned char *make_index(const thumb_pack *pack, const int compacted, unsigned long *size)
+{
+	unsigned long offset = THUMB_HEADER_SIZE;
+	unsigned char *index, *data;
+	int i;
+
+	for (i = 0, *size = 0; i < pack->count; i++)
+		*size += THUMB_ENTRY_SIZE + strlen(pack->entries[i]->path);
+
+	if ((index = os_alloc(*size ? *size : 1)) == NULL)
+		return NULL;
+
+	for (i = 0, data = index; i < pack->count; i++)
+	{
+		const thumb_entry *entry = pack->entries[i];
+		const unsigned long length = strlen(entry->path);
+
+		put_long(data, entry->date.seconds);
+		put_long(data + 4, entry->date.fraction);
+		put_long(data + 8, compacted ? offset : entry->offset);
+		put_long(data + 12, entry->size);
+		put_word(data + 16, length);
+		memcpy(data + THUMB_ENTRY_SIZE, entry->path, length);
+		data += THUMB_ENTRY_SIZE + length;
+		offset += entry->size;
+	}
+
+	return index;
+}
+
+static int write_header(const thumb_pack *pack, os_file *file, const unsigned long index_offset,
+	const unsigned long index_size)
+{
+	unsigned char header[THUMB_HEADER_SIZE];
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, THUMB_MAGIC, 4);
+	put_long(header + 4, THUMB_VERSION);
+	put_word(header + 8, pack->width);
+	put_word(header + 10, pack->height);
+	put_long(header + 12, index_offset);
+	put_long(header + 16, pack->count);
+	put_long(header + 20, index_size);
+
+	return os_seek(file, 0) && os_write(file, header, THUMB_HEADER_SIZE) == THUMB_HEADER_SIZE;
+}
+
+/*
+ * Writes the thumbnails in use to a new file, which then takes the
+ * place of the old one. If that fails the old file is kept.
+ */
+static int compact(thumb_pack *pack, const unsigned char *index, const unsigned long index_size)
+{
+	char new_file[THUMB_PATH_SIZE + 4], old_file[THUMB_PATH_SIZE + 4];
+	unsigned char header[THUMB_HEADER_SIZE];
+	unsigned long offset = THUMB_HEADER_SIZE;
+	os_file *source, *target;
+	int i, result;
+
+	snprintf(new_file, sizeof(new_file), "%s.new", pack->file);
+	snprintf(old_file, sizeof(old_file), "%s.old", pack->file);
+	if ((source = os_open_file(pack->file, OS_FILE_READ)) == NULL)
+		return 0;
+
+	if ((target = os_open_file(new_file, OS_FILE_WRITE)) == NULL)
+	{
+		os_close_file(source);
+		return 0;
+	}
+
+	memset(header, 0, sizeof(header));
+	result = os_write(target, header, THUMB_HEADER_SIZE) == THUMB_HEADER_SIZE;
+	for (i = 0; result && i < pack->count; i++)
+	{
+		const thumb_entry *entry = pack->entries[i];
+
+		result = grow_buffer(pack, entry->size) && os_seek(source, entry->offset)
+			&& os_read(source, pack->buffer, entry->size) == (long)entry->size
+			&& os_write(target, pack->buffer, entry->size) == (long)entry->size;
+		offset += entry->size;
+	}
+
+	result = result && os_write(target, index, index_size) == (long)index_size
+		&& write_header(pack, target, offset, index_size);
+	os_close_file(source);
+	if (!os_close_file(target))
+		result = 0;
+
+	// The old file is only moved aside, and put back if the new one can't take its place
+	os_delete(old_file);
+	if (!result || !os_rename(pack->file, old_file))
+	{
+		os_delete(new_file);
+		return 0;
+	}
+
+	if (!os_rename(new_file, pack->file))
+	{
+		os_delete(new_file);
+
+		// With no file left, the thumbnails are written again as they are read
+		if (!os_rename(old_file, pack->file))
+		{
+			free_entries(pack);
+			pack->end = 0;
+			pack->changed = 0;
+		}
+		return 0;
+	}
+	os_delete(old_file);
+
+	for (i = 0, offset = THUMB_HEADER_SIZE; i < pack->count; i++)
+	{
+		pack->entries[i]->offset = offset;
+		offset += pack->entries[i]->size;
+	}
+	pack->end = offset + index_size;
+
+	return 1;
+}
+
+/*
+ * Writes the index after the thumbnails and then the header that
+ * points at it, if any thumbnail was added since it was opened
+ */
+int thumb_pack_save(thumb_pack *pack)
+{
+	const unsigned long unused = pack->end - THUMB_HEADER_SIZE - pack->live_size;
+	const int compacted = unused > pack->live_size && unused > THUMB_COMPACT_SIZE;
+	unsigned long index_size;
+	unsigned char *index;
+	os_file *file;
+	int result;
+
+	if (!pack->changed || pack->end == 0)
+		return 1;
+
+	if ((index = make_index(pack, compacted, &index_size)) == NULL)
+		return 0;
+
+	if (compacted)
+		result = compact(pack, index, index_size);
+	else if ((file = os_open_file(pack->file, OS_FILE_UPDATE)) == NULL)
+		result = 0;
+	else
+	{
+		result = os_seek(file, pack->end) && os_write(file, index, index_size) == (long)index_size
+			&& write_header(pack, file, pack->end, index_size);
+		if (!os_close_file(file))
+			result = 0;
+		if (result)
+			pack->end += index_size;
+	}
+
+	os_free(index);
+	if (result)
+		pack->changed = 0;
+
+	return result;
+}
+
+/*
+ * Saves the index and frees the pack
+ */
+void thumb_pack_close(thumb_pack *pack)
+{
+	if (pack->file[0])
+		thumb_pack_save(pack);
+
+	free_entries(pack);
+	os_free(pack->buffer);
+
+	memset(pack, 0, sizeof(thumb_pack));
+}
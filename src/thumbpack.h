@@ -0,0 +1,59 @@
+/*
+  thumbpack.h
+  Screenshot thumbnail pack header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _THUMB_PACK_H
+#define _THUMB_PACK_H
+
+#include "osfuncs.h"
+#include "screenshot.h"
+
+#define THUMB_PATH_SIZE 256
+
+/* A screenshot with its thumbnail in the pack */
+typedef struct thumb_entry
+{
+	char *path;              /* of the screenshot */
+	os_date date;            /* of the screenshot when it was scaled */
+	unsigned long offset;    /* of the thumbnail in the pack */
+	unsigned long size;      /* of the thumbnail, in bytes */
+} thumb_entry;
+
+typedef struct thumb_pack
+{
+	char file[THUMB_PATH_SIZE];
+	int width, height;       /* the thumbnails fit in */
+	thumb_entry **entries;   /* sorted by path */
+	int count, size, changed;
+	unsigned long end;       /* of the file, new thumbnails go after it, 0 if there is no file yet */
+	unsigned long live_size; /* of the thumbnails in the index, the rest of the file is unused */
+	unsigned char *buffer;
+	unsigned long buffer_size;
+	unsigned long reads, writes;
+} thumb_pack;
+
+int thumb_pack_open(thumb_pack *, const char *, int, int);
+int thumb_pack_save(thumb_pack *);
+void thumb_pack_close(thumb_pack *);
+screenshot_image *thumb_pack_get(thumb_pack *, const char *, const os_date *);
+int thumb_pack_add(thumb_pack *, const char *, const os_date *, const screenshot_image *);
+
+#endif
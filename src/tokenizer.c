@@ -0,0 +1,72 @@
+/*
+  tokenizer.c
+  String tokenizer source for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Only plain C and no calls to the OS, so the helper tools can use
+ * it on any host.
+ */
+
+/* ANSI C */
+#include <string.h>
+
+#include "tokenizer.h"
+
+/*
+ * Zero-copy tokenizer. Splits a string on every occurrence of the
+ * delimiter, like strtok() but without touching the source buffer and
+ * keeping empty tokens. Tokens are returned as a pointer into the
+ * source string plus a length, so there is no allocation and no limit
+ * on the number or size of the tokens.
+ */
+void tokenizer_init(tokenizer *tok, const char *str, const char *delimiter)
+{
+	tok->next = str;
+	tok->delimiter = delimiter;
+	tok->delimiter_length = delimiter ? strlen(delimiter) : 0;
+}
+
+/*
+ * Gets the next token. Returns 1 when a token was found, 0 when the
+ * string is exhausted. The token is NOT null terminated.
+ */
+int tokenizer_next(tokenizer *tok, const char **token, size_t *length)
+{
+	const char *start = tok->next;
+	const char *end;
+
+	if (start == NULL)
+		return 0;
+
+	if (tok->delimiter_length && (end = strstr(start, tok->delimiter)))
+	{
+		tok->next = end + tok->delimiter_length;
+	}
+	else
+	{
+		end = start + strlen(start);
+		tok->next = NULL;
+	}
+
+	*token = start;
+	*length = end - start;
+	return 1;
+}
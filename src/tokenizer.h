@@ -0,0 +1,38 @@
+/*
+  tokenizer.h
+  String tokenizer header for iGame
+
+  Copyright (c) 2022, Emmanuel Vasilakis and contributors
+
+  This file is part of iGame.
+
+  iGame is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  iGame is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with iGame. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TOKENIZER_H
+#define _TOKENIZER_H
+
+#include <stddef.h>
+
+typedef struct tokenizer
+{
+	const char *next;
+	const char *delimiter;
+	size_t delimiter_length;
+} tokenizer;
+
+void tokenizer_init(tokenizer *, const char *, const char *);
+int tokenizer_next(tokenizer *, const char **, size_t *);
+
+#endif